@@ -7,6 +7,7 @@
  *
  */
 
+#include <cstddef>
 #include <cstdint>
 
 /**
@@ -15,6 +16,8 @@
  */
 class DS3231 {
 public:
+  static constexpr uint8_t kRegisters = 0x13; /*!< Number of registers, seconds to temperature LSB */
+
   /**
    * @brief To distinguish if AM/PM is used
    *
@@ -62,6 +65,20 @@ public:
    */
   void report_all_registers();
 
+  /**
+   * @brief Writes \p len consecutive registers from \p reg in one transfer
+   *
+   * @return false if they are out of range, or the transfer failed
+   */
+  [[nodiscard]] bool write_registers(uint8_t reg, uint8_t* data, size_t len);
+
+  /**
+   * @brief Reads \p len consecutive registers from \p reg in one transfer
+   *
+   * @return false if they are out of range, or the transfer failed
+   */
+  [[nodiscard]] bool read_registers(uint8_t reg, uint8_t* data, size_t len);
+
 private:
   static constexpr uint8_t dev_address_{ 0b1101000 << 1 }; /*!< Shifted I2C address, ready to be used */
 };
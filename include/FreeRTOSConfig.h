@@ -50,6 +50,18 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
   #include <stdint.h>
 extern uint32_t SystemCoreClock;
+  #ifdef __cplusplus
+extern "C" {
+  #endif
+void cpu_stats_switched_in(uint32_t number);
+void trace_switched_in(uint32_t number);
+void trace_switched_out(uint32_t number);
+void trace_queue_give(uint32_t number, uint32_t waiting);
+void trace_queue_take(uint32_t number, uint32_t waiting);
+void trace_queue_block(uint32_t number, uint32_t waiting);
+  #ifdef __cplusplus
+}
+  #endif
 #endif
 #define configUSE_PREEMPTION                    1
 #define configSUPPORT_STATIC_ALLOCATION         1
@@ -63,6 +75,7 @@ extern uint32_t SystemCoreClock;
 #define configTOTAL_HEAP_SIZE                   ((size_t)3072)
 #define configMAX_TASK_NAME_LEN                 (16)
 #define configUSE_TRACE_FACILITY                1
+#define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_16_BIT_TICKS                  0
 #define configUSE_MUTEXES                       1
 #define configQUEUE_REGISTRY_SIZE               8
@@ -94,6 +107,7 @@ to exclude the API function. */
 #define INCLUDE_xQueueGetMutexHolder        1
 #define INCLUDE_uxTaskGetStackHighWaterMark 1
 #define INCLUDE_eTaskGetState               1
+#define INCLUDE_xTaskGetIdleTaskHandle      1
 
 /*
  * The CMSIS-RTOS V2 FreeRTOS wrapper is dependent on the heap implementation used
@@ -149,6 +163,24 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+
+/* Run time stats count DWT cycles, the counter is enabled by latency::init() before the kernel starts */
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() (*(volatile uint32_t*)0xE0001004UL) /* DWT->CYCCNT */
+/* Context switches of every task, see cpu_stats.cpp, and the kernel event trace, see trace.cpp */
+#define traceTASK_SWITCHED_IN()                       \
+  do {                                                \
+    cpu_stats_switched_in(pxCurrentTCB->uxTCBNumber); \
+    trace_switched_in(pxCurrentTCB->uxTCBNumber);     \
+  } while (0)
+#define traceTASK_SWITCHED_OUT() trace_switched_out(pxCurrentTCB->uxTCBNumber)
+/* Operations on the queues and semaphores with a queue number, see trace::name_queue() */
+#define TRACE_QUEUE(hook, pxQueue) hook((pxQueue)->uxQueueNumber, (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_SEND(pxQueue) TRACE_QUEUE(trace_queue_give, pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) TRACE_QUEUE(trace_queue_give, pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue) TRACE_QUEUE(trace_queue_take, pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) TRACE_QUEUE(trace_queue_take, pxQueue)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) TRACE_QUEUE(trace_queue_block, pxQueue)
 /* USER CODE END Defines */
 
 #define configENABLE_BACKWARD_COMPATIBILITY 0
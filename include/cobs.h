@@ -0,0 +1,85 @@
+#ifndef COBS_H_
+#define COBS_H_
+
+/** @file cobs.h
+ * Consistent Overhead Byte Stuffing, used to frame binary messages
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief COBS encoding removes all 0 bytes from a message, so 0 can delimit the frames
+ *
+ * Overhead is 1 byte per started 254 bytes. Used on the target and in the host tools.
+ */
+namespace cobs {
+
+  /**
+   * @brief Max length of \p len bytes after encoding, without the delimiter
+   *
+   */
+  constexpr size_t max_encoded_len(size_t len) {
+    return len + len / 254 + 1;
+  }
+
+  /**
+   * @brief Encodes \p len bytes from \p src into \p dst
+   *
+   * @param src message
+   * @param len length of message
+   * @param dst at least max_encoded_len(len) bytes, shall not overlap with \p src
+   * @return size_t encoded length, without the delimiter
+   */
+  inline size_t encode(const uint8_t* src, size_t len, uint8_t* dst) {
+    size_t code_idx{ 0 }, write{ 1 };
+    uint8_t code{ 1 };
+
+    for (size_t read = 0; read < len; ++read) {
+      if (src[read] == 0) {
+        dst[code_idx] = code;
+        code = 1;
+        code_idx = write++;
+        continue;
+      }
+      dst[write++] = src[read];
+      if (++code == 0xFF) {
+        dst[code_idx] = code;
+        code = 1;
+        code_idx = write++;
+      }
+    }
+    dst[code_idx] = code;
+    return write;
+  }
+
+  /**
+   * @brief Decodes a frame without the delimiter
+   *
+   * @param src encoded frame
+   * @param len length of frame
+   * @param dst at least \p len - 1 bytes, can be the same as \p src
+   * @param out_len set to the decoded length
+   * @return true if the frame is valid
+   */
+  inline bool decode(const uint8_t* src, size_t len, uint8_t* dst, size_t& out_len) {
+    size_t read{ 0 }, write{ 0 };
+
+    while (read < len) {
+      const uint8_t code = src[read++];
+      if (code == 0) return false;
+      for (uint8_t i = 1; i < code; ++i) {
+        if (read >= len || src[read] == 0) return false;
+        dst[write++] = src[read++];
+      }
+      if (code != 0xFF && read < len) {
+        dst[write++] = 0;
+      }
+    }
+    out_len = write;
+    return true;
+  }
+
+}  // namespace cobs
+
+#endif  // COBS_H_
@@ -0,0 +1,198 @@
+#ifndef COMMAND_TABLE_H_
+#define COMMAND_TABLE_H_
+
+/** @file command_table.h
+ * Dispatch table of commands, built at compile time
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "param_schema.h"
+
+/**
+ * @brief A command: letter, number, the member function, which handles it, and its parameters
+ *
+ * @tparam T class of the handlers
+ */
+template <class T>
+struct Command {
+  using Handler = void (*)(T&);  //!< Plain function, which forwards to the member function
+
+  char letter;                //!< 'A' to 'Z'
+  uint16_t number;            //!< Number after the letter
+  Handler handler;            //!< Calls the member function
+  const ParamSchema* schema;  //!< Parameters to validate before the call, nullptr to skip validation
+
+  /**
+   * @brief Makes the command \p letter \p number, handled by \p F
+   *
+   * @param schema parameters of the command, e.g. made by make_schema() or kNoParams
+   */
+  template <void (T::*F)()>
+  static constexpr Command of(char letter, uint16_t number, const ParamSchema* schema = nullptr) {
+    return { letter, number, &invoke<F>, schema };
+  }
+
+  /**
+   * @brief Calls \p F on \p obj
+   *
+   */
+  template <void (T::*F)()>
+  static void invoke(T& obj) {
+    (obj.*F)();
+  }
+};
+
+/**
+ * @brief Lowest and highest number of \p letter in \p commands
+ *
+ * @return true if \p letter is used
+ */
+template <class T, size_t N>
+constexpr bool command_range(const Command<T> (&commands)[N], char letter, uint16_t& min, uint16_t& max) {
+  bool found{ false };
+  for (const auto& cmd : commands) {
+    if (cmd.letter != letter) continue;
+    min = found && min < cmd.number ? min : cmd.number;
+    max = found && max > cmd.number ? max : cmd.number;
+    found = true;
+  }
+  return found;
+}
+
+/**
+ * @brief Number of table entries needed for \p commands: for every letter, lowest to highest number
+ *
+ */
+template <class T, size_t N>
+constexpr size_t command_table_size(const Command<T> (&commands)[N]) {
+  size_t size{ 0 };
+  for (char letter = 'A'; letter <= 'Z'; ++letter) {
+    uint16_t min{ 0 }, max{ 0 };
+    if (command_range(commands, letter, min, max)) size += max - min + 1;
+  }
+  return size;
+}
+
+/**
+ * @brief Finds a command with 2 bounds checks and 2 loads, whatever the number of commands
+ *
+ * Built from a list of Command entries in a constant expression, so it is placed in flash. For every letter, the
+ * commands of the numbers from the lowest to the highest one are stored densely, unused numbers are empty. This
+ * is the jump table a switch would compile to, without the comparison chains a sparse switch gets. Numbers of a
+ * letter should be close to each other, the size is checked with command_table_size().
+ *
+ * Duplicates and letters out of range are reported by is_valid(), check it in a static_assert. Schemas are checked
+ * by kSchema.
+ * @tparam T class of the handlers
+ * @tparam Size number of entries, command_table_size() of the commands
+ */
+template <class T, size_t Size>
+class CommandTable {
+public:
+  /**
+   * @brief Builds the table from \p commands
+   *
+   */
+  template <size_t N>
+  constexpr CommandTable(const Command<T> (&commands)[N]);
+
+  /**
+   * @brief The command \p letter \p number
+   *
+   * @return const Command<T>* nullptr if there is no such command
+   */
+  const Command<T>* find(char letter, uint16_t number) const {
+    const unsigned index = static_cast<unsigned>(letter - 'A');
+    if (index >= letters_.size()) return nullptr;
+    const Range& range = letters_[index];
+    const unsigned offset = static_cast<unsigned>(number - range.min);
+    if (offset >= range.count) return nullptr;
+    const Command<T>& cmd = commands_[range.first + offset];
+    return cmd.handler != nullptr ? &cmd : nullptr;
+  }
+
+  /**
+   * @brief Calls the handler of \p letter \p number on \p obj, without validation
+   *
+   * @return true if the command exists
+   */
+  bool call(T& obj, char letter, uint16_t number) const {
+    const Command<T>* cmd = find(letter, number);
+    if (cmd == nullptr) return false;
+    cmd->handler(obj);
+    return true;
+  }
+
+  /**
+   * @brief Number of entries, indices are below this
+   *
+   */
+  static constexpr size_t size() {
+    return Size;
+  }
+
+  /**
+   * @brief Index of \p cmd, which was returned by find(), e.g. for per command data
+   *
+   */
+  size_t index(const Command<T>* cmd) const {
+    return static_cast<size_t>(cmd - commands_.data());
+  }
+
+  /**
+   * @brief Are the commands unique, and the letters between 'A' and 'Z'?
+   *
+   */
+  constexpr bool is_valid() const {
+    return valid_;
+  }
+
+private:
+  /**
+   * @brief Entries of a letter
+   *
+   */
+  struct Range {
+    uint16_t first;  //!< Index of the lowest number in commands_
+    uint16_t min;    //!< Lowest number
+    uint16_t count;  //!< Highest - lowest number + 1, 0 if the letter is not used
+  };
+
+  std::array<Range, 26> letters_{};          //!< Ranges of 'A' to 'Z'
+  std::array<Command<T>, Size> commands_{};  //!< Commands of all letters, empty ones have no handler
+  bool valid_{ true };                       //!< See is_valid()
+};
+
+
+
+template <class T, size_t Size>
+template <size_t N>
+constexpr CommandTable<T, Size>::CommandTable(const Command<T> (&commands)[N]) {
+  static_assert(Size < UINT16_MAX, "Too many table entries");
+  size_t first{ 0 };
+  for (size_t i = 0; i < letters_.size(); ++i) {
+    uint16_t min{ 0 }, max{ 0 };
+    if (!command_range(commands, static_cast<char>('A' + i), min, max)) continue;
+    letters_[i] = { static_cast<uint16_t>(first), min, static_cast<uint16_t>(max - min + 1) };
+    first += max - min + 1;
+  }
+
+  // handlers can't be compared with nullptr in a constant expression
+  std::array<bool, Size> used{};
+  for (const auto& cmd : commands) {
+    if (cmd.letter < 'A' || cmd.letter > 'Z' || first != Size) {
+      valid_ = false;
+      continue;
+    }
+    const Range& range = letters_[cmd.letter - 'A'];
+    const size_t index = range.first + cmd.number - range.min;
+    if (used[index]) valid_ = false;
+    used[index] = true;
+    commands_[index] = cmd;
+  }
+}
+
+#endif  // COMMAND_TABLE_H_
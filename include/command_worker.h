@@ -0,0 +1,139 @@
+#ifndef COMMAND_WORKER_H_
+#define COMMAND_WORKER_H_
+
+/**
+ * @file command_worker.h
+ * @brief Task, which runs the slow part of commands, so they don't block gcode_task
+ *
+ */
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "cmsis_os.h"
+#include "queue.h"
+#include "task.h"
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @brief Runs jobs of a slow resource in order, on its own task
+ *
+ * A handler of a command, which needs a slow bus, reads its parameters, post()s a job, and returns. The command is
+ * then pending, until is_done() of the ticket returned by post(). Meanwhile gcode_task runs the commands of other
+ * resources. Jobs of one worker run one after another, in the order they were posted. The task and the queue are
+ * allocated statically, not from the FreeRTOS heap.
+ *
+ * post() shall be called from one task only.
+ */
+class CommandWorker {
+public:
+  static constexpr size_t kArgsSize = 24,  //!< Max size of the arguments of a job, e.g. the registers of A14
+      kQueueLen = 2,                       //!< Jobs waiting, post() blocks, when they don't fit
+      kStackWords = 128;                   //!< Stack of the task, in words
+
+  /**
+   * @brief Starts the task
+   *
+   * @param on_done called on the task after every job, e.g. to wake the task, which waits for completion
+   */
+  void begin(const char* name, osPriority_t priority, void (*on_done)());
+
+  /**
+   * @brief Queues \p fn with a copy of \p args, waits while the queue is full
+   *
+   * @return uint32_t ticket of the job, see is_done()
+   */
+  template <class Args>
+  uint32_t post(void (*fn)(const Args&), const Args& args);
+
+  /**
+   * @brief Queues \p fn, waits while the queue is full
+   *
+   * @return uint32_t ticket of the job, see is_done()
+   */
+  uint32_t post(void (*fn)());
+
+  /**
+   * @brief Ticket of the last posted job, 0 before the first one
+   *
+   */
+  uint32_t last_ticket() const {
+    return posted_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Have the job of \p ticket and the ones before it finished?
+   *
+   */
+  bool is_done(uint32_t ticket) const {
+    return static_cast<int32_t>(done_.load(std::memory_order_acquire) - ticket) >= 0;
+  }
+
+private:
+  /**
+   * @brief A queued function and its arguments
+   *
+   */
+  struct Job {
+    void (*invoke)(const Job&);          //!< Unpacks args and calls fn
+    void (*fn)();                        //!< The function, cast back to its type by invoke
+    alignas(4) uint8_t args[kArgsSize];  //!< Copy of the arguments
+  };
+
+  /**
+   * @brief Calls fn of \p job with its arguments
+   *
+   */
+  template <class Args>
+  static void invoke(const Job& job) {
+    Args args;
+    memcpy(&args, job.args, sizeof(Args));
+    reinterpret_cast<void (*)(const Args&)>(job.fn)(args);
+  }
+
+  /**
+   * @brief Calls fn of \p job without arguments
+   *
+   */
+  static void invoke_void(const Job& job) {
+    job.fn();
+  }
+
+  /**
+   * @brief Queues \p job
+   *
+   */
+  uint32_t push(const Job& job);
+
+  /**
+   * @brief The task, runs the jobs
+   *
+   * @param arg the worker
+   */
+  static void task(void* arg);
+
+  QueueHandle_t queue_{ nullptr };              //!< Posted jobs
+  StaticQueue_t queue_cb_;                      //!< Queue control block
+  std::array<Job, kQueueLen> queue_storage_;    //!< Queue items
+  osThreadId_t task_handle_{ nullptr };         //!< The task
+  StaticTask_t task_cb_;                        //!< Task control block
+  std::array<StackType_t, kStackWords> stack_;  //!< Stack of the task
+  void (*on_done_)(){ nullptr };                //!< Called after every job
+  std::atomic<uint32_t> posted_{ 0 };           //!< Ticket of the last posted job
+  std::atomic<uint32_t> done_{ 0 };             //!< Ticket of the last finished job
+};
+
+template <class Args>
+uint32_t CommandWorker::post(void (*fn)(const Args&), const Args& args) {
+  static_assert(sizeof(Args) <= kArgsSize, "Arguments don't fit, increase kArgsSize");
+  static_assert(alignof(Args) <= 4, "Arguments are over-aligned");
+  static_assert(std::is_trivially_copyable_v<Args>, "Arguments are copied with memcpy");
+  Job job{ &invoke<Args>, reinterpret_cast<void (*)()>(fn), {} };
+  memcpy(job.args, &args, sizeof(Args));
+  return push(job);
+}
+
+#endif
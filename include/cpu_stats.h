@@ -0,0 +1,124 @@
+#ifndef CPU_STATS_H_
+#define CPU_STATS_H_
+
+/** @file cpu_stats.h
+ * CPU load and context switches of the tasks, over a sliding window
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct xTASK_STATUS;
+
+/**
+ * @brief FreeRTOS run time stats, counted with the DWT cycle counter, sampled by monitor_task once a second
+ *
+ */
+namespace cpu_stats {
+
+  constexpr size_t kMaxTasks = 8;  //!< Tasks with TCB number 1 to kMaxTasks are counted
+  constexpr size_t kSamples = 5;   //!< Snapshots kept, the window is up to kSamples - 1 seconds
+
+  /**
+   * @brief Counters of the tasks at one sample, indexed by TCB number - 1
+   *
+   */
+  struct Snapshot {
+    uint32_t time{ 0 };                          //!< Run time counter, cycles
+    std::array<uint32_t, kMaxTasks> run{};       //!< Run time of the task, cycles
+    std::array<uint32_t, kMaxTasks> switches{};  //!< Times the task was switched in
+  };
+
+  /**
+   * @brief Run time and switches of a task over a window
+   *
+   */
+  struct Load {
+    uint32_t run;       //!< Cycles in the window
+    uint32_t switches;  //!< Times switched in, in the window
+  };
+
+  /**
+   * @brief The last \p Samples snapshots, differences are correct across the wrap around of the counters
+   *
+   * The counters are 32 bit cycles, so a window shall be shorter than 2^32 cycles, 67 s at 64 MHz.
+   * @tparam Samples number of snapshots kept
+   */
+  template <size_t Samples>
+  class Window {
+  public:
+    static_assert(Samples > 1, "A window needs two snapshots");
+
+    /**
+     * @brief Adds a snapshot, the oldest one is dropped
+     *
+     */
+    void add(const Snapshot& snap) {
+      snaps_[next_] = snap;
+      next_ = next_ + 1 == Samples ? 0 : next_ + 1;
+      if (count_ < Samples) ++count_;
+    }
+
+    /**
+     * @brief Number of intervals kept, between the snapshots
+     *
+     */
+    size_t intervals() const {
+      return count_ ? count_ - 1 : 0;
+    }
+
+    /**
+     * @brief Differences between the newest snapshot and the one \p intervals before it
+     *
+     * @param intervals clamped to intervals()
+     * @param loads set to the differences of every task
+     * @return uint32_t length of the window in cycles, 0 if there are less than two snapshots
+     */
+    uint32_t diff(size_t intervals, std::array<Load, kMaxTasks>& loads) const {
+      if (intervals > this->intervals()) intervals = this->intervals();
+      if (intervals == 0) return 0;
+      const Snapshot& last = snaps_[(next_ + Samples - 1) % Samples];
+      const Snapshot& first = snaps_[(next_ + Samples - 1 - intervals) % Samples];
+      for (size_t i = 0; i < kMaxTasks; ++i) {
+        loads[i] = { last.run[i] - first.run[i], last.switches[i] - first.switches[i] };
+      }
+      return last.time - first.time;
+    }
+
+  private:
+    std::array<Snapshot, Samples> snaps_{};  //!< Ring of snapshots
+    size_t next_{ 0 };                       //!< Slot of the next snapshot
+    size_t count_{ 0 };                      //!< Snapshots stored
+  };
+
+  /**
+   * @brief \p part of \p whole in 0.1 %
+   *
+   */
+  constexpr uint32_t permille(uint32_t part, uint32_t whole) {
+    return whole ? static_cast<uint32_t>((static_cast<uint64_t>(part) * 1000 + whole / 2) / whole) : 0;
+  }
+
+  /**
+   * @brief Takes a snapshot of \p count task statuses from uxTaskGetSystemState()
+   *
+   * @param time total run time returned by uxTaskGetSystemState()
+   */
+  void sample(const xTASK_STATUS* statuses, size_t count, uint32_t time);
+
+  /**
+   * @brief Name of the task with TCB number \p number, nullptr until the task is sampled
+   *
+   */
+  const char* task_name(uint32_t number);
+
+  /**
+   * @brief Logs the load and switches of every task, and the idle time, over the last \p seconds
+   *
+   */
+  void report(size_t seconds);
+
+}  // namespace cpu_stats
+
+#endif  // CPU_STATS_H_
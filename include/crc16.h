@@ -0,0 +1,70 @@
+#ifndef CRC16_H_
+#define CRC16_H_
+
+/** @file crc16.h
+ * CRC-16/CCITT-FALSE, for binary frames
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF, no reflection, no final XOR
+ *
+ * On the target the CRC peripheral is used, elsewhere, e.g. in the host tools, the software implementation.
+ */
+namespace crc16 {
+
+  constexpr uint16_t kPolynomial = 0x1021;  //!< CRC polynomial
+  constexpr uint16_t kInit = 0xFFFF;        //!< Initial value
+
+  /**
+   * @brief CRC of every 4 bit value, for the software CRC
+   *
+   */
+  constexpr uint16_t kNibbleTable[16] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+                                          0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF };
+
+  /**
+   * @brief Software CRC, 4 bits at a time
+   *
+   * @param data input
+   * @param len length of input
+   * @return uint16_t CRC
+   */
+  inline uint16_t compute_sw(const uint8_t* data, size_t len) {
+    uint16_t crc = kInit;
+    for (size_t i = 0; i < len; ++i) {
+      crc = (crc << 4) ^ kNibbleTable[(crc >> 12) ^ (data[i] >> 4)];
+      crc = (crc << 4) ^ kNibbleTable[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+  }
+
+#ifdef USE_HAL_DRIVER
+  /**
+   * @brief Enables and configures the CRC peripheral
+   *
+   */
+  void init();
+
+  /**
+   * @brief CRC using the CRC peripheral, can be called from tasks and ISRs
+   *
+   * @param data input
+   * @param len length of input
+   * @return uint16_t CRC
+   */
+  uint16_t compute(const uint8_t* data, size_t len);
+#else
+  inline void init() {
+  }
+
+  inline uint16_t compute(const uint8_t* data, size_t len) {
+    return compute_sw(data, len);
+  }
+#endif
+
+}  // namespace crc16
+
+#endif  // CRC16_H_
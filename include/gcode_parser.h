@@ -10,6 +10,10 @@
 #include "main.h"
 #include <array>
 #include "parser.h"
+#include "command_worker.h"
+#include "macro_store.h"
+#include "ring_buffer.h"
+#include "uart.h"
 #include "FreeRTOS.h"
 #include "cmsis_os.h"
 #include "utils.h"
@@ -17,6 +21,12 @@
 /**
  * @brief Class to call gcodes parsed from null terminated string
  *
+ * Gcodes, which use the I2C bus, post their bus transfers to i2c_worker_ and return, so the gcodes after them don't
+ * wait for the bus, which the display holds for a whole frame. Such a gcode is pending until its job is done. The
+ * echo of a line acknowledges its completion, echoes are sent in the order of the lines, after the pending ones.
+ *
+ * Macros are recorded lines, which run on the device with one command, see A11 and A12. Their lines are dispatched
+ * like received lines, so a sequence of commands costs one UART round trip instead of one per command.
  */
 class GcodeParser {
 public:
@@ -33,27 +43,74 @@ public:
   void begin();
 
   /**
-   * @brief Parses the argument and calls the gcode
+   * @brief Parses the argument and calls the gcode, or the gcodes separated by ';' in order
    *
    * @param arr Null terminated array
    */
   void parse_and_call(const char* arr);
 
+  /**
+   * @brief Decodes a binary frame, checks the CRC, and calls the gcode
+   *
+   * @param frame COBS encoded frame, without the delimiter
+   * @param len length of frame
+   * @return true if the frame was valid
+   */
+  bool parse_and_call_frame(const uint8_t* frame, size_t len);
+
   /** @name Gcode Implementations
    *
    * Gcodes
    */
   ///@{
-  void A0(); /*!< Turns off LED*/
-  void A1(); /*!< Turns on LED*/
-  void A2(); /*!< Sets the RTC time*/
-  void A3(); /*!< Report the current time*/
+  void A0();  /*!< Turns off LED*/
+  void A1();  /*!< Turns on LED*/
+  void A2();  /*!< Sets the RTC time*/
+  void A3();  /*!< Report the current time*/
+  void A4();  /*!< Enables/disables deferred logging*/
+  void A5();  /*!< Sets the TX overflow policy, reports drops and waits*/
+  void A6();  /*!< Sets the RX timeout*/
+  void A7();  /*!< Enables/disables the advanced ok*/
+  void A8();  /*!< Switches between text and binary mode*/
+  void A9();  /*!< Sets and reports the line number*/
+  void A10(); /*!< Reports and resets the latency histograms*/
+  void A11(); /*!< Starts and ends recording a macro*/
+  void A12(); /*!< Runs a macro*/
+  void A13(); /*!< Lists, prints and removes macros*/
+  void A14(); /*!< Writes or reads RTC registers in bulk*/
+  void A15(); /*!< Reports the CPU load of the tasks*/
+  void A16(); /*!< Dumps the kernel event trace*/
   ///@}
 
+  static constexpr uint8_t kMaxAcks = 8;      /*!< Max echoes waiting for pending lines, then no lines are taken*/
+  static constexpr size_t kMacroSize = 256;   /*!< Bytes of the macro store, for names and lines*/
+  static constexpr size_t kMacroLineLen = 48; /*!< Longest macro line, after its arguments are substituted*/
+
 private:
+  /**
+   * @brief Echo of a line, sent when the I2C jobs posted until the line are done
+   *
+   */
+  struct Ack {
+    uint32_t ticket;           //!< Last I2C job of the line or before it
+    uint8_t len;               //!< Length of line
+    char line[Uart::kMsgLen];  //!< Copy of the line, the RX slot is reused
+  };
+
   Parser parser_;                  /*!< Parser */
   osThreadId_t gcode_task_handle_; /*!< gcode task handle*/
   const osThreadAttr_t kGcodeTaskAttr_ = utils::create_thread_attr("gcode_task", 150 * 4, osPriorityAboveNormal7);
+  CommandWorker i2c_worker_;       /*!< Runs the I2C transfers of gcodes*/
+  RingBuffer<Ack, kMaxAcks> acks_; /*!< Echoes waiting for pending lines*/
+  uint32_t line_event_{ 0 };       /*!< RX interrupt of the current line, cycle counter*/
+  uint32_t probe_queued_{ 0 };     /*!< The probed echo was queued, cycle counter*/
+  uint32_t lost_replies_{ 0 };     /*!< Probed echoes dropped by the TX policy, since the reset of the histograms*/
+  MacroStore<kMacroSize> macros_;  /*!< Recorded macros*/
+  MacroArgs macro_args_;           /*!< Arguments of the running macro*/
+  char macro_line_[kMacroLineLen]; /*!< Line of the running macro, with its arguments, not on the stack of gcode_task*/
+  bool in_macro_{ false };         /*!< A macro is running, macros can't be changed or run*/
+  std::string_view macro_body_;    /*!< Macro started by A12, run after A12 returns*/
+  uint32_t macro_count_{ 0 };      /*!< Runs of macro_body_ to do, 0 if no macro is started*/
 
   /**
    * @brief The gcode task, which calls gcodes
@@ -62,10 +119,86 @@ private:
   static void gcode_task(void*);
 
   /**
-   * @brief Parse gcodes beginning with 'A'
+   * @brief Calls the gcode set in parser_, found in the table of gcodes
+   *
+   */
+  void call();
+
+  /**
+   * @brief Appends \p line to the macro being recorded, reports if it doesn't fit
+   *
+   */
+  void record(const char* line);
+
+  /**
+   * @brief Runs the lines of macro_body_ macro_count_ times, with macro_args_, and L set to the iteration
+   * @details Called after A12 returns, and the lines are dispatched here, so the stack of gcode_task holds one command
+   * at a time, like for a received line. Waits while held. Stops at the first line with a missing argument, or when a
+   * reset is received.
+   */
+  void run_macro();
+
+  /**
+   * @brief Waits while the real-time hold is on, echoes the lines, whose jobs are done, meanwhile
+   *
+   * @return false if a reset is received
+   */
+  bool wait_if_held();
+
+  /**
+   * @brief Echoes \p msg, now if nothing is pending, otherwise after the pending lines
+   *
+   */
+  void ack(Uart::msg_t msg);
+
+  /**
+   * @brief Echoes the waiting lines, whose jobs are done, in order
+   *
+   */
+  void send_acks();
+
+  /**
+   * @brief Queues the echo of \p line, and probes its transfer time, if no other echo is probed
+   *
+   */
+  void echo(const char* line, size_t len);
+
+  /**
+   * @brief Counts the RX stages of the next line from its \p stamps, before it is run
+   *
+   */
+  void measure_line(Uart::RxStamps stamps);
+
+  /**
+   * @brief Counts the transfer time of the probed echo, once it is sent
+   *
+   */
+  void measure_reply();
+
+  /**
+   * @brief Logs the latency histograms of the commands and the stages
+   *
+   * @param buckets logs the buckets too
+   */
+  void report_latency(bool buckets);
+
+  /**
+   * @brief Zeroes the latency histograms
+   *
+   */
+  void reset_latency();
+
+  /**
+   * @brief Wakes gcode_task, called by i2c_worker_ after every job
+   *
+   */
+  static void on_job_done();
+
+  /**
+   * @brief Prints why the parameters of the command were rejected
    *
    */
-  void parse_A();
+  void report(const ParamError& error);
 
 public:
   GcodeParser(const GcodeParser&) = delete;
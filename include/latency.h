@@ -0,0 +1,206 @@
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+/** @file latency.h
+ * Latency histograms of the command path, measured with the DWT cycle counter
+ */
+
+#include <stm32f3xx_hal.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Cycle counter timestamps and log2 histograms of the command path
+ *
+ */
+namespace latency {
+
+  /**
+   * @brief Enables the DWT cycle counter
+   *
+   */
+  inline void init() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+
+  /**
+   * @brief Current value of the cycle counter, differences are correct across the wrap around
+   *
+   */
+  inline uint32_t now() {
+    return DWT->CYCCNT;
+  }
+
+  /**
+   * @brief Counts durations in power of 2 buckets
+   *
+   * Bucket 0 holds durations below 2^kFirstBits cycles, bucket n the ones from 2^(kFirstBits + n - 1), the last one
+   * everything longer. Counts are 16 bit, when one would overflow, all counts are halved, so the shape is kept and
+   * old samples fade out.
+   */
+  class Histogram {
+  public:
+    static constexpr size_t kBuckets = 16;      //!< Number of buckets
+    static constexpr uint32_t kFirstBits = 10;  //!< Bucket 0 is below 1024 cycles, 16 us at 64 MHz
+
+    /**
+     * @brief Bucket of \p cycles
+     *
+     */
+    static constexpr size_t bucket_of(uint32_t cycles) {
+      const size_t bits = cycles ? 32 - __builtin_clz(cycles) : 0;
+      if (bits <= kFirstBits) return 0;
+      return bits - kFirstBits < kBuckets ? bits - kFirstBits : kBuckets - 1;
+    }
+
+    /**
+     * @brief Durations in bucket \p i are below this, in cycles, except in the last bucket
+     *
+     */
+    static constexpr uint32_t upper_bound(size_t i) {
+      return uint32_t(1) << (kFirstBits + i);
+    }
+
+    /**
+     * @brief Counts a duration
+     *
+     */
+    void add(uint32_t cycles) {
+      const size_t i = bucket_of(cycles);
+      if (buckets_[i] == UINT16_MAX) {
+        for (auto& count : buckets_) count /= 2;
+      }
+      ++buckets_[i];
+      if (cycles > max_) max_ = cycles;
+    }
+
+    /**
+     * @brief Zeroes the counts
+     *
+     */
+    void reset() {
+      buckets_.fill(0);
+      max_ = 0;
+    }
+
+    /**
+     * @brief Count in bucket \p i
+     *
+     */
+    uint16_t bucket(size_t i) const {
+      return buckets_[i];
+    }
+
+    /**
+     * @brief Number of durations counted
+     *
+     */
+    uint32_t count() const {
+      uint32_t sum{ 0 };
+      for (const auto count : buckets_) sum += count;
+      return sum;
+    }
+
+    /**
+     * @brief Longest duration since reset, in cycles
+     *
+     */
+    uint32_t max() const {
+      return max_;
+    }
+
+    /**
+     * @brief Upper bound of the bucket, which holds percentile \p pct, in cycles
+     *
+     * @return uint32_t 0 if empty, max() if it is in the last bucket
+     */
+    uint32_t percentile(unsigned pct) const {
+      const uint32_t total = count();
+      if (total == 0) return 0;
+      // rank of the sample, rounded up
+      const uint32_t rank = (static_cast<uint64_t>(total) * pct + 99) / 100;
+      uint32_t seen{ 0 };
+      for (size_t i = 0; i < kBuckets - 1; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) return upper_bound(i) < max_ ? upper_bound(i) : max_;
+      }
+      return max_;
+    }
+
+  private:
+    std::array<uint16_t, kBuckets> buckets_{};  //!< Counts
+    uint32_t max_{ 0 };                         //!< Longest duration
+  };
+
+  /**
+   * @brief Stages of a command, from the RX interrupt to the echo on the wire
+   *
+   */
+  enum class Stage : uint8_t {
+    kQueue,  //!< RX interrupt to the line queued in rx_buff_
+    kWait,   //!< Queued to taken by gcode_task
+    kRun,    //!< Validation and handler of one command
+    kReply,  //!< Echo queued to the end of its TX DMA transfer
+    kCount,
+  };
+
+  /**
+   * @brief Name of \p stage for reports
+   *
+   */
+  const char* stage_name(Stage stage);
+
+  /**
+   * @brief Histograms of the stages, and of every command from the RX interrupt to its handler returning
+   *
+   * Written and read by gcode_task only.
+   * @tparam Commands number of commands, indexed by the caller
+   */
+  template <size_t Commands>
+  class Tracker {
+  public:
+    /**
+     * @brief Histogram of \p stage
+     *
+     */
+    Histogram& stage(Stage stage) {
+      return stages_[static_cast<size_t>(stage)];
+    }
+
+    /**
+     * @brief Histogram of command \p index
+     *
+     */
+    Histogram& command(size_t index) {
+      return commands_[index];
+    }
+
+    /**
+     * @brief Zeroes all histograms
+     *
+     */
+    void reset() {
+      for (auto& hist : stages_) hist.reset();
+      for (auto& hist : commands_) hist.reset();
+    }
+
+  private:
+    std::array<Histogram, static_cast<size_t>(Stage::kCount)> stages_{};  //!< Per stage
+    std::array<Histogram, Commands> commands_{};                          //!< Per command
+  };
+
+  /**
+   * @brief Logs count and max of \p hist in us, then p50, p90 and p99 on a second line
+   *
+   * @param name e.g. "A1" or a stage_name()
+   * @param buckets logs the non-empty buckets too
+   */
+  void report(const char* name, const Histogram& hist, bool buckets);
+
+}  // namespace latency
+
+#endif  // LATENCY_H_
@@ -0,0 +1,271 @@
+#ifndef LINE_CHECKER_H_
+#define LINE_CHECKER_H_
+
+/** @file line_checker.h
+ * Line numbers and checksums of received lines
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Checks numbered lines, and decides which line has to be sent again
+ *
+ * A numbered line is "N<line> <command>*<checksum>", the checksum is the XOR of all bytes before '*', like in
+ * Marlin. Numbered lines are accepted in order only: a corrupted, missing or dropped line is answered with a
+ * "Resend: <line>" request, and the lines after it are dropped, until the requested line arrives. Lines already
+ * accepted are answered with an ok, so the host learns the current line number. A numbered A9 command sets the line
+ * number, whatever the current one is.
+ *
+ * Lines without number are accepted as before, and they advance the line number too. They can't be requested again,
+ * so the ones, which find the queue full, are dropped, and counted in get_drops(). After the first numbered line,
+ * lines without number are treated as corrupted, e.g. the second half of a line split by noise, until a plain A9
+ * command ends numbered mode. Used in the RX ISR and in the host tools.
+ */
+class LineChecker {
+public:
+  /**
+   * @brief Result of parse()
+   *
+   */
+  enum class Format : uint8_t {
+    kPlain,        //!< No line number
+    kValid,        //!< Line number and checksum are correct
+    kNoChecksum,   //!< Line number without checksum
+    kBadChecksum,  //!< Checksum doesn't match, or it is not a number
+  };
+
+  /**
+   * @brief What to do with a received line
+   *
+   */
+  enum class Action : uint8_t {
+    kAccept,  //!< Queue the command
+    kResend,  //!< Drop it, and request get_resend_line()
+    kOk,      //!< Drop it, and send an ok with the current line number
+    kDrop,    //!< Drop it silently
+  };
+
+  /**
+   * @brief XOR of \p len bytes
+   *
+   */
+  static uint8_t checksum(const char* data, size_t len);
+
+  /**
+   * @brief Splits a line into number and command, and checks the checksum
+   *
+   * @param line received line
+   * @param number set to the line number
+   * @param cmd set to the command, without the number, checksum and leading spaces
+   * @return Format
+   */
+  static Format parse(std::string_view line, uint32_t& number, std::string_view& cmd);
+
+  /**
+   * @brief Is \p cmd an A9 command, which sets the line number?
+   *
+   */
+  static bool is_reset(std::string_view cmd);
+
+  /**
+   * @brief Decides what happens to a received line
+   *
+   * @param line received line, set to the command when accepted
+   * @param full true if there is no space for the command
+   * @return Action
+   */
+  Action check(std::string_view& line, bool full);
+
+  /**
+   * @brief Accepts a line without looking at it, e.g. a binary frame, which has its own CRC
+   *
+   * @param full true if there is no space for the command
+   * @return Action kAccept, or kDrop, which is counted in get_drops()
+   */
+  Action count(bool full);
+
+  /**
+   * @brief Have numbered lines been received since the last plain A9?
+   *
+   */
+  bool is_numbered() const {
+    return numbered_;
+  }
+
+  /**
+   * @brief Number of the last accepted line
+   *
+   */
+  uint32_t get_line() const {
+    return line_;
+  }
+
+  /**
+   * @brief Set the number of the last accepted line
+   *
+   */
+  void set_line(uint32_t line) {
+    line_ = line;
+    resend_ = 0;
+  }
+
+  /**
+   * @brief The line requested by the last kResend
+   *
+   */
+  uint32_t get_resend_line() const {
+    return resend_;
+  }
+
+  /**
+   * @brief Number of resend requests
+   *
+   */
+  uint32_t get_resends() const {
+    return resends_;
+  }
+
+  /**
+   * @brief Number of lines with missing or wrong checksum
+   *
+   */
+  uint32_t get_errors() const {
+    return errors_;
+  }
+
+  /**
+   * @brief Number of lines without number and binary frames dropped, because the queue was full
+   *
+   */
+  uint32_t get_drops() const {
+    return drops_;
+  }
+
+private:
+  /**
+   * @brief Requests \p line, once, or every time when \p force is set
+   *
+   */
+  Action request(uint32_t line, bool force);
+
+  volatile uint32_t line_{ 0 };      //!< Number of the last accepted line
+  volatile uint32_t resend_{ 0 };    //!< Requested line, 0 if nothing is requested
+  volatile uint32_t resends_{ 0 };   //!< Number of resend requests
+  volatile uint32_t errors_{ 0 };    //!< Number of corrupted lines
+  volatile uint32_t drops_{ 0 };     //!< Number of lost lines, which can't be requested again
+  volatile bool numbered_{ false };  //!< Lines must be numbered
+};
+
+
+
+inline uint8_t LineChecker::checksum(const char* data, size_t len) {
+  uint8_t sum{ 0 };
+  for (size_t i = 0; i < len; ++i) {
+    sum ^= static_cast<uint8_t>(data[i]);
+  }
+  return sum;
+}
+
+inline LineChecker::Format LineChecker::parse(std::string_view line, uint32_t& number, std::string_view& cmd) {
+  const auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+  size_t i = line.find_first_not_of(' ');
+  cmd = line.substr(i == std::string_view::npos ? line.size() : i);
+  if (cmd.size() < 2 || cmd[0] != 'N' || !is_digit(cmd[1])) {
+    return Format::kPlain;
+  }
+
+  number = 0;
+  for (++i; i < line.size() && is_digit(line[i]); ++i) {
+    number = number * 10 + (line[i] - '0');
+  }
+
+  const size_t star = line.rfind('*');
+  if (star == std::string_view::npos || star < i) {
+    return Format::kNoChecksum;
+  }
+
+  uint32_t sum{ 0 };
+  size_t digits{ 0 };
+  for (size_t j = star + 1; j < line.size() && line[j] != ' '; ++j, ++digits) {
+    if (!is_digit(line[j])) return Format::kBadChecksum;
+    sum = sum * 10 + (line[j] - '0');
+  }
+  if (digits == 0 || digits > 3 || sum != checksum(line.data(), star)) {
+    return Format::kBadChecksum;
+  }
+
+  // the command without the spaces around it
+  cmd = line.substr(i, star - i);
+  const size_t first = cmd.find_first_not_of(' ');
+  if (first == std::string_view::npos) {
+    cmd = cmd.substr(cmd.size());
+  } else {
+    cmd = cmd.substr(first, cmd.find_last_not_of(' ') + 1 - first);
+  }
+  return Format::kValid;
+}
+
+inline bool LineChecker::is_reset(std::string_view cmd) {
+  return cmd.size() >= 2 && cmd[0] == 'A' && cmd[1] == '9' && (cmd.size() == 2 || cmd[2] < '0' || cmd[2] > '9');
+}
+
+inline LineChecker::Action LineChecker::check(std::string_view& line, bool full) {
+  uint32_t number{ 0 };
+  std::string_view cmd;
+
+  switch (parse(line, number, cmd)) {
+    case Format::kPlain:
+      if (is_reset(cmd)) {
+        numbered_ = false;
+      } else if (numbered_) {
+        errors_ = errors_ + 1;
+        return request(line_ + 1, true);
+      }
+      return count(full);
+
+    case Format::kValid:
+      break;
+
+    default:
+      // the line number can't be trusted, ask for the next one every time
+      errors_ = errors_ + 1;
+      return request(line_ + 1, true);
+  }
+
+  const bool reset = is_reset(cmd);
+  if (!reset && number <= line_) {
+    // already accepted, the ok tells the host where we are
+    return full ? Action::kDrop : Action::kOk;
+  }
+  if (!reset && number != line_ + 1) {
+    return request(line_ + 1, false);
+  }
+  if (full) {
+    return request(number, false);
+  }
+  set_line(number);
+  numbered_ = true;
+  line = cmd;
+  return Action::kAccept;
+}
+
+inline LineChecker::Action LineChecker::count(bool full) {
+  if (full) {
+    drops_ = drops_ + 1;
+    return Action::kDrop;
+  }
+  set_line(line_ + 1);
+  return Action::kAccept;
+}
+
+inline LineChecker::Action LineChecker::request(uint32_t line, bool force) {
+  // the lines in flight after a missing one would request it again
+  if (!force && resend_ == line) return Action::kDrop;
+  resend_ = line;
+  resends_ = resends_ + 1;
+  return Action::kResend;
+}
+
+#endif  // LINE_CHECKER_H_
@@ -0,0 +1,221 @@
+#ifndef LINE_FRAMER_H_
+#define LINE_FRAMER_H_
+
+/** @file line_framer.h
+ * Splits the byte stream in a circular DMA buffer into lines
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * @brief Owns the buffer of a circular RX DMA, and cuts the received stream into lines
+ *
+ * process() is called with the DMA write index on half transfer, transfer complete and receiver timeout events. It
+ * scans only the new bytes, so any number of lines can arrive in one burst, and a line can span several events.
+ * '\n' and '\r' end a line, empty lines are skipped. In binary mode, only '\0' ends a frame, e.g. a COBS frame.
+ *
+ * Lines are not copied: the line ending is replaced by '\0', and the view points into the DMA buffer. Only a line,
+ * which wraps around the end of the buffer, is copied into a scratch buffer. A view is valid, until the DMA writes
+ * N more bytes. Every received byte counts, also the ones of dropped lines, real-time bytes and line endings, so a
+ * line, which is kept for later, shall be copied into a Line.
+ *
+ * In text mode, bytes for which on_realtime() returns true are taken out of the stream, wherever they are, even inside
+ * a line. The bytes of the line before it are moved up by one, so the line stays contiguous.
+ *
+ * Lines longer than MaxLen - 1 are dropped.
+ * @tparam N size of the DMA buffer, even, so the half transfer event splits it in two
+ * @tparam MaxLen max length of a line, including the terminator
+ */
+template <size_t N, size_t MaxLen>
+class LineFramer {
+public:
+  static_assert(N % 2 == 0, "Half transfer event needs even size");
+  static_assert(MaxLen > 1 && MaxLen <= N / 2, "Line must fit into half of the buffer");
+
+  /**
+   * @brief Copy of a line, it stays valid when the DMA overwrites the buffer
+   *
+   */
+  struct Line {
+    std::array<char, MaxLen> data;  //!< The line, null-terminated
+    size_t size;                    //!< Length of the line, without the terminator
+
+    /**
+     * @brief Copies \p line, at most MaxLen - 1 bytes
+     *
+     */
+    void assign(std::string_view line) {
+      size = line.size() < MaxLen ? line.size() : MaxLen - 1;
+      memcpy(data.data(), line.data(), size);
+      data[size] = '\0';
+    }
+
+    /**
+     * @brief The copied line, null-terminated
+     *
+     */
+    std::string_view view() const {
+      return std::string_view(data.data(), size);
+    }
+  };
+
+  /**
+   * @brief Restarts framing from the start of the buffer
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Switch between text lines and 0 delimited binary frames
+   *
+   */
+  void set_binary(bool binary) {
+    binary_ = binary;
+  }
+
+  /**
+   * @brief The buffer to be filled by DMA
+   *
+   */
+  uint8_t* data() {
+    return reinterpret_cast<uint8_t*>(buffer_.data());
+  }
+
+  /**
+   * @brief Size of the buffer
+   *
+   */
+  static constexpr size_t size() {
+    return N;
+  }
+
+  /**
+   * @brief Scans the bytes received since the last call
+   *
+   * @param write_index index of the next byte DMA will write, N - CNDTR
+   * @param on_line called with every complete line, as a null-terminated view
+   * @param on_realtime called with every byte in text mode, before framing, returns true to remove the byte
+   * @return size_t number of lines found
+   */
+  template <class F, class R>
+  size_t process(size_t write_index, F&& on_line, R&& on_realtime);
+
+  /**
+   * @brief Scans the bytes received since the last call, without real-time bytes
+   *
+   * @see process(size_t, F&&, R&&)
+   */
+  template <class F>
+  size_t process(size_t write_index, F&& on_line) {
+    return process(write_index, on_line, [](char) { return false; });
+  }
+
+  /**
+   * @brief Drops the partial line, the bytes up to the next line ending are skipped
+   *
+   */
+  void drop_line() {
+    discard_ = discard_ || len_ != 0;
+  }
+
+  /**
+   * @brief Number of dropped lines, which were too long
+   *
+   */
+  uint32_t get_overlong() const {
+    return overlong_;
+  }
+
+private:
+  /**
+   * @brief Makes a view of the current line, which ends at read_ - 1
+   *
+   */
+  std::string_view make_view();
+
+  /**
+   * @brief Removes the byte before read_, by moving the current line up by one
+   *
+   */
+  void remove_last();
+
+  std::array<char, N> buffer_{};        //!< DMA buffer
+  std::array<char, MaxLen> scratch_{};  //!< Holds a line, which wraps around the end of buffer_
+  size_t read_{ 0 };                    //!< Index of the next byte to scan
+  size_t start_{ 0 };                   //!< Index of the first byte of the current line
+  size_t len_{ 0 };                     //!< Length of the current line
+  bool discard_{ false };               //!< Current line is too long, skip until line ending
+  volatile bool binary_{ false };       //!< Frames end with '\0' instead of newline
+  uint32_t overlong_{ 0 };              //!< Number of dropped lines
+};
+
+
+
+template <size_t N, size_t MaxLen>
+inline void LineFramer<N, MaxLen>::reset() {
+  read_ = start_ = len_ = 0;
+  discard_ = false;
+}
+
+template <size_t N, size_t MaxLen>
+template <class F, class R>
+inline size_t LineFramer<N, MaxLen>::process(size_t write_index, F&& on_line, R&& on_realtime) {
+  if (write_index >= N) write_index = 0;
+  size_t lines{ 0 };
+
+  while (read_ != write_index) {
+    char& c = buffer_[read_];
+    if (++read_ == N) read_ = 0;
+
+    if (!binary_ && on_realtime(c)) {
+      remove_last();
+    } else if (binary_ ? c == '\0' : (c == '\n' || c == '\r')) {
+      if (len_ && !discard_) {
+        c = '\0';
+        on_line(make_view());
+        ++lines;
+      }
+      start_ = read_;
+      len_ = 0;
+      discard_ = false;
+    } else if (!discard_ && ++len_ >= MaxLen) {
+      discard_ = true;
+      ++overlong_;
+    }
+  }
+  return lines;
+}
+
+template <size_t N, size_t MaxLen>
+inline void LineFramer<N, MaxLen>::remove_last() {
+  if (!discard_) {
+    // at most MaxLen - 1 bytes, from the end of the line backwards
+    size_t to = read_ == 0 ? N - 1 : read_ - 1;
+    for (size_t i = 0; i < len_; ++i) {
+      const size_t from = to == 0 ? N - 1 : to - 1;
+      buffer_[to] = buffer_[from];
+      to = from;
+    }
+  }
+  if (++start_ == N) start_ = 0;
+}
+
+template <size_t N, size_t MaxLen>
+inline std::string_view LineFramer<N, MaxLen>::make_view() {
+  if (start_ + len_ < N) {
+    // the terminator is in place
+    return std::string_view(&buffer_[start_], len_);
+  }
+
+  const size_t first = N - start_;
+  memcpy(scratch_.data(), &buffer_[start_], first);
+  memcpy(scratch_.data() + first, buffer_.data(), len_ - first);
+  scratch_[len_] = '\0';
+  return std::string_view(scratch_.data(), len_);
+}
+
+#endif  // LINE_FRAMER_H_
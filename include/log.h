@@ -0,0 +1,44 @@
+#ifndef LOG_H_
+#define LOG_H_
+
+/**
+ * @file log.h
+ * @brief Logging macros, which support deferred formatting
+ *
+ * Format strings are placed into the log_fmt section, their offset in the section is the format ID.
+ * When deferred logging is enabled, only the ID and the arguments are transmitted, and the host restores the text
+ * from the ELF file using tools/log_decoder.cpp. Otherwise the message is formatted on the target, like printf.
+ * Only integer, enum and floating point arguments are supported, use uart2.printf() for strings.
+ */
+
+#include "uart.h"
+
+/**
+ * @brief Start of the log_fmt section, defined by the linker
+ *
+ */
+extern "C" const char __start_log_fmt[];
+
+/**
+ * @brief Places \p fmt into the log_fmt section and logs through uart2
+ *
+ */
+#define LOG_IMPL(from_isr, fmt, ...)                                                     \
+  do {                                                                                   \
+    static const char log_fmt_[] __attribute__((section("log_fmt"), used)) = fmt;        \
+    uart2.log(from_isr, log_fmt_, ##__VA_ARGS__);                                        \
+  } while (0)
+
+/**
+ * @brief Log from a task, waits for space according to the TX policy
+ *
+ */
+#define LOG(fmt, ...) LOG_IMPL(false, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief Log from an ISR
+ *
+ */
+#define LOG_ISR(fmt, ...) LOG_IMPL(true, fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef MACRO_STORE_H_
+#define MACRO_STORE_H_
+
+/** @file macro_store.h
+ * Named command macros in RAM, and the substitution of their arguments
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * @brief Arguments of a macro run, substituted for "#<letter>" in its lines
+ *
+ */
+struct MacroArgs {
+  std::array<int32_t, 26> values{};  //!< Value of 'A' + n
+  uint32_t given{ 0 };               //!< Bit n is set, if 'A' + n was given
+
+  /**
+   * @brief Sets the argument \p letter, 'A' to 'Z'
+   *
+   */
+  void set(char letter, int32_t value) {
+    values[letter - 'A'] = value;
+    given |= uint32_t(1) << (letter - 'A');
+  }
+
+  /**
+   * @brief Gets the argument \p letter
+   *
+   * @return true if it was given
+   */
+  bool get(char letter, int32_t& value) const {
+    if (letter < 'A' || letter > 'Z' || !(given & (uint32_t(1) << (letter - 'A')))) return false;
+    value = values[letter - 'A'];
+    return true;
+  }
+};
+
+/**
+ * @brief Copies \p line to \p out, and replaces every "#<letter>" by the decimal value of the argument
+ *
+ * @param out null-terminated result
+ * @param size size of \p out
+ * @param missing set to the letter of a missing argument, or 0 if the result doesn't fit
+ * @return true on success
+ */
+inline bool expand_macro_line(std::string_view line, const MacroArgs& args, char* out, size_t size, char& missing) {
+  size_t len{ 0 };
+  for (size_t i = 0; i < line.size(); ++i) {
+    char digits[12];
+    size_t n{ 0 };
+    if (line[i] == '#' && i + 1 < line.size()) {
+      int32_t val{ 0 };
+      if (!args.get(line[++i], val)) {
+        missing = line[i];
+        return false;
+      }
+      uint32_t mag = val < 0 ? 0u - static_cast<uint32_t>(val) : static_cast<uint32_t>(val);
+      do {
+        digits[n++] = '0' + mag % 10;
+        mag /= 10;
+      } while (mag);
+      if (val < 0) digits[n++] = '-';
+    } else {
+      digits[n++] = line[i];
+    }
+    if (len + n >= size) {
+      missing = 0;
+      return false;
+    }
+    while (n) out[len++] = digits[--n];
+  }
+  out[len] = '\0';
+  return true;
+}
+
+/**
+ * @brief Named macros, stored back to back in a fixed RAM buffer
+ *
+ * A macro is a name and a body of lines, each ended by '\n'. It is recorded line by line: begin() replaces the macro
+ * of the same name with an empty one at the end of the buffer, append() adds lines to it, until end(). Removing a
+ * macro moves the ones after it down, so the free space is always at the end. Entry layout: name length, body length
+ * (16 bit little endian), name, body.
+ *
+ * Not thread safe, used by gcode_task only.
+ * @tparam Size size of the buffer in bytes
+ */
+template <size_t Size>
+class MacroStore {
+public:
+  static constexpr size_t kMaxName = 8;  //!< Longest name
+
+  /**
+   * @brief Starts recording \p name, the macro of the same name is removed
+   *
+   * @return false if the name is empty or too long, or the buffer is full
+   */
+  bool begin(std::string_view name);
+
+  /**
+   * @brief Appends \p line to the macro being recorded
+   * @details If it doesn't fit, the macro is removed, and recording stops
+   * @return false if not recording, or it doesn't fit
+   */
+  bool append(std::string_view line);
+
+  /**
+   * @brief Stops recording, the macro is kept
+   *
+   */
+  void end() {
+    recording_ = kNone;
+  }
+
+  /**
+   * @brief Is a macro being recorded?
+   *
+   */
+  bool is_recording() const {
+    return recording_ != kNone;
+  }
+
+  /**
+   * @brief Finds the macro \p name
+   *
+   * @param body set to its lines, valid until the store is changed
+   * @return true if found
+   */
+  bool find(std::string_view name, std::string_view& body) const;
+
+  /**
+   * @brief Removes the macro \p name, stops recording it
+   *
+   * @return true if it was found
+   */
+  bool remove(std::string_view name);
+
+  /**
+   * @brief Calls \p fn with the name and the body of every macro, in the order they were recorded
+   *
+   */
+  template <class F>
+  void for_each(F&& fn) const {
+    for (size_t pos = 0; pos < used_; pos += entry_size(pos)) fn(name_at(pos), body_at(pos));
+  }
+
+  /**
+   * @brief Bytes left for new macros and lines
+   *
+   */
+  size_t get_free() const {
+    return Size - used_;
+  }
+
+  /**
+   * @brief Removes the first line of \p body
+   *
+   * @param line set to the line, without '\n'
+   * @return false if \p body is empty
+   */
+  static bool next_line(std::string_view& body, std::string_view& line) {
+    if (body.empty()) return false;
+    const size_t end = body.find('\n');
+    line = body.substr(0, end);
+    body.remove_prefix(end == std::string_view::npos ? body.size() : end + 1);
+    return true;
+  }
+
+private:
+  static constexpr size_t kHeader = 3;       //!< Name length and body length
+  static constexpr uint16_t kNone = 0xFFFF;  //!< Not recording
+
+  static_assert(Size > kHeader + kMaxName && Size < kNone, "Lengths are stored in 16 bits");
+
+  size_t body_len(size_t pos) const {
+    return buff_[pos + 1] | (buff_[pos + 2] << 8);
+  }
+
+  void set_body_len(size_t pos, size_t len) {
+    buff_[pos + 1] = static_cast<uint8_t>(len);
+    buff_[pos + 2] = static_cast<uint8_t>(len >> 8);
+  }
+
+  size_t entry_size(size_t pos) const {
+    return kHeader + buff_[pos] + body_len(pos);
+  }
+
+  std::string_view name_at(size_t pos) const {
+    return { reinterpret_cast<const char*>(&buff_[pos + kHeader]), buff_[pos] };
+  }
+
+  std::string_view body_at(size_t pos) const {
+    return { reinterpret_cast<const char*>(&buff_[pos + kHeader + buff_[pos]]), body_len(pos) };
+  }
+
+  /**
+   * @brief Offset of the macro \p name, or used_
+   *
+   */
+  size_t offset_of(std::string_view name) const {
+    size_t pos{ 0 };
+    while (pos < used_ && name_at(pos) != name) pos += entry_size(pos);
+    return pos;
+  }
+
+  std::array<uint8_t, Size> buff_{};  //!< The macros
+  uint16_t used_{ 0 };                //!< Used bytes
+  uint16_t recording_{ kNone };       //!< Offset of the macro being recorded
+};
+
+
+
+template <size_t Size>
+inline bool MacroStore<Size>::begin(std::string_view name) {
+  end();
+  if (name.empty() || name.size() > kMaxName) return false;
+  remove(name);
+  if (get_free() < kHeader + name.size()) return false;
+
+  buff_[used_] = static_cast<uint8_t>(name.size());
+  set_body_len(used_, 0);
+  memcpy(&buff_[used_ + kHeader], name.data(), name.size());
+  recording_ = used_;
+  used_ += kHeader + name.size();
+  return true;
+}
+
+template <size_t Size>
+inline bool MacroStore<Size>::append(std::string_view line) {
+  if (!is_recording()) return false;
+  if (get_free() < line.size() + 1) {
+    // a partial macro would run the wrong commands
+    used_ = recording_;
+    end();
+    return false;
+  }
+  memcpy(&buff_[used_], line.data(), line.size());
+  buff_[used_ + line.size()] = '\n';
+  used_ += line.size() + 1;
+  set_body_len(recording_, body_len(recording_) + line.size() + 1);
+  return true;
+}
+
+template <size_t Size>
+inline bool MacroStore<Size>::find(std::string_view name, std::string_view& body) const {
+  const size_t pos = offset_of(name);
+  if (pos == used_) return false;
+  body = body_at(pos);
+  return true;
+}
+
+template <size_t Size>
+inline bool MacroStore<Size>::remove(std::string_view name) {
+  const size_t pos = offset_of(name);
+  if (pos == used_) return false;
+  const size_t len = entry_size(pos);
+  memmove(&buff_[pos], &buff_[pos + len], used_ - pos - len);
+  used_ -= len;
+  if (recording_ == pos) {
+    end();
+  } else if (is_recording() && recording_ > pos) {
+    recording_ -= len;
+  }
+  return true;
+}
+
+#endif  // MACRO_STORE_H_
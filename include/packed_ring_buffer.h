@@ -0,0 +1,341 @@
+#ifndef PACKED_RING_BUFFER_H_
+#define PACKED_RING_BUFFER_H_
+
+/** @file packed_ring_buffer.h
+ * templated inline lock-free ring buffer of variable length byte records
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/**
+ * @brief Multi producer, single consumer ring buffer, which stores variable length byte records back to back
+ *
+ * Every record is prefixed by a small header and padded to 4 bytes, so a 3 byte message costs 12 bytes instead of
+ * a fixed size slot. A record is always contiguous in memory. If it doesn't fit before the end of the buffer, the
+ * rest of the buffer is skipped and the record is placed at the start.
+ *
+ * Usage is the same as for RingBuffer: get_next_free() reserves space, push() commits it, get_next_occupied() and
+ * pop() are used by the consumer.
+ *
+ * Producers reserve space with a compare and swap on the write counter (LDREX/STREX on Cortex-M4), so tasks and ISRs
+ * can write concurrently without disabling interrupts. Each record has its own commit flag: the header holds the
+ * write counter value of the record, which is stored last, with release semantics. The consumer stops at the first
+ * record which was not pushed yet, even if records after it are complete. Consumed space is zeroed, so a stale
+ * header can't be mistaken for a committed one.
+ *
+ * IMPORTANT: get_next_occupied() and pop() shall be called by one consumer only
+ * @tparam L The size of the buffer in bytes, power of 2
+ */
+template <size_t L>
+class PackedRingBuffer {
+  // types
+public:
+  static constexpr size_t buffer_size_ = L;
+
+  /**
+   * @brief Header in front of every record
+   *
+   */
+  struct header_t {
+    uint16_t size;              //!< Reserved payload bytes, multiple of 4
+    uint16_t len;               //!< Used payload bytes, or kPadding
+    std::atomic<uint32_t> tag;  //!< Write counter + 1 when committed
+  };
+  static constexpr size_t header_size_ = sizeof(header_t);
+  static constexpr uint16_t kPadding = 0xFFFF;                     //!< Record is skipped by the consumer
+  static constexpr size_t max_record_len_ = L / 2 - header_size_;  //!< Largest record, which can always fit
+
+  static_assert(L >= 32 && (L & (L - 1)) == 0, "Buffer size must be power of 2");
+  static_assert(L <= 0x8000, "Record sizes are stored in 16 bits");
+  static_assert(header_size_ == 8, "Unexpected header layout");
+
+  // interface
+public:
+  /**
+   * @brief Drops all data, IMPORTANT: not thread safe
+   *
+   */
+  void reset();
+
+  // data manipulation
+  /**
+   * @brief Reserve \p len contiguous bytes
+   *
+   * @param len number of bytes to reserve
+   * @return uint8_t* pointer to the reserved space, or nullptr if there is not enough space
+   */
+  uint8_t* get_next_free(size_t len);
+
+  /**
+   * @brief Commits a record reserved by get_next_free()
+   * @details If this is the last reservation, unused space is given back to the buffer
+   * @param ptr pointer returned by get_next_free()
+   * @param len number of bytes written, at most the reserved size. 0 discards the record
+   */
+  void push(uint8_t* ptr, size_t len);
+
+  /**
+   * @brief Get the next record
+   *
+   * @param len set to the length of the record
+   * @return const uint8_t* pointer to the record, or nullptr if empty or the next record was not pushed yet
+   */
+  const uint8_t* get_next_occupied(size_t& len);
+
+  /**
+   * @brief Removes the record returned by get_next_occupied()
+   *
+   */
+  void pop();
+
+  /**
+   * @brief Discards the oldest pushed records, to make room for new ones
+   * @details Records are turned into padding. Without a kept front record the space is given back right away,
+   * otherwise when the consumer pops the front record.
+   * IMPORTANT: this is a consumer operation, shall not run concurrently with get_next_occupied() or pop()
+   * @param bytes number of bytes needed
+   * @param keep_front when true, the first record is kept, e.g. because it is being read by DMA
+   * @return size_t number of records dropped
+   */
+  size_t drop_oldest(size_t bytes, bool keep_front);
+
+  // states
+  /**
+   * @brief Check if buffer is empty
+   *
+   * @return true if empty
+   */
+  bool is_empty() const;
+
+  /**
+   * @brief Check if the front record, or padding, was pushed, without removing anything
+   * @details Read-only, unlike get_next_occupied(), so it can be called by anyone, e.g. to decide whether to take
+   * the consumer role
+   * @return true if get_next_occupied() would make progress
+   */
+  bool has_pushed() const;
+
+  /**
+   * @brief Get the number of bytes used, including headers and padding
+   *
+   * @return size_t
+   */
+  size_t bytes_used() const;
+
+  // implementation
+private:
+  /**
+   * @brief Converts record length to the number of bytes it occupies in buffer
+   *
+   */
+  static constexpr size_t record_size(size_t len) {
+    return header_size_ + ((len + 3) & ~size_t(3));
+  }
+
+  /**
+   * @brief Number of bytes to skip at \p index, because a header doesn't fit before the end
+   *
+   */
+  static constexpr size_t unusable_tail(uint32_t index) {
+    const size_t to_end = L - (index & (L - 1));
+    return to_end < header_size_ ? to_end : 0;
+  }
+
+  header_t* header_at(uint32_t index) {
+    return reinterpret_cast<header_t*>(&buffer_[index & (L - 1)]);
+  }
+
+  const header_t* header_at(uint32_t index) const {
+    return reinterpret_cast<const header_t*>(&buffer_[index & (L - 1)]);
+  }
+
+  /**
+   * @brief Zeroes \p len bytes from \p index and moves read_ behind them
+   *
+   */
+  void release(uint32_t index, size_t len);
+
+  /**
+   * @brief The buffer
+   *
+   */
+  alignas(header_t) std::array<uint8_t, L> buffer_{};
+
+  /**
+   * @brief Free running byte counters
+   *
+   * Position in the buffer is the counter masked by L - 1, used space is write_ - read_
+   */
+  std::atomic<uint32_t> write_{ 0 };
+  std::atomic<uint32_t> read_{ 0 };
+};
+
+
+
+template <size_t L>
+inline void PackedRingBuffer<L>::reset() {
+  buffer_.fill(0);
+  write_.store(0);
+  read_.store(0);
+}
+
+template <size_t L>
+inline uint8_t* PackedRingBuffer<L>::get_next_free(size_t len) {
+  if (len > max_record_len_) return nullptr;
+
+  const size_t need = record_size(len);
+  uint32_t w = write_.load(std::memory_order_relaxed);
+  size_t skip{ 0 };
+
+  do {
+    const size_t to_end = L - (w & (L - 1));
+    // doesn't fit before the end, continue from the start
+    skip = need > to_end ? to_end : 0;
+    if (w - read_.load(std::memory_order_acquire) + skip + need > L) {
+      return nullptr;
+    }
+  } while (!write_.compare_exchange_weak(w, w + skip + need, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+  // the space from w is ours now
+  if (skip >= header_size_) {
+    auto pad = header_at(w);
+    pad->size = skip - header_size_;
+    pad->len = kPadding;
+    pad->tag.store(w + 1, std::memory_order_release);
+  }
+  w += skip;
+
+  auto hdr = header_at(w);
+  hdr->size = need - header_size_;
+  return reinterpret_cast<uint8_t*>(hdr) + header_size_;
+}
+
+template <size_t L>
+inline void PackedRingBuffer<L>::push(uint8_t* ptr, size_t len) {
+  auto hdr = reinterpret_cast<header_t*>(ptr - header_size_);
+  const uint32_t offset = reinterpret_cast<uint8_t*>(hdr) - buffer_.data();
+
+  // recover the write counter of this record, it is at most L behind the current one
+  uint32_t w = write_.load(std::memory_order_acquire);
+  const uint32_t behind = (w - offset) & (L - 1);
+  const uint32_t start = w - (behind ? behind : L);
+
+  // give back the unused space, if no one reserved after this record
+  const size_t new_size = record_size(len) - header_size_;
+  if (new_size < hdr->size) {
+    memset(ptr + new_size, 0, hdr->size - new_size);
+    uint32_t expected = start + header_size_ + hdr->size;
+    if (write_.compare_exchange_strong(expected, start + header_size_ + new_size, std::memory_order_acq_rel)) {
+      hdr->size = new_size;
+    }
+  }
+
+  hdr->len = len ? len : kPadding;
+  hdr->tag.store(start + 1, std::memory_order_release);
+}
+
+template <size_t L>
+inline const uint8_t* PackedRingBuffer<L>::get_next_occupied(size_t& len) {
+  while (!is_empty()) {
+    const uint32_t r = read_.load(std::memory_order_relaxed);
+    if (const size_t tail = unusable_tail(r)) {
+      release(r, tail);
+      continue;
+    }
+    const auto hdr = header_at(r);
+    if (hdr->tag.load(std::memory_order_acquire) != r + 1) {
+      // not pushed yet
+      return nullptr;
+    }
+    if (hdr->len == kPadding) {
+      release(r, header_size_ + hdr->size);
+      continue;
+    }
+    len = hdr->len;
+    return reinterpret_cast<const uint8_t*>(hdr) + header_size_;
+  }
+  return nullptr;
+}
+
+template <size_t L>
+inline void PackedRingBuffer<L>::pop() {
+  const uint32_t r = read_.load(std::memory_order_relaxed);
+  const auto hdr = header_at(r);
+  if (is_empty() || hdr->tag.load(std::memory_order_acquire) != r + 1) return;
+  release(r, header_size_ + hdr->size);
+}
+
+template <size_t L>
+inline size_t PackedRingBuffer<L>::drop_oldest(size_t bytes, bool keep_front) {
+  const uint32_t first = read_.load(std::memory_order_relaxed);
+  const uint32_t w = write_.load(std::memory_order_acquire);
+  uint32_t r = first;
+  size_t freed{ 0 }, dropped{ 0 };
+
+  while (r != w && freed < bytes) {
+    if (const size_t tail = unusable_tail(r)) {
+      r += tail;
+      freed += tail;
+      continue;
+    }
+    const auto hdr = header_at(r);
+    if (hdr->tag.load(std::memory_order_acquire) != r + 1) {
+      // not pushed yet, the records after it can't be reached either
+      break;
+    }
+    const size_t size = header_size_ + hdr->size;
+    if (keep_front && hdr->len != kPadding) {
+      keep_front = false;
+      freed = 0;
+    } else {
+      if (hdr->len != kPadding) {
+        hdr->len = kPadding;
+        ++dropped;
+      }
+      freed += size;
+    }
+    r += size;
+  }
+
+  // nothing is kept in front, the space can be given back right away
+  if (freed == r - first) {
+    release(first, freed);
+  }
+  return dropped;
+}
+
+template <size_t L>
+inline void PackedRingBuffer<L>::release(uint32_t index, size_t len) {
+  // dropped records may wrap around the end of the buffer
+  const size_t offset = index & (L - 1);
+  const size_t to_end = L - offset < len ? L - offset : len;
+  memset(&buffer_[offset], 0, to_end);
+  memset(&buffer_[0], 0, len - to_end);
+  read_.store(index + len, std::memory_order_release);
+}
+
+template <size_t L>
+inline bool PackedRingBuffer<L>::is_empty() const {
+  return read_.load(std::memory_order_acquire) == write_.load(std::memory_order_acquire);
+}
+
+template <size_t L>
+inline bool PackedRingBuffer<L>::has_pushed() const {
+  const uint32_t w = write_.load(std::memory_order_acquire);
+  const uint32_t r = read_.load(std::memory_order_acquire);
+  if (r == w) return false;
+  // an unusable tail is given back by get_next_occupied() too
+  if (unusable_tail(r)) return true;
+  return header_at(r)->tag.load(std::memory_order_acquire) == r + 1;
+}
+
+template <size_t L>
+inline size_t PackedRingBuffer<L>::bytes_used() const {
+  return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+}
+
+#endif  // PACKED_RING_BUFFER_H_
@@ -0,0 +1,181 @@
+#ifndef PARAM_SCHEMA_H_
+#define PARAM_SCHEMA_H_
+
+/** @file param_schema.h
+ * Compile-time declarations of command parameters, checked by Parser::validate()
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Declares a parameter: letter, type, range, and whether it is required or has a default
+ *
+ * Made with the factories, e.g. ParamSpec::integer('S', 0, 59).required(), and placed in a ParamSchema.
+ */
+struct ParamSpec {
+  /**
+   * @brief Value type of a parameter
+   *
+   */
+  enum class Type : uint8_t {
+    kFlag,     //!< Any value or none, only its presence matters
+    kInteger,  //!< Integer within min and max
+    kFixed,    //!< Decimal number, rounded to decimals places, within min and max as fixed point
+    kString,   //!< Quoted string, its length within min and max
+    kArray,    //!< Array of integers, see ParamArray, every element within min and max
+  };
+
+  char letter;       //!< 'A' to 'Z'
+  Type type;         //!< Value type
+  uint8_t decimals;  //!< Decimal places of kFixed
+  bool is_required;  //!< The command is rejected without it
+  bool has_default;  //!< def is used, when the parameter is missing
+  int32_t min;       //!< Lowest value or element, or shortest string
+  int32_t max;       //!< Highest value or element, or longest string
+  int32_t def;       //!< Default value, fixed point for kFixed
+
+  /**
+   * @brief A parameter, which is used without value, e.g. R in "A5 R"
+   *
+   */
+  static constexpr ParamSpec flag(char letter) {
+    return { letter, Type::kFlag, 0, false, false, 0, 0, 0 };
+  }
+
+  /**
+   * @brief An integer parameter from \p min to \p max
+   *
+   */
+  static constexpr ParamSpec integer(char letter, int32_t min, int32_t max) {
+    return { letter, Type::kInteger, 0, false, false, min, max, 0 };
+  }
+
+  /**
+   * @brief A decimal parameter, read with Parser::get_fixed(), or as float
+   *
+   * @param decimals decimal places of \p min and \p max, e.g. 2 for 0.01 steps
+   */
+  static constexpr ParamSpec fixed(char letter, uint8_t decimals, int32_t min, int32_t max) {
+    return { letter, Type::kFixed, decimals, false, false, min, max, 0 };
+  }
+
+  /**
+   * @brief A quoted string parameter, \p min_len to \p max_len characters
+   *
+   */
+  static constexpr ParamSpec string(char letter, int32_t min_len, int32_t max_len) {
+    return { letter, Type::kString, 0, false, false, min_len, max_len, 0 };
+  }
+
+  /**
+   * @brief An array parameter, e.g. D1,2,3 or D$0102ff, every element from \p min to \p max
+   *
+   */
+  static constexpr ParamSpec array(char letter, int32_t min, int32_t max) {
+    return { letter, Type::kArray, 0, false, false, min, max, 0 };
+  }
+
+  /**
+   * @brief The same parameter, but the command is rejected without it
+   *
+   */
+  constexpr ParamSpec required() const {
+    ParamSpec spec = *this;
+    spec.is_required = true;
+    return spec;
+  }
+
+  /**
+   * @brief The same parameter, which reads as \p value, when it is missing
+   *
+   */
+  constexpr ParamSpec or_default(int32_t value) const {
+    ParamSpec spec = *this;
+    spec.has_default = true;
+    spec.def = value;
+    return spec;
+  }
+};
+
+/**
+ * @brief All parameters of a command, with the letter masks precomputed
+ *
+ */
+struct ParamSchema {
+  const ParamSpec* params;  //!< Declared parameters
+  uint8_t count;            //!< Number of params
+  uint32_t allowed;         //!< Bit n is set, if 'A' + n is declared
+  uint32_t required;        //!< Bit n is set, if 'A' + n is required
+  uint32_t defaults;        //!< Bit n is set, if 'A' + n has a default
+  bool valid;               //!< Letters are unique, between 'A' and 'Z', ranges are not empty, max 9 decimals
+};
+
+/**
+ * @brief Makes the schema of \p params, check its valid flag in a static_assert
+ *
+ */
+template <size_t N>
+constexpr ParamSchema make_schema(const ParamSpec (&params)[N]) {
+  static_assert(N < UINT8_MAX, "Too many parameters");
+  ParamSchema schema{ params, static_cast<uint8_t>(N), 0, 0, 0, true };
+  for (const auto& spec : params) {
+    if (spec.letter < 'A' || spec.letter > 'Z' || spec.min > spec.max || spec.decimals > 9) {
+      schema.valid = false;
+      continue;
+    }
+    const uint32_t bit = uint32_t(1) << (spec.letter - 'A');
+    if (schema.allowed & bit) schema.valid = false;
+    schema.allowed |= bit;
+    if (spec.is_required) schema.required |= bit;
+    if (spec.has_default) schema.defaults |= bit;
+  }
+  return schema;
+}
+
+/**
+ * @brief Holds the schema of \p Params, and checks it
+ *
+ */
+template <const auto& Params>
+struct SchemaOf {
+  static constexpr ParamSchema value = make_schema(Params);  //!< The schema
+  static_assert(value.valid, "Duplicate parameter, letter out of range, empty range, or too many decimals");
+};
+
+/**
+ * @brief Checked schema of \p Params, in flash, e.g. &kSchema<kA2Params> in a Command
+ *
+ */
+template <const auto& Params>
+constexpr const ParamSchema& kSchema = SchemaOf<Params>::value;
+
+/**
+ * @brief Schema of a command without parameters
+ *
+ */
+constexpr ParamSchema kNoParams{ nullptr, 0, 0, 0, 0, true };
+
+/**
+ * @brief Why Parser::validate() rejected a command
+ *
+ */
+struct ParamError {
+  /**
+   * @brief What is wrong
+   *
+   */
+  enum class Kind : uint8_t {
+    kNone,     //!< Nothing
+    kUnknown,  //!< Parameter is not declared
+    kMissing,  //!< Required parameter is missing
+    kValue,    //!< Value is missing or has the wrong type, e.g. a fraction for an integer
+    kRange,    //!< Value, string length or an array element is out of range
+  };
+
+  Kind kind{ Kind::kNone };          //!< What is wrong
+  char letter{ 0 };                  //!< The parameter
+  const ParamSpec* spec{ nullptr };  //!< Its declaration, nullptr for kUnknown
+};
+
+#endif  // PARAM_SCHEMA_H_
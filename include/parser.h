@@ -7,21 +7,154 @@
 #define PARSER_H_
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 
-#include "main.h"
+#include "param_schema.h"
+
+/**
+ * @brief Array value of a parameter, a view into the command, elements are decoded when they are read
+ *
+ * Decimal arrays are integers separated by ',', e.g. D1,-2,3, or D5, with one element. Hex arrays are bytes, 2 digits
+ * each, after '$', e.g. D$0aFF10. Binary commands carry raw bytes. Nothing is copied, the view is valid as long as
+ * the command is, i.e. during the call of the gcode.
+ */
+class ParamArray {
+public:
+  /**
+   * @brief Encoding of the elements
+   *
+   */
+  enum class Format : uint8_t {
+    kDecimal,  //!< Integers separated by ','
+    kHex,      //!< 2 hex digits per byte
+    kBytes,    //!< Raw bytes
+  };
+
+  ParamArray() = default;
+
+  /**
+   * @brief View of \p count elements from \p data, checked by the parser
+   *
+   */
+  ParamArray(Format format, const char* data, uint8_t count) : data_(data), count_(count), format_(format) {
+  }
+
+  /**
+   * @brief Number of elements
+   *
+   */
+  size_t size() const {
+    return count_;
+  }
+
+  /**
+   * @brief Encoding of the elements, every element of kHex and kBytes is 0 to 255
+   *
+   */
+  Format get_format() const {
+    return format_;
+  }
+
+  /**
+   * @brief Calls \p fn with every element as int32_t, in order
+   *
+   */
+  template <class F>
+  void for_each(F&& fn) const {
+    const char* ptr = data_;
+    for (size_t i = 0; i < count_; ++i) fn(read(ptr));
+  }
+
+  /**
+   * @brief Element \p i, decimal arrays are scanned from the start
+   *
+   */
+  int32_t operator[](size_t i) const {
+    if (format_ == Format::kBytes) return static_cast<uint8_t>(data_[i]);
+    if (format_ == Format::kHex) return (nibble(data_[2 * i]) << 4) | nibble(data_[2 * i + 1]);
+    const char* ptr = data_;
+    for (; i; --i) read(ptr);
+    return read(ptr);
+  }
+
+  /**
+   * @brief Value of hex digit \p c, 0 if it isn't one
+   *
+   */
+  static constexpr uint8_t nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return 0;
+  }
+
+private:
+  /**
+   * @brief Reads the element at \p ptr, and moves it to the next one
+   *
+   */
+  int32_t read(const char*& ptr) const {
+    if (format_ == Format::kBytes) return static_cast<uint8_t>(*ptr++);
+    if (format_ == Format::kHex) {
+      const int32_t val = (nibble(ptr[0]) << 4) | nibble(ptr[1]);
+      ptr += 2;
+      return val;
+    }
+    // the parser checked, that the elements are integers, which fit
+    const bool negative = *ptr == '-';
+    if (negative || *ptr == '+') ++ptr;
+    uint32_t mag{ 0 };
+    for (; *ptr >= '0' && *ptr <= '9'; ++ptr) mag = mag * 10 + (*ptr - '0');
+    if (*ptr == ',') ++ptr;
+    return static_cast<int32_t>(negative ? 0u - mag : mag);
+  }
+
+  const char* data_{ nullptr };        //!< First element
+  uint8_t count_{ 0 };                 //!< Number of elements
+  Format format_{ Format::kDecimal };  //!< Encoding
+};
 
 /**
  * @brief Class to parse commands into arguments
  *
+ * The command is parsed once, when it is set: the prefix, the number, and a table of the parameters. A parameter is
+ * a letter from A to Z, with an optional value. Its presence is a bit in a 26 bit mask, so a lookup is constant time.
+ * If a letter is repeated, the first one is used.
+ *
+ * A value is a decimal number, e.g. S-12 or X1.25, or a quoted string, e.g. T"Hello world". Numbers are stored as
+ * mantissa and decimal exponent, and converted when they are read: to int16_t or int32_t truncated, to fixed point
+ * rounded, or to float. Out of range values saturate. The conversion doesn't use strtod() or the locale. The mantissa
+ * holds any int32_t, further digits are ignored. Floats are correctly rounded up to 7 significant digits, and within
+ * 1 ulp beyond. Strings can't contain '"', a string without closing quote runs to the end of the line, a ';' in a
+ * string doesn't end the command. Up to kMaxArrays parameters of a command can be arrays, see ParamArray, they point
+ * into the command.
  */
 class Parser {
 public:
+  static constexpr size_t kMaxStringLen = 32;  //!< Space for all string values of a command, with terminators
+  static constexpr size_t kMaxArrays = 2;      //!< Array parameters of a command, further ones have no value
+
   /**
    * @brief Set the message to be parsed
-   *
-   * @param arr null-terminated string
+   * @details A line can hold several commands separated by ';', e.g. "A1;A0". Only the first one is parsed, the
+   * return value points to the next one.
+   * @param arr null-terminated string, only array values point into it after the call
+   * @return const char* the command after ';', nullptr if this was the last one
+   */
+  const char* set_string(const char* arr);
+
+  /**
+   * @brief Set a binary command to be parsed
+   * @details Layout: prefix, number as varint, then the parameters. A parameter is its letter and its value as zigzag
+   * varint of 32 bits, or only the letter with kNoValue set, when it has no value, or the letter with kBytes set, the
+   * length as varint and raw bytes, when it is a byte array. Varint is 7 bits per byte, least significant first, the
+   * highest bit is set if more bytes follow.
+   * @param data the command, without framing and CRC, only array values point into it after the call
+   * @param len length of the command
+   * @return true if the layout is valid
    */
-  void set_string(const char* arr);
+  bool set_binary(const uint8_t* data, size_t len);
 
   /**
    * @brief reset parser
@@ -33,47 +166,205 @@ public:
    *
    * @return char the prefix
    */
-  char get_prefix() const;
+  char get_prefix() const {
+    return prefix_;
+  }
   /**
    * @brief Get the command number
    *
    * @return uint16_t
    */
-  uint16_t get_number() const;
+  uint16_t get_number() const {
+    return number_;
+  }
   /**
    * @brief Get the value of a parameter or default
-   * @details Retruns true if the parameter is found, even without value
+   * @details Retruns true if the parameter is found, even without value. The fraction is truncated.
    * @param param Parameter to search
    * @param dest where to copy the value
-   * @param def default value
+   * @param def default value, used when the parameter is missing, or it has no numeric value
    * @return true if parameter was found
    */
-  bool get_parameter(char param, int16_t& dest, int16_t def = 0) const;
+  bool get_parameter(char param, int16_t& dest, int16_t def = 0) const {
+    int32_t val{ 0 };
+    const bool found = get_parameter(param, val, def);
+    dest = val < INT16_MIN ? INT16_MIN : (val > INT16_MAX ? INT16_MAX : val);
+    return found;
+  }
+
+  /**
+   * @brief Get the value of a parameter or default, as 32 bit integer
+   * @details Same as the int16_t version
+   */
+  bool get_parameter(char param, int32_t& dest, int32_t def = 0) const {
+    const uint32_t bit = letter_bit(param);
+    if (has_value_ & bit) {
+      // integers are the common case, they need no conversion
+      const size_t i = param - 'A';
+      dest = exponents_[i] == 0 ? mantissas_[i] : to_int({ mantissas_[i], exponents_[i] }, 0, false);
+    } else {
+      dest = def;
+    }
+    return present_ & bit;
+  }
+
+  /**
+   * @brief Get the value of a parameter or default, as float
+   * @details Same as the int16_t version
+   */
+  bool get_parameter(char param, float& dest, float def = 0) const;
+
+  /**
+   * @brief Get the value of a parameter or default, as fixed point number
+   * @details Same as the int16_t version. E.g. X1.2345 with \p decimals 3 is 1235.
+   * @param decimals number of decimal places of \p dest, the value is rounded to them
+   */
+  bool get_fixed(char param, int32_t& dest, uint8_t decimals, int32_t def = 0) const;
+
+  /**
+   * @brief Get the string value of a parameter or default
+   * @details Same as the int16_t version
+   * @param dest set to the null-terminated value, valid until the next command is set
+   */
+  bool get_string(char param, const char*& dest, const char* def = "") const;
+
+  /**
+   * @brief Get the array value of a parameter
+   * @details Same as the int16_t version, \p dest is empty when it is missing or it isn't an array
+   * @param dest set to the view of the elements, valid as long as the command
+   */
+  bool get_array(char param, ParamArray& dest) const;
+
+  /**
+   * @brief Checks the parameters against the schema of the command, and sets the defaults of missing ones
+   * @details Works on the parsed values, the line is not scanned again. Unknown parameters and missing required ones
+   * are found with the masks of the schema, then the values of the present parameters are range checked. A missing
+   * parameter with a default reads as the default, but the getters still return false for it.
+   * @param schema parameters of the command
+   * @param error set to the first problem found
+   * @return true if the command is valid
+   */
+  bool validate(const ParamSchema& schema, ParamError& error);
 
   /**
    * @brief Retruns true if the parser has a string it can work with
    *
    * @return true if parser string is set
    */
-  bool has_string() const;
+  bool has_string() const {
+    return prefix_ != 0;
+  }
 
 private:
   /**
-   * @brief Index of first non-whitespace char
+   * @brief A number as mantissa * 10 ^ exponent
+   *
+   */
+  struct number_t {
+    int32_t mantissa;
+    int8_t exponent;
+  };
+
+  /**
+   * @brief Bit of \p param in the masks, 0 if it is not a letter from A to Z
+   *
+   */
+  static constexpr uint32_t letter_bit(char param) {
+    return (param >= 'A' && param <= 'Z') ? uint32_t(1) << (param - 'A') : 0;
+  }
+
+  /**
+   * @brief Marks a parameter present, if it is not present yet
+   *
+   * @return true if the value of the parameter shall be stored
+   */
+  bool add_parameter(char param);
+
+  /**
+   * @brief Numeric value of \p param
    *
-   * @return size_t
+   * @return true if it is present with a numeric value
    */
-  size_t get_first_not_whitespace() const;
+  bool find_number(char param, number_t& num) const;
+
   /**
-   * @brief Work string
+   * @brief Reads a decimal number, optional sign, digits, optional fraction
    *
+   * @param str moved after the number, unchanged if there is no number
+   * @param num the number
+   * @return true if a number was read
    */
-  const char* str_{ nullptr };
+  static bool read_number(const char*& str, number_t& num);
+
   /**
-   * @brief size of work string
+   * @brief Slow path of read_number(): integers with 10 digits or more, and fractions
    *
+   * @param ptr at the next digit or the decimal point
+   * @param mag magnitude read so far
+   * @param digits true if digits were read already
+   * @param negative the number is negative, its magnitude can be one more
+   * @param num the number
+   * @return const char* pointer after the number, or nullptr if there are no digits
    */
-  uint16_t str_sz_{ 0 };
+  static const char* read_number_tail(const char* ptr, uint32_t mag, bool digits, bool negative, number_t& num);
+
+  /**
+   * @brief Reads a quoted string into strings_, a string, which doesn't fit, is truncated
+   *
+   * @param str at the opening quote, moved after the closing quote
+   * @return uint8_t offset of the string in strings_
+   */
+  uint8_t read_string(const char*& str);
+
+  /**
+   * @brief Reads an array of integers separated by ',', or of hex bytes after '$', into arrays_
+   *
+   * @param str at the first element or '$', moved after the array
+   * @param param the parameter, its value is stored if \p store is true, there is space left, and the array is valid
+   */
+  void read_array(const char*& str, char param, bool store);
+
+  /**
+   * @brief Stores \p value of \p param in arrays_, if there is space left
+   *
+   */
+  void add_array(char param, const ParamArray& value);
+
+  /**
+   * @brief Converts to integer, truncates and saturates
+   *
+   * @param shift added to the exponent, to scale the number
+   * @param round round to nearest instead of truncating
+   */
+  static int32_t to_int(const number_t& num, int shift, bool round);
+
+  /**
+   * @brief Reads a varint from \p ptr
+   *
+   * @param end end of the data
+   * @param val the value
+   * @return const uint8_t* pointer after the varint, or nullptr if it is longer than 5 bytes or truncated
+   */
+  static const uint8_t* read_varint(const uint8_t* ptr, const uint8_t* end, uint32_t& val);
+
+  char prefix_{ 0 };                              //!< Command prefix, 0 if no command is set
+  uint16_t number_{ 0 };                          //!< Command number
+  uint32_t present_{ 0 };                         //!< Bit n is set, if parameter 'A' + n is present
+  uint32_t has_value_{ 0 };                       //!< Bit n is set, if parameter 'A' + n has a numeric value
+  uint32_t has_string_{ 0 };                      //!< Bit n is set, if parameter 'A' + n has a string value
+  uint32_t has_array_{ 0 };                       //!< Bit n is set, if parameter 'A' + n has an array value
+  std::array<int32_t, 26> mantissas_{};           //!< Mantissas of numeric values, valid where has_value_ is set
+  std::array<int8_t, 26> exponents_{};            //!< Exponents of numeric values
+  std::array<uint8_t, 26> string_offsets_{};      //!< Offsets in strings_, valid where has_string_ is set
+  std::array<char, kMaxStringLen> strings_{};     //!< String values, null-terminated
+  uint8_t strings_len_{ 0 };                      //!< Used part of strings_
+  std::array<ParamArray, kMaxArrays> arrays_{};   //!< Array values, in the order of the command
+  std::array<char, kMaxArrays> array_letters_{};  //!< Parameters of arrays_
+  uint8_t arrays_len_{ 0 };                       //!< Used part of arrays_
+
+public:
+  static constexpr uint8_t kNoValue = 0x80;  //!< Set on a binary parameter letter, when it has no value
+  static constexpr uint8_t kBytes = 0x20;    //!< Set on a binary parameter letter, when its value is a byte array
 };
 
 #endif
@@ -6,23 +6,91 @@
  */
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
+/**
+ * @brief Counter arithmetic of the ring buffers, positions are counters, which only move forward
+ *
+ * When L is a power of 2, the counters run freely, and the slot is the counter masked by L - 1. Otherwise they wrap
+ * at 2 * L with a compare, the slot is the counter minus L, if it is L or more. Neither needs a division.
+ * @tparam L The size of the buffer
+ */
+template <size_t L>
+struct RingIndex {
+  static_assert(L > 0 && L <= SIZE_MAX / 2, "Counters wrap at 2 * L");
+
+  static constexpr bool kIsPow2 = (L & (L - 1)) == 0;  //!< Counters are masked, otherwise wrapped at 2 * L
+
+  /**
+   * @brief Counter \p count slots after \p pos
+   *
+   * @param count at most L
+   */
+  static constexpr size_t advance(size_t pos, size_t count) {
+    if constexpr (kIsPow2) {
+      return pos + count;
+    } else {
+      return pos + count >= 2 * L ? pos + count - 2 * L : pos + count;
+    }
+  }
+
+  /**
+   * @brief Counter after \p pos
+   *
+   */
+  static constexpr size_t next(size_t pos) {
+    return advance(pos, 1);
+  }
+
+  /**
+   * @brief Slot of counter \p pos
+   *
+   */
+  static constexpr size_t slot(size_t pos) {
+    if constexpr (kIsPow2) {
+      return pos & (L - 1);
+    } else {
+      return pos < L ? pos : pos - L;
+    }
+  }
+
+  /**
+   * @brief Number of slots from counter \p from to counter \p to
+   *
+   */
+  static constexpr size_t distance(size_t from, size_t to) {
+    if constexpr (kIsPow2) {
+      return to - from;
+    } else {
+      return to >= from ? to - from : to + 2 * L - from;
+    }
+  }
+};
+
 /**
  * @brief Very simple inline ring buffer, not fool-proof.
  *
  * Will not accept incoming data when full
+ * Positions are counters, which only move forward, so full and empty are told apart without a flag: used slots are
+ * the distance from tail_ to virtual_head_, see RingIndex.
+ * The span functions give the largest contiguous free or occupied region, so a DMA or memcpy can move many elements
+ * at once, followed by one commit() or consume().
  * IMPORTANT: push() shall not be called, when get_next_free returned nullptr
  * IMPORTANT: non-const functions shall be called from within critical sections
+ * For one producer and one consumer, SpscRingBuffer needs no critical sections
  * @tparam T type which the buffer holds
  * @tparam L The size of the buffer
  */
-template <class T, uint8_t L>
+template <class T, size_t L>
 class RingBuffer {
   // types
 public:
-  static constexpr uint8_t buffer_size_ = L;
+  static constexpr size_t buffer_size_ = L;
   using data_t = T;
+
+  static_assert(L > 0 && L <= SIZE_MAX / 2, "Counters wrap at 2 * L");
+
   // interface
 public:
   /**
@@ -61,6 +129,34 @@ public:
    * @return const data_t*
    */
   const data_t* get_next_occupied() const;
+
+  // contiguous regions
+  /**
+   * @brief Get the largest contiguous free region, it is not reserved
+   * @details Not mixed with get_next_free(): while reserved slots aren't pushed, there is no free region
+   * @param count set to the number of free elements from the returned pointer
+   * @return T* pointer to the region, or nullptr if there is none
+   */
+  data_t* get_free_span(size_t& count);
+  /**
+   * @brief Marks \p count elements of the free region as occupied
+   *
+   * @param count at most the count given by get_free_span()
+   */
+  void commit(size_t count);
+  /**
+   * @brief Get the largest contiguous occupied region
+   *
+   * @param count set to the number of occupied elements from the returned pointer
+   * @return T* pointer to the region, or nullptr if empty
+   */
+  data_t* get_occupied_span(size_t& count);
+  /**
+   * @brief Frees \p count elements from the tail
+   *
+   * @param count at most the count given by get_occupied_span()
+   */
+  void consume(size_t count);
   // states
   /**
    * @brief Check if buffer is empty
@@ -77,12 +173,14 @@ public:
   /**
    * @brief Get number of data in buffer
    *
-   * @return uint8_t number of data
+   * @return size_t number of pushed data
    */
-  uint8_t num_occupied() const;
+  size_t num_occupied() const;
 
   // implementation
 private:
+  using Index = RingIndex<L>;  //!< Counter arithmetic
+
   /**
    * @brief The buffer
    *
@@ -94,7 +192,7 @@ private:
    * This variable marks, where usable data is in the space it points to
    * This is the real head, which is moved on every push()
    */
-  volatile uint8_t head_{ 0 };
+  volatile size_t head_{ 0 };
 
   /**
    * @brief This head is used to get the next free space
@@ -103,87 +201,101 @@ private:
    * This is done so multiple tasks can write to the buffer concurrently
    * Without this, get_next_free() would give the same space in the buffer to multiple tasks
    */
-  volatile uint8_t virtual_head_{ 0 };
+  volatile size_t virtual_head_{ 0 };
   /**
    * @brief next next occupied space
    *
    */
-  volatile uint8_t tail_{ 0 };
-  /**
-   * @brief To track the edge case
-   *
-   */
-  volatile bool is_full_{ false };
+  volatile size_t tail_{ 0 };
 };
 
 
 
-template <class T, uint8_t L>
+template <class T, size_t L>
 inline void RingBuffer<T, L>::reset() {
   head_ = tail_;
-  is_full_ = false;
+  virtual_head_ = tail_;
 }
 
-template <class T, uint8_t L>
+template <class T, size_t L>
 inline void RingBuffer<T, L>::push() {
-  head_ = (head_ + 1) % buffer_size_;
+  head_ = Index::next(head_);
 }
 
-template <class T, uint8_t L>
+template <class T, size_t L>
 inline void RingBuffer<T, L>::pop() {
   if (is_empty()) return;
-  tail_ = (tail_ + 1) % buffer_size_;
-  is_full_ = false;
+  tail_ = Index::next(tail_);
 }
 
-template <class T, uint8_t L>
+template <class T, size_t L>
 inline typename RingBuffer<T, L>::data_t* RingBuffer<T, L>::get_next_free() {
   if (is_full()) {
     return nullptr;
   }
   // Get pointer to space in buffer
-  const auto ret = &(buffer_[virtual_head_]);
-  // calculate the next virtual_head_
-  const uint8_t next_v_head = (virtual_head_ + 1) % buffer_size_;
-  // track if buffer is full
-  if (next_v_head == tail_) {
-    is_full_ = true;
-  }
-  virtual_head_ = next_v_head;
-  return ret;
+  const size_t pos = virtual_head_;
+  virtual_head_ = Index::next(pos);
+  return &(buffer_[Index::slot(pos)]);
 }
 
-template <class T, uint8_t L>
+template <class T, size_t L>
 inline typename RingBuffer<T, L>::data_t* RingBuffer<T, L>::get_next_occupied() {
   if (is_empty()) return nullptr;
-  return &(buffer_[tail_]);
+  return &(buffer_[Index::slot(tail_)]);
 }
 
-template <class T, uint8_t L>
+template <class T, size_t L>
 inline const typename RingBuffer<T, L>::data_t* RingBuffer<T, L>::get_next_occupied() const {
   if (is_empty()) return nullptr;
-  return &(buffer_[tail_]);
+  return &(buffer_[Index::slot(tail_)]);
+}
+
+template <class T, size_t L>
+inline typename RingBuffer<T, L>::data_t* RingBuffer<T, L>::get_free_span(size_t& count) {
+  const size_t pos = head_;
+  count = 0;
+  if (pos != virtual_head_) return nullptr;
+  const size_t free = buffer_size_ - Index::distance(tail_, pos);
+  const size_t to_end = buffer_size_ - Index::slot(pos);
+  count = free < to_end ? free : to_end;
+  return count ? &(buffer_[Index::slot(pos)]) : nullptr;
+}
+
+template <class T, size_t L>
+inline void RingBuffer<T, L>::commit(size_t count) {
+  const size_t pos = Index::advance(head_, count);
+  virtual_head_ = pos;
+  head_ = pos;
+}
+
+template <class T, size_t L>
+inline typename RingBuffer<T, L>::data_t* RingBuffer<T, L>::get_occupied_span(size_t& count) {
+  const size_t pos = tail_;
+  const size_t used = Index::distance(pos, head_);
+  const size_t to_end = buffer_size_ - Index::slot(pos);
+  count = used < to_end ? used : to_end;
+  return count ? &(buffer_[Index::slot(pos)]) : nullptr;
 }
 
-template <class T, uint8_t L>
+template <class T, size_t L>
+inline void RingBuffer<T, L>::consume(size_t count) {
+  tail_ = Index::advance(tail_, count);
+}
+
+template <class T, size_t L>
 inline bool RingBuffer<T, L>::is_empty() const {
-  return (!is_full_ && (head_ == tail_));
+  return head_ == tail_;
 }
 
-template <class T, uint8_t L>
+template <class T, size_t L>
 inline bool RingBuffer<T, L>::is_full() const {
-  return is_full_;
+  return Index::distance(tail_, virtual_head_) == buffer_size_;
 }
 
-template <class T, uint8_t L>
-inline uint8_t RingBuffer<T, L>::num_occupied() const {
-  if (is_full()) {
-    return buffer_size_;
-  } else if (head_ >= tail_) {
-    return head_ - tail_;
-  } else {
-    return buffer_size_ + head_ - tail_;
-  }
+template <class T, size_t L>
+inline size_t RingBuffer<T, L>::num_occupied() const {
+  return Index::distance(tail_, head_);
 }
 
 #endif  // MESSAGE_BUFFER_H_
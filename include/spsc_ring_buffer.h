@@ -0,0 +1,185 @@
+#ifndef SPSC_RING_BUFFER_H_
+#define SPSC_RING_BUFFER_H_
+
+/** @file spsc_ring_buffer.h
+ * templated inline lock-free single producer, single consumer ring buffer
+ */
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ring_buffer.h"
+
+/**
+ * @brief Ring buffer for one producer and one consumer, e.g. an ISR and a task, without critical sections
+ *
+ * Same interface as RingBuffer. The producer owns head_, the consumer owns tail_, each only reads the other's
+ * counter. The producer writes the slot, then stores head_ with release semantics. The consumer loads head_ with
+ * acquire semantics, so it sees the slot written. The same holds for tail_ in the other direction, so the producer
+ * doesn't write a slot before the consumer is done with it. On Cortex-M4 a store-release and a load-acquire are a
+ * plain access and a DMB, no interrupt is masked.
+ *
+ * There is one producer, so get_next_free() doesn't reserve: it returns the same slot until push().
+ * IMPORTANT: get_next_free(), push(), get_free_span() and commit() shall be called by the producer only
+ * IMPORTANT: get_next_occupied(), pop(), get_occupied_span() and consume() shall be called by the consumer only
+ * @tparam T type which the buffer holds
+ * @tparam L The size of the buffer
+ */
+template <class T, size_t L>
+class SpscRingBuffer {
+  // types
+public:
+  static constexpr size_t buffer_size_ = L;
+  using data_t = T;
+
+  static_assert(std::atomic<size_t>::is_always_lock_free, "Counters shall be lock-free");
+
+  // interface
+public:
+  /**
+   * @brief Drops all data, IMPORTANT: not thread safe
+   *
+   */
+  void reset() {
+    head_.store(tail_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+
+  // producer
+  /**
+   * @brief Get the Next Free object, producer only
+   *
+   * @return T* Pointer to the next free, or nullptr if full
+   */
+  data_t* get_next_free() {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (Index::distance(tail_.load(std::memory_order_acquire), head) == buffer_size_) return nullptr;
+    return &(buffer_[Index::slot(head)]);
+  }
+
+  /**
+   * @brief Publishes the slot returned by get_next_free(), producer only
+   *
+   */
+  void push() {
+    commit(1);
+  }
+
+  /**
+   * @brief Get the largest contiguous free region, producer only
+   *
+   * @param count set to the number of free elements from the returned pointer
+   * @return T* pointer to the region, or nullptr if full
+   */
+  data_t* get_free_span(size_t& count) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t free = buffer_size_ - Index::distance(tail_.load(std::memory_order_acquire), head);
+    const size_t to_end = buffer_size_ - Index::slot(head);
+    count = free < to_end ? free : to_end;
+    return count ? &(buffer_[Index::slot(head)]) : nullptr;
+  }
+
+  /**
+   * @brief Publishes \p count elements of the free region, producer only
+   *
+   */
+  void commit(size_t count) {
+    head_.store(Index::advance(head_.load(std::memory_order_relaxed), count), std::memory_order_release);
+  }
+
+  // consumer
+  /**
+   * @brief Get the Next Occupied object, consumer only
+   *
+   * @return T* pointer to the next data, or nullptr if empty
+   */
+  data_t* get_next_occupied() {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) return nullptr;
+    return &(buffer_[Index::slot(tail)]);
+  }
+
+  /**
+   * @brief Pointer to constant next occupied object, consumer only
+   * @see get_next_occupied()
+   * @return const data_t*
+   */
+  const data_t* get_next_occupied() const {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) return nullptr;
+    return &(buffer_[Index::slot(tail)]);
+  }
+
+  /**
+   * @brief Frees the next occupied object, consumer only
+   *
+   */
+  void pop() {
+    if (is_empty()) return;
+    consume(1);
+  }
+
+  /**
+   * @brief Get the largest contiguous occupied region, consumer only
+   *
+   * @param count set to the number of occupied elements from the returned pointer
+   * @return T* pointer to the region, or nullptr if empty
+   */
+  data_t* get_occupied_span(size_t& count) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t used = Index::distance(tail, head_.load(std::memory_order_acquire));
+    const size_t to_end = buffer_size_ - Index::slot(tail);
+    count = used < to_end ? used : to_end;
+    return count ? &(buffer_[Index::slot(tail)]) : nullptr;
+  }
+
+  /**
+   * @brief Frees \p count elements from the tail, consumer only
+   *
+   */
+  void consume(size_t count) {
+    tail_.store(Index::advance(tail_.load(std::memory_order_relaxed), count), std::memory_order_release);
+  }
+
+  // states, a snapshot if called by a third party
+  /**
+   * @brief Check if buffer is empty
+   *
+   * @return true if empty
+   */
+  bool is_empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Check if buffer is full
+   *
+   * @return true if full
+   */
+  bool is_full() const {
+    return num_occupied() == buffer_size_;
+  }
+
+  /**
+   * @brief Get number of data in buffer
+   *
+   * @return size_t number of pushed data
+   */
+  size_t num_occupied() const {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    const size_t used = Index::distance(tail, head_.load(std::memory_order_acquire));
+    // both counters may move between the loads
+    return used < buffer_size_ ? used : buffer_size_;
+  }
+
+  // implementation
+private:
+  using Index = RingIndex<L>;  //!< Counter arithmetic
+
+  std::array<data_t, buffer_size_> buffer_;  //!< The buffer
+  std::atomic<size_t> head_{ 0 };            //!< Counter of the next free slot, written by the producer
+  std::atomic<size_t> tail_{ 0 };            //!< Counter of the next occupied slot, written by the consumer
+};
+
+#endif  // SPSC_RING_BUFFER_H_
@@ -0,0 +1,199 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/** @file trace.h
+ * Kernel event trace, task switches, queue and semaphore operations and interrupts in a RAM ring
+ */
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Event trace recorder, fed by the FreeRTOS trace macros and the interrupt handlers
+ *
+ * Records are timestamped with the DWT cycle counter. The ring overwrites the oldest record, so it always holds the
+ * last events. A16 dumps it, tools/trace2chrome.cpp converts the dump to Chrome trace JSON.
+ */
+namespace trace {
+
+  /**
+   * @brief Kind of a record, the values are part of the dump format
+   *
+   */
+  enum class Event : uint8_t {
+    kSwitchIn,   //!< Task id is switched in
+    kSwitchOut,  //!< Task id is switched out
+    kGive,       //!< Queue id is given or sent to, arg is the count before
+    kTake,       //!< Queue id is taken or received from, arg is the count before
+    kBlock,      //!< The running task blocks on taking queue id, arg is the count
+    kIsrEnter,   //!< Interrupt id is entered
+    kIsrExit,    //!< Interrupt id returns
+  };
+
+  /**
+   * @brief Traced queues and semaphores, set as their queue number, the ones with number 0 aren't traced
+   *
+   */
+  enum class Queue : uint8_t {
+    kNone,         //!< Not traced
+    kRxSemaphore,  //!< Uart::rx_semaphore_, given by the RX ISRs
+    kI2cMutex,     //!< I2C bus mutex
+    kWorkerQueue,  //!< Job queue of the I2C CommandWorker
+    kCount,        //!< Number of values
+  };
+
+  /**
+   * @brief Traced interrupt handlers
+   *
+   */
+  enum class Irq : uint8_t {
+    kDmaRx,   //!< DMA1 channel 6, UART RX
+    kDmaTx,   //!< DMA1 channel 7, UART TX
+    kUsart2,  //!< USART2, receiver timeout
+    kCount,   //!< Number of values
+  };
+
+  /**
+   * @brief One event, 8 bytes, sent little endian as it is in the dump
+   *
+   */
+  struct Record {
+    uint32_t time;  //!< DWT cycle counter
+    uint8_t event;  //!< Event
+    uint8_t id;     //!< TCB number, Queue or Irq
+    uint16_t arg;   //!< Depends on the event
+  };
+  static_assert(sizeof(Record) == 8, "Records are packed in the dump");
+
+  /**
+   * @brief Ring of the last \p N records
+   *
+   * A writer claims a slot with an atomic increment, so nested writers get different slots. On the target every
+   * writer runs masked to the kernel interrupt priority, so records are complete, when a task reads them.
+   * @tparam N number of records, a power of 2, so the counter wraps around with the slots
+   */
+  template <size_t N>
+  class Recorder {
+  public:
+    static_assert(N && (N & (N - 1)) == 0, "N shall be a power of 2");
+
+    /**
+     * @brief Adds a record, overwrites the oldest one when full, ignored when stopped
+     *
+     */
+    void add(uint32_t time, Event event, uint8_t id, uint16_t arg = 0) {
+      if (!enabled_.load(std::memory_order_relaxed)) return;
+      const uint32_t n = next_.fetch_add(1, std::memory_order_relaxed);
+      records_[n & (N - 1)] = { time, static_cast<uint8_t>(event), id, arg };
+    }
+
+    /**
+     * @brief Number of records kept
+     *
+     */
+    size_t size() const {
+      const uint32_t n = next_.load(std::memory_order_relaxed);
+      return n < N ? n : N;
+    }
+
+    /**
+     * @brief Records added since clear(), including the overwritten ones
+     *
+     */
+    uint32_t total() const {
+      return next_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The record \p i, 0 is the oldest one kept
+     *
+     */
+    const Record& operator[](size_t i) const {
+      const uint32_t n = next_.load(std::memory_order_relaxed);
+      const uint32_t first = n < N ? 0 : n;
+      return records_[(first + i) & (N - 1)];
+    }
+
+    /**
+     * @brief Drops all records, IMPORTANT: call it stopped
+     *
+     */
+    void clear() {
+      next_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records are added from now
+     *
+     */
+    void start() {
+      enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records are ignored from now, the kept ones can be read
+     *
+     */
+    void stop() {
+      enabled_.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Check if records are added
+     *
+     */
+    bool is_running() const {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<Record, N> records_{};    //!< The ring
+    std::atomic<uint32_t> next_{ 0 };    //!< Counter of the next record
+    std::atomic<bool> enabled_{ true };  //!< Records are added
+  };
+
+  constexpr size_t kRecords = 128;  //!< Records of the target, 1 KB
+
+  /**
+   * @brief Sets the queue number of \p handle, so its operations are traced as \p queue
+   *
+   * @param handle a QueueHandle_t or SemaphoreHandle_t
+   */
+  void name_queue(void* handle, Queue queue);
+
+  /**
+   * @brief Call first in the handler of \p irq
+   *
+   */
+  void isr_enter(Irq irq);
+
+  /**
+   * @brief Call last in the handler of \p irq
+   *
+   */
+  void isr_exit(Irq irq);
+
+  /**
+   * @brief Stops recording, so the records can be dumped
+   *
+   */
+  void stop();
+
+  /**
+   * @brief Drops the records, and starts recording
+   *
+   */
+  void restart();
+
+  /**
+   * @brief Sends the records and the names of the tasks, queues and interrupts, the recorder shall be stopped
+   *
+   * @return size_t number of records sent
+   */
+  size_t dump();
+
+}  // namespace trace
+
+#endif  // TRACE_H_
@@ -7,30 +7,92 @@
 
 #include "main.h"
 #include <cstring>
-#include "ring_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "packed_ring_buffer.h"
+#include "line_framer.h"
+#include "line_checker.h"
+#include "cobs.h"
+#include "latency.h"
 #include <array>
 #include "FreeRTOS.h"
 #include "cmsis_os.h"
 #include "semphr.h"
+#include "task.h"
 #include "utils.h"
 #include "string.h"
 #include <type_traits>
 #include <cstdarg>
+#include <atomic>
+#include <string_view>
 
 /**
  * @brief Encapsulates UART2
- * Messages are put into a ring buffer, and transmitted one after another
+ * Messages are packed into a byte ring buffer, and transmitted one after another using DMA
+ * When a DMA transfer completes, the ISR starts the next queued line
+ * If the buffer is full, the TX policy decides whether to wait for the DMA or to drop a line
  * Transmission is also possible directly, without the use of the Ring buffer
- * Direct transmission can also be done using DMA
  *
  */
 class Uart {
 public:
-  static constexpr size_t kTxBufferSize = 5,  //!< The size of the transmission ring buffer
-      kRxBufferSize = 5,                      //!< The size of the Rx Ring buffer
-      kMsgLen = 30,                           //!< Max lenth of a message to transmit
-      kDmaRxBuffSize = 30;                    //!< RX DMA buffer size
-  using msg_t = std::array<char, kMsgLen>;    //!< message type alias
+  /**
+   * @brief What to do, when a line doesn't fit into the TX buffer
+   *
+   */
+  enum class TxPolicy : uint8_t {
+    kBlock,       //!< Task sleeps until a transfer completes or timeout, ISRs drop the new line
+    kDropNewest,  //!< The new line is dropped
+    kDropOldest,  //!< Queued lines are dropped, except the one being transmitted
+    kCount,
+  };
+
+  /**
+   * @brief Counters of a TX policy
+   *
+   */
+  struct TxStats {
+    std::atomic<uint32_t> dropped{ 0 };         //!< Lines lost
+    std::atomic<uint32_t> waits{ 0 };           //!< Times a task had to wait for space
+    std::atomic<uint32_t> wait_ticks{ 0 };      //!< Total time spent waiting
+    std::atomic<uint32_t> max_wait_ticks{ 0 };  //!< Longest wait
+  };
+
+  static constexpr size_t kTxBufferSize = 256,   //!< The size of the transmission ring buffer in bytes
+      kRxBufferSize = 5,                         //!< The size of the Rx Ring buffer
+      kMsgLen = 42,                              //!< Max lenth of a received message, with terminator
+      kMaxPrintfLen = 64,                        //!< Max length of a printf message
+      kDmaRxBuffSize = 256;                      //!< RX DMA buffer size
+  using msg_t = std::string_view;                //!< message type alias, null-terminated view into the RX queue
+  static constexpr size_t kMaxLogArgs = 8;       //!< Max number of arguments of a deferred log record
+  static constexpr uint8_t kLogMarker = 0x1E;    //!< First byte of a deferred log record
+  static constexpr uint8_t kTextMarker = 0x02;   //!< First byte of a text frame in binary mode
+  static constexpr uint8_t kTraceMarker = 0x1D;  //!< First byte of a binary trace record
+  static constexpr size_t kMaxRecordData = 96;   //!< Max payload of send_record()
+  static constexpr char kTxPrefix[] = "echo: ";                   //!< Put in front of every queued message
+  static constexpr size_t kTxPrefixLen = sizeof(kTxPrefix) - 1;  //!< Length of prefix without the terminator
+  static constexpr size_t kTxWaiters = 4;                        //!< Max number of tasks notified on TX complete
+  static constexpr uint32_t kRxTimeoutBits = 20;                 //!< Default RX timeout in bit times, 2 characters
+
+  /**
+   * @brief Cycle counter timestamps of a received line, see latency::now()
+   *
+   */
+  struct RxStamps {
+    uint32_t event;   //!< Start of the RX interrupt, which found the line
+    uint32_t queued;  //!< The line was queued in rx_buff_
+  };
+
+  /**
+   * @brief Real-time bytes, handled by the RX ISR before framing, in text mode, even inside a line
+   * @details They are answered within the RX timeout after the byte, whatever the number of queued lines. They can't
+   * be used in string parameters.
+   */
+  enum class Realtime : char {
+    kStatus = '?',  //!< Sends the status record
+    kHold = '!',    //!< gcode_task stops taking lines, after the one it runs
+    kResume = '~',  //!< gcode_task takes lines again
+    kReset = 0x18,  //!< Ctrl-X, drops the queued lines and the partial line, and resumes
+  };
 
   /**
    * @brief handle to uart
@@ -45,12 +107,6 @@ public:
    */
   Uart();
 
-  /**
-   * @brief Periodic task which should be called whenever possible
-   * Handles transmitting from buffer
-   */
-  void tick();
-
   /**
    * @brief puts the message pointed to by \p buff to the tx queue
    *
@@ -135,12 +191,28 @@ public:
 
   /**
    * @brief Get the next message from buffer
-   * @details return const reference to a message, or to an internal buffer, which is all 0
-   * @return const reference to message, or to an internal buffer
+   * @details The view is null-terminated, and valid until pop_rx()
+   * @return view of the message, or an empty string
    */
-  const msg_t& get_message() const {
+  msg_t get_message() const {
     if (!has_message()) return kEmptyMsg;
-    return *(rx_buff_.get_next_occupied());
+    return rx_buff_.get_next_occupied()->msg.view();
+  }
+
+  /**
+   * @brief Timestamps of the next message, only valid if has_message()
+   *
+   */
+  RxStamps get_message_stamps() const {
+    return rx_buff_.get_next_occupied()->stamps;
+  }
+
+  /**
+   * @brief Was the next message received before a reset? It is popped without being run
+   *
+   */
+  bool is_message_dropped() const {
+    return static_cast<int32_t>(rx_drop_until_ - rx_popped_) > 0;
   }
 
   /**
@@ -149,6 +221,39 @@ public:
    */
   void pop_rx() {
     rx_buff_.pop();
+    rx_popped_ = rx_popped_ + 1;
+  }
+
+  /**
+   * @brief Queues a line like send_queue(), and timestamps the end of its TX DMA transfer, in text mode
+   * @details One line is probed at a time, see get_tx_probe(). A probe is lost, if the TX policy drops lines. Call
+   * from one task only.
+   * @return true if the line is queued and probed, otherwise it is queued by send_queue(), if there is space
+   */
+  bool send_queue_probed(const char* buff, size_t num);
+
+  /**
+   * @brief Ends the probe, if the probed line was sent
+   *
+   * @param sent set to the cycle counter at the end of the transfer
+   * @return true if the probed line was sent since the last call
+   */
+  bool get_tx_probe(uint32_t& sent);
+
+  /**
+   * @brief Number of probes lost, because the TX policy dropped the probed line, since the last call
+   *
+   */
+  uint32_t take_lost_tx_probes() {
+    return tx_probes_lost_.exchange(0);
+  }
+
+  /**
+   * @brief Is gcode_task held by the real-time hold byte?
+   *
+   */
+  bool is_held() const {
+    return hold_;
   }
 
   /**
@@ -182,42 +287,9 @@ public:
     return transmit(reinterpret_cast<uint8_t*>(const_cast<char*>(data)), strlen(data));
   }
 
-  /**
-   * @brief Transmits data immediately using DMA
-   *
-   * @param data pointer to data
-   * @param len length of data
-   * @return true on success
-   * @see transmit(uint8_t* data, size_t len)
-   */
-  bool transmit_DMA(uint8_t* data, size_t len) {
-    return HAL_UART_Transmit_DMA(&huart_, data, len) == HAL_OK;
-  }
-  /**
-   * @brief transmit a char[] array immediately using DMA
-   *
-   * @tparam N lenght of array, deduced by the compiler
-   * @return true on success
-   * @see transmit(const char (&arr)[N])
-   */
-  template <size_t N>
-  bool transmit_DMA(const char (&arr)[N]) {
-    return transmit_DMA(reinterpret_cast<uint8_t*>(const_cast<char*>(arr)), N - 1);
-  }
-  /**
-   * @brief Transmits a null-terminated array immediately using DMA
-   *
-   * @param data pointer to null-terminated array
-   * @return true on success
-   * @see transmit(char* data)
-   */
-  bool transmit_DMA(const char* data) {
-    return transmit_DMA(reinterpret_cast<uint8_t*>(const_cast<char*>(data)), strlen(data));
-  }
-
   /**
    * @brief Print formatted data using queue
-   * @details Use in ISR, will not yield and wait if the buffer is full
+   * @details Use in ISR, will not wait if the buffer is full
    * @see send_queue
    * @param fmt printf-style format
    * @param ... data
@@ -233,7 +305,7 @@ public:
 
   /**
    * @brief Print formatted data using queue
-   * @details Will yield to OS if the buffer is full
+   * @details If the buffer is full, waits or drops according to the TX policy
    * @see send_queue
    * @param fmt printf-style format
    * @param ... data
@@ -248,40 +320,190 @@ public:
   }
 
   /**
-   * @brief Called on UART IDLE interrupt, starts countdown
+   * @brief Print using deferred logging if enabled, otherwise same as printf()
+   * @details In deferred mode only the format ID and the arguments are queued, the text is restored on the host by
+   * tools/log_decoder.cpp. Use through the LOG() and LOG_ISR() macros, which place \p fmt into the log_fmt section.
+   * @param from_isr when true, will not wait if buffer is full
+   * @param fmt printf-style format, placed in log_fmt section
+   * @param args integer, enum or floating point arguments
+   * @return true on success
+   */
+  template <class... Args>
+  bool log(bool from_isr, const char* fmt, Args... args) {
+    static_assert(sizeof...(Args) <= kMaxLogArgs, "Too many arguments for deferred log");
+    if (!deferred_log_ && !binary_) {
+      return from_isr ? printf_isr(fmt, args...) : printf(fmt, args...);
+    }
+    const uint32_t words[sizeof...(Args) + 1] = { to_log_word(args)..., 0 };
+    return log_deferred(from_isr, fmt, words, sizeof...(Args));
+  }
+
+  /**
+   * @brief Queues a binary record: \p marker, payload length, then the payload
+   * @details In text mode the record is sent raw between the lines, like a deferred log record, in binary mode in a
+   * frame
+   * @param marker first byte, identifies the record on the host
+   * @param data payload
+   * @param len length of the payload, at most kMaxRecordData
+   * @return true on success
+   */
+  bool send_record(uint8_t marker, const uint8_t* data, size_t len);
+
+  /**
+   * @brief Enable or disable deferred logging
+   *
+   */
+  void set_deferred_log(bool enable) {
+    deferred_log_ = enable;
+  }
+
+  /**
+   * @brief Is deferred logging enabled?
    *
    */
-  void on_idle_ISR() {
-    dma_state_.countdown = 2;
+  bool is_deferred_log() const {
+    return deferred_log_;
   }
 
   /**
-   * @brief Called from SYSTICK ISR, counts down, on zero calls callback
-   * @see HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
-   * @see dma_state_
+   * @brief Set what happens when the TX buffer is full
+   *
    */
-  void on_systick_ISR() {
-    if (dma_state_.countdown) {
-      --dma_state_.countdown;
-      if (dma_state_.countdown == 0) {
-        dma_state_.flag = true;
-        // we cant call XferCpltCallback, because of FreeRTOS, this ISR's priority is too high
-        HAL_NVIC_SetPendingIRQ(DMA1_Channel6_IRQn);
-      }
-    }
+  void set_tx_policy(TxPolicy policy) {
+    tx_policy_ = policy;
   }
 
   /**
-   * @brief used to call XferCpltCallback when flag is set
+   * @brief Get the TX policy
    *
-   * calling from HAL tick ISR doesn't work with freertos, it's priority is too high
    */
-  void on_DMA_ISR() {
-    if (dma_state_.flag) {
-      huart_.hdmarx->XferCpltCallback(huart_.hdmarx);
-    }
+  TxPolicy get_tx_policy() const {
+    return tx_policy_;
   }
 
+  /**
+   * @brief Set the max time a task waits for TX buffer space with TxPolicy::kBlock
+   *
+   * @param timeout in ms
+   */
+  void set_tx_timeout(uint32_t timeout) {
+    tx_timeout_ = timeout;
+  }
+
+  /**
+   * @brief Get the max time a task waits for TX buffer space, in ms
+   *
+   */
+  uint32_t get_tx_timeout() const {
+    return tx_timeout_;
+  }
+
+  /**
+   * @brief Get the counters of \p policy
+   *
+   */
+  const TxStats& get_tx_stats(TxPolicy policy) const {
+    return tx_stats_[static_cast<size_t>(policy)];
+  }
+
+  /**
+   * @brief Zeroes the counters of all policies
+   *
+   */
+  void reset_tx_stats();
+
+  /**
+   * @brief Switch between text and binary mode
+   * @details In binary mode, received frames are delimited by 0, log() always queues deferred records, and everything
+   * is sent in COBS frames with CRC: deferred log records, and text lines after kTextMarker
+   */
+  void set_binary(bool enable) {
+    binary_ = enable;
+    rx_framer_.set_binary(enable);
+  }
+
+  /**
+   * @brief Is binary mode enabled?
+   *
+   */
+  bool is_binary() const {
+    return binary_;
+  }
+
+  /**
+   * @brief Acknowledges the last received line
+   * @details "ok", or in advanced mode "ok Q<free RX slots> N<line>". The host may have Q lines in flight after
+   * line N. N is the number of the last accepted line, see LineChecker. In advanced mode, one ok acknowledges all
+   * lines received in one burst, otherwise every line gets its ok.
+   * @param from_isr when true, will not wait if buffer is full
+   */
+  void send_ok(bool from_isr);
+
+  /**
+   * @brief Enable or disable the advanced ok
+   *
+   */
+  void set_advanced_ok(bool enable) {
+    advanced_ok_ = enable;
+  }
+
+  /**
+   * @brief Is advanced ok enabled?
+   *
+   */
+  bool is_advanced_ok() const {
+    return advanced_ok_;
+  }
+
+  /**
+   * @brief Line numbers and checksums of received lines
+   *
+   */
+  const LineChecker& get_line_checker() const {
+    return rx_checker_;
+  }
+
+  /**
+   * @brief Set the number of the last accepted line, see LineChecker::set_line()
+   * @details The RX ISRs check lines against the same number, they are masked meanwhile
+   */
+  void set_line(uint32_t line);
+
+  /**
+   * @brief Set the silence after the last received character, which ends a message
+   *
+   * @param bits timeout in bit times, 10 bit times is one character
+   */
+  void set_rx_timeout(uint32_t bits);
+
+  /**
+   * @brief Get the RX timeout in bit times
+   *
+   */
+  uint32_t get_rx_timeout() const {
+    return rx_timeout_;
+  }
+
+  /**
+   * @brief Called on USART receiver timeout, and RX DMA half and full transfer ISRs
+   * @details Splits the received bytes into lines, and queues them
+   */
+  void on_rx_event_ISR();
+
+  /**
+   * @brief Handles a real-time byte, called for every received byte in text mode
+   *
+   * @param woken set, if a task was woken
+   * @return true if \p c is a real-time byte, it is removed from the stream
+   */
+  bool on_realtime_ISR(char c, BaseType_t& woken);
+
+  /**
+   * @brief Sends the status record: "<state Q<free RX slots> N<line>>", state is Idle, Run or Hold
+   * @details Built without printf, from an ISR
+   */
+  void send_status_ISR();
+
   /**
    * @brief GcodeParser needs direct access to rx semaphore
    *
@@ -289,17 +511,46 @@ public:
   friend class GcodeParser;
 
 private:
-  RingBuffer<msg_t, kTxBufferSize> tx_buff_;         //!< Tx ring buffer
-  RingBuffer<msg_t, kRxBufferSize> rx_buff_;         //!< RX Ring buffer
-  std::array<uint8_t, kDmaRxBuffSize> dma_rx_buff_;  //!< DMA buffer
-  SemaphoreHandle_t rx_semaphore_, tx_semaphore_;    //!< RTOS semaphores
-  osThreadId_t uart_send_task_handle_;               //!< RTOS handle to task
-  const osThreadAttr_t kUartSendTaskAttr{ utils::create_thread_attr("uart_send", 128 * 4, osPriorityAboveNormal7) };
+  using rx_framer_t = LineFramer<kDmaRxBuffSize, kMsgLen>;  //!< Framer of the RX DMA buffer
+
+  PackedRingBuffer<kTxBufferSize> tx_buff_;          //!< Tx ring buffer, holds complete lines
+  /**
+   * @brief A queued line
+   * @details It is copied, because dropped lines and real-time bytes received while the queue is full could
+   * overwrite it in the DMA buffer
+   */
+  struct RxLine {
+    rx_framer_t::Line msg;  //!< Copy of the command
+    RxStamps stamps;        //!< When it was received
+  };
+
+  SpscRingBuffer<RxLine, kRxBufferSize> rx_buff_;    //!< RX Ring buffer, copied lines, RX ISRs to gcode_task
+  rx_framer_t rx_framer_;                            //!< DMA buffer, splits it into lines
+  SemaphoreHandle_t rx_semaphore_;                   //!< Given once per RX burst and after I2C jobs, wakes gcode_task
+  std::atomic<bool> tx_busy_{ false };               //!< TX DMA is owned by the consumer of tx_buff_
+  volatile bool deferred_log_{ false };              //!< log() queues binary records instead of text
+  volatile bool binary_{ false };                    //!< Frames are sent and received with COBS and CRC
+  volatile TxPolicy tx_policy_{ TxPolicy::kBlock };  //!< What to do when tx_buff_ is full
+  volatile uint32_t tx_timeout_{ 100 };              //!< Max wait for TX buffer space in ms
+  uint32_t rx_timeout_{ kRxTimeoutBits };            //!< RX timeout in bit times
+  LineChecker rx_checker_;                           //!< Line numbers of received lines
+  volatile bool advanced_ok_{ false };               //!< ok reports free RX slots and line count
+  volatile bool hold_{ false };                      //!< gcode_task takes no lines, see Realtime::kHold
+  volatile uint32_t rx_pushed_{ 0 };                 //!< Number of lines queued in rx_buff_
+  volatile uint32_t rx_popped_{ 0 };                 //!< Number of lines popped from rx_buff_
+  volatile uint32_t rx_drop_until_{ 0 };             //!< Lines before this count are dropped, see Realtime::kReset
+  std::atomic<const uint8_t*> tx_probe_{ nullptr };  //!< TX record of the probed line, until it is sent
+  volatile uint32_t tx_probe_sent_{ 0 };             //!< End of the transfer of the probed line
+  volatile bool tx_probe_done_{ false };             //!< The probed line was sent
+  std::atomic<uint32_t> tx_probes_lost_{ 0 };        //!< Probes lost to dropped lines
+
+  std::array<TxStats, static_cast<size_t>(TxPolicy::kCount)> tx_stats_;  //!< Counters per policy
+  std::array<std::atomic<TaskHandle_t>, kTxWaiters> tx_waiters_{};       //!< Tasks waiting for tx_buff_ space
 
   /**
    * @brief Wrapper for vsnprintf, prints directly into the buffer
    *
-   * @param from_isr when true, will not yield if buffer is full
+   * @param from_isr when true, will not wait if buffer is full
    * @param fmt format
    * @param args args obtained by va_start()
    * @return true on success
@@ -307,44 +558,107 @@ private:
   bool vprintf(bool from_isr, const char* fmt, va_list args);
 
   /**
-   * @brief Get the next free in buffer, block and yield if can't
+   * @brief Queues a deferred log record
+   * @details Record is: kLogMarker, 16 bit format ID, number of arguments, arguments as 32 bit words, little endian
+   * @param from_isr when true, will not wait if buffer is full
+   * @param fmt format in log_fmt section, ID is the offset in the section
+   * @param args arguments converted by to_log_word()
+   * @param n number of arguments
+   * @return true on success
+   */
+  bool log_deferred(bool from_isr, const char* fmt, const uint32_t* args, size_t n);
+
+  /**
+   * @brief Appends the CRC to \p frame, then queues it COBS encoded, with delimiter
    *
-   * @param timeout max time to wait in ms
-   * @return msg_t*
+   * @param from_isr when true, will not wait if buffer is full
+   * @param frame type and payload, with 2 more bytes space for the CRC
+   * @param len length of type and payload
+   * @return true on success
    */
-  msg_t* get_next_free_or_yield(uint32_t timeout);
+  bool send_frame(bool from_isr, uint8_t* frame, size_t len);
 
   /**
-   * @brief Task to transmit from ringBuffer
+   * @brief Converts a log argument to a 32 bit word, floating point is sent as float
    *
-   * Task waits for sempahore, and upon acquiring, transmits all available data from buffer
    */
-  static void uart_transmit_task(void*);
+  template <class T>
+  static uint32_t to_log_word(T val) {
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "Deferred log supports only numbers");
+    if constexpr (std::is_floating_point<T>::value) {
+      const float f = val;
+      uint32_t word;
+      memcpy(&word, &f, sizeof(word));
+      return word;
+    } else {
+      return static_cast<uint32_t>(val);
+    }
+  }
 
   /**
-   * @brief Callback for DMA complete ISR
+   * @brief Reserves space in tx_buff_, if it is full the TX policy is applied
    *
-   * @param huart uart handle
+   * @param len number of bytes to reserve
+   * @param from_isr when true, will not wait if buffer is full
+   * @return uint8_t* pointer to reserved space or nullptr
    */
-  friend void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart);
+  uint8_t* reserve_tx(size_t len, bool from_isr);
 
   /**
-   * @var dma_state_
-   * @brief Anonymous struct to track IDLE line
-   * On IDLE interrupt the countdown is set to a positive value.
-   * Countdown is decremented every ms, when reaches 0, HAL_UART_RxCpltCallback is called
+   * @brief Sleeps until TX DMA completes, or \p timeout expires
+   *
+   * @param timeout max time to wait in ticks
+   */
+  void wait_tx_complete(TickType_t timeout);
+
+  /**
+   * @brief Wakes up the tasks in wait_tx_complete(), called from TX DMA ISR
+   *
+   * @return true if a higher priority task was woken
+   */
+  bool notify_tx_waiters_ISR();
+
+  /**
+   * @brief Reserves a line in tx_buff_ and writes the prefix into it
+   *
+   * @param len length of the message, without prefix and newline
+   * @param from_isr when true, will not wait if buffer is full
+   * @return char* where the message should be written, or nullptr
+   */
+  char* reserve_line(size_t len, bool from_isr);
+
+  /**
+   * @brief Terminates and pushes the line reserved by reserve_line() and starts transmission
+   *
+   * @param msg pointer returned by reserve_line()
+   * @param len length of the message written
+   */
+  void push_line(char* msg, size_t len);
+
+  /**
+   * @brief Starts TX DMA if it is idle, can be called from tasks and ISRs
+   *
+   */
+  void kick_tx();
+
+  /**
+   * @brief Starts DMA transfer of the next line in tx_buff_, or marks TX as idle
+   * IMPORTANT: call only from TX DMA ISR, or after taking ownership of tx_busy_
+   */
+  void start_next_tx();
+
+  /**
+   * @brief Callback for TX DMA complete and error ISR, pops the sent line and starts the next one
+   *
+   * @param hdma DMA handle
    */
-  struct {
-    volatile bool flag{ false };
-    volatile uint16_t countdown{ 0 };
-    uint16_t prevCNDTR{ kDmaRxBuffSize };
-  } dma_state_;
+  static void tx_dma_complete_ISR(DMA_HandleTypeDef* hdma);
 
   /**
-   * @brief When getMessage is called and the buffer is empty, referenci is returned to this variable.
+   * @brief When getMessage is called and the buffer is empty, this is returned
    *
    */
-  static const msg_t kEmptyMsg;
+  static constexpr msg_t kEmptyMsg{ "" };
 };
 
 
@@ -5,6 +5,7 @@
 #include "utils.h"
 #include "stdio.h"
 #include "uart.h"
+#include "log.h"
 #include "cmsis_os.h"
 
 
@@ -80,6 +81,8 @@ namespace DS3231Reg {
 using namespace DS3231Reg;
 
 constexpr uint8_t DS3231::dev_address_;
+constexpr uint8_t DS3231::kRegisters;
+static_assert(DS3231::kRegisters == REGISTER_END, "Register count");
 
 /**
  * @brief Used as default value
@@ -106,10 +109,20 @@ void DS3231::report_all_registers() {
     }
   }
   for (uint8_t i = 0; i < REGISTER_END; ++i) {
-    uart2.printf("buff %d, val: %d", i, buff[i]);
+    LOG("buff %d, val: %d", i, buff[i]);
   }
 }
 
+bool DS3231::write_registers(uint8_t reg, uint8_t* data, size_t len) {
+  if (len == 0 || reg + len > kRegisters) return false;
+  return i2c.get_lock().lock() && i2c.write_register(dev_address_, reg, data, len);
+}
+
+bool DS3231::read_registers(uint8_t reg, uint8_t* data, size_t len) {
+  if (len == 0 || reg + len > kRegisters) return false;
+  return i2c.get_lock().lock() && i2c.read_register(dev_address_, reg, data, len);
+}
+
 
 bool DS3231::get_time(time& t) {
   uint8_t buff[7];
@@ -201,7 +214,7 @@ bool DS3231::set_time(time& t) {
 }
 
 void DS3231::report_time(const time& t) {
-  uart2.printf("%2d.%2d.%4d %2d:%2d:%2d", t.date, t.month, t.year, t.hours, t.minutes, t.seconds);
+  LOG("%2d.%2d.%4d %2d:%2d:%2d", t.date, t.month, t.year, t.hours, t.minutes, t.seconds);
 
   static constexpr const char* strs[] = {
     "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday", "Sunday"
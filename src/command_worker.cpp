@@ -0,0 +1,52 @@
+/**
+ * @file command_worker.cpp
+ * @brief CommandWorker implementation
+ *
+ */
+
+#include "command_worker.h"
+
+#include "os_tasks.h"
+#include "trace.h"
+
+void CommandWorker::begin(const char* name, osPriority_t priority, void (*on_done)()) {
+  on_done_ = on_done;
+  queue_ = xQueueCreateStatic(kQueueLen, sizeof(Job), reinterpret_cast<uint8_t*>(queue_storage_.data()), &queue_cb_);
+  tasks::check_rtos_create(queue_, "WORKER QUEUE");
+  trace::name_queue(queue_, trace::Queue::kWorkerQueue);
+
+  const osThreadAttr_t attr = { .name = name,
+                                .attr_bits = 0,
+                                .cb_mem = &task_cb_,
+                                .cb_size = sizeof(task_cb_),
+                                .stack_mem = stack_.data(),
+                                .stack_size = sizeof(stack_),
+                                .priority = priority,
+                                .tz_module = 0,
+                                .reserved = 0 };
+  task_handle_ = osThreadNew(CommandWorker::task, this, &attr);
+  tasks::check_rtos_create(task_handle_, "WORKER TASK");
+}
+
+uint32_t CommandWorker::post(void (*fn)()) {
+  return push(Job{ &invoke_void, fn, {} });
+}
+
+uint32_t CommandWorker::push(const Job& job) {
+  xQueueSend(queue_, &job, portMAX_DELAY);
+  const uint32_t ticket = posted_.load(std::memory_order_relaxed) + 1;
+  posted_.store(ticket, std::memory_order_relaxed);
+  return ticket;
+}
+
+void CommandWorker::task(void* arg) {
+  auto& worker = *static_cast<CommandWorker*>(arg);
+  Job job;
+  while (1) {
+    if (xQueueReceive(worker.queue_, &job, portMAX_DELAY) == pdTRUE) {
+      job.invoke(job);
+      worker.done_.fetch_add(1, std::memory_order_release);
+      if (worker.on_done_) worker.on_done_();
+    }
+  }
+}
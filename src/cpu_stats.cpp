@@ -0,0 +1,82 @@
+/**
+ * @file cpu_stats.cpp
+ * @brief Context switch counting, snapshots and reports of the CPU load
+ *
+ */
+
+#include "cpu_stats.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "uart.h"
+
+using cpu_stats::kMaxTasks;
+
+static volatile uint32_t switches[kMaxTasks];         /*!< Times the task was switched in, by TCB number - 1*/
+static cpu_stats::Window<cpu_stats::kSamples> window; /*!< Snapshots of the last seconds*/
+static std::array<const char*, kMaxTasks> names{};    /*!< Task names, by TCB number - 1*/
+static volatile size_t idle_index{ kMaxTasks };       /*!< Index of the idle task*/
+
+/**
+ * @brief Counts a context switch, called by traceTASK_SWITCHED_IN() from the scheduler, see FreeRTOSConfig.h
+ *
+ * @param number TCB number of the task, which is switched in, from 1
+ */
+extern "C" void cpu_stats_switched_in(uint32_t number) {
+  const uint32_t index = number - 1;
+  if (index < kMaxTasks) switches[index] = switches[index] + 1;
+}
+
+void cpu_stats::sample(const TaskStatus_t* statuses, size_t count, uint32_t time) {
+  Snapshot snap;
+  snap.time = time;
+  for (size_t i = 0; i < count; ++i) {
+    const size_t index = statuses[i].xTaskNumber - 1;
+    if (index >= kMaxTasks) continue;
+    snap.run[index] = statuses[i].ulRunTimeCounter;
+    snap.switches[index] = switches[index];
+    names[index] = statuses[i].pcTaskName;
+    if (statuses[i].xHandle == xTaskGetIdleTaskHandle()) idle_index = index;
+  }
+  // report() runs on gcode_task, which has a higher priority, it shall not see half a snapshot
+  vTaskSuspendAll();
+  window.add(snap);
+  xTaskResumeAll();
+}
+
+const char* cpu_stats::task_name(uint32_t number) {
+  const uint32_t index = number - 1;
+  return index < kMaxTasks ? names[index] : nullptr;
+}
+
+/**
+ * @brief Logs \p name with the load \p pm in 0.1 %
+ *
+ */
+static void report_task(const char* name, uint32_t pm, uint32_t switched) {
+  uart2.printf("  %s %u.%u%% sw:%lu", name, static_cast<unsigned>(pm / 10), static_cast<unsigned>(pm % 10),
+               static_cast<unsigned long>(switched));
+}
+
+void cpu_stats::report(size_t seconds) {
+  // computed before printing, which may block, and let monitor_task add a snapshot
+  static std::array<Load, kMaxTasks> loads;
+  const uint32_t total = window.diff(seconds, loads);
+  if (total == 0) {
+    uart2.printf("Error: no CPU stats yet");
+    return;
+  }
+
+  uint32_t switched{ 0 };
+  for (const auto& load : loads) switched += load.switches;
+  const uint32_t idle = idle_index < kMaxTasks ? permille(loads[idle_index].run, total) : 0;
+  const uint32_t busy = idle < 1000 ? 1000 - idle : 0;
+  const auto ms = static_cast<unsigned long>(total / (SystemCoreClock / 1000));
+  uart2.printf("CPU %lu ms load:%u.%u%% idle:%u.%u%% sw:%lu", ms, static_cast<unsigned>(busy / 10),
+               static_cast<unsigned>(busy % 10), static_cast<unsigned>(idle / 10), static_cast<unsigned>(idle % 10),
+               static_cast<unsigned long>(switched));
+  for (size_t i = 0; i < kMaxTasks; ++i) {
+    if (names[i] == nullptr) continue;
+    report_task(names[i], permille(loads[i].run, total), loads[i].switches);
+  }
+}
@@ -0,0 +1,32 @@
+/** @file crc16.cpp
+ * CRC peripheral driver
+ */
+
+#include "crc16.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+namespace crc16 {
+
+  void init() {
+    __HAL_RCC_CRC_CLK_ENABLE();
+    CRC->POL = kPolynomial;
+    CRC->INIT = kInit;
+    // 16 bit polynomial, no reflection
+    CRC->CR = CRC_CR_POLYSIZE_0;
+  }
+
+  uint16_t compute(const uint8_t* data, size_t len) {
+    // the peripheral is shared by the RX and TX paths, which run in tasks and ISRs
+    const auto mask = taskENTER_CRITICAL_FROM_ISR();
+    CRC->CR |= CRC_CR_RESET;
+    for (size_t i = 0; i < len; ++i) {
+      *reinterpret_cast<volatile uint8_t*>(&CRC->DR) = data[i];
+    }
+    const uint16_t crc = CRC->DR;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return crc;
+  }
+
+}  // namespace crc16
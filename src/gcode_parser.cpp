@@ -5,6 +5,15 @@
 #include "semphr.h"
 #include "os_tasks.h"
 #include "uart.h"
+#include "cobs.h"
+#include "crc16.h"
+#include "command_table.h"
+#include "latency.h"
+#include "cpu_stats.h"
+#include "DS3231/DS3231.h"
+
+#include <cstdio>
+#include <cstring>
 
 /**
  * @file gcode_parser.cpp
@@ -13,18 +22,106 @@
  */
 
 
+using GcodeCommand = Command<GcodeParser>;
+
+/** @name Gcode Parameters
+ *
+ * Parameters of the gcodes, a command is rejected with an error, before the gcode is called
+ */
+///@{
+static constexpr ParamSpec kA2Params[] = {
+  ParamSpec::integer('S', 0, 59), ParamSpec::integer('M', 0, 59), ParamSpec::integer('H', 0, 23),
+  ParamSpec::integer('W', 1, 7), ParamSpec::integer('D', 1, 31), ParamSpec::integer('O', 1, 12),
+  ParamSpec::integer('Y', 2000, 2099),
+};
+static constexpr ParamSpec kA4Params[] = { ParamSpec::integer('S', 0, 1) };
+static constexpr ParamSpec kA5Params[] = {
+  ParamSpec::integer('P', 0, static_cast<int32_t>(Uart::TxPolicy::kCount) - 1),
+  ParamSpec::integer('T', 1, 60000),
+  ParamSpec::flag('R'),
+};
+static constexpr ParamSpec kA6Params[] = { ParamSpec::integer('S', 1, USART_RTOR_RTO) };
+static constexpr ParamSpec kA7Params[] = { ParamSpec::integer('S', 0, 1) };
+static constexpr ParamSpec kA8Params[] = { ParamSpec::integer('S', 0, 1) };
+static constexpr ParamSpec kA9Params[] = { ParamSpec::integer('N', 0, INT32_MAX) };
+static constexpr ParamSpec kA10Params[] = { ParamSpec::flag('H'), ParamSpec::flag('R') };
+static constexpr int32_t kMacroName = MacroStore<GcodeParser::kMacroSize>::kMaxName;
+static constexpr ParamSpec kA11Params[] = { ParamSpec::string('S', 1, kMacroName) };
+static constexpr ParamSpec kA12Params[] = {
+  ParamSpec::string('S', 1, kMacroName).required(), ParamSpec::integer('L', 1, 10000),
+  // arguments substituted for #<letter>
+  ParamSpec::integer('A', INT32_MIN, INT32_MAX), ParamSpec::integer('B', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('C', INT32_MIN, INT32_MAX), ParamSpec::integer('D', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('E', INT32_MIN, INT32_MAX), ParamSpec::integer('F', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('G', INT32_MIN, INT32_MAX), ParamSpec::integer('H', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('I', INT32_MIN, INT32_MAX), ParamSpec::integer('J', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('K', INT32_MIN, INT32_MAX), ParamSpec::integer('M', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('N', INT32_MIN, INT32_MAX), ParamSpec::integer('O', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('P', INT32_MIN, INT32_MAX), ParamSpec::integer('Q', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('R', INT32_MIN, INT32_MAX), ParamSpec::integer('T', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('U', INT32_MIN, INT32_MAX), ParamSpec::integer('V', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('W', INT32_MIN, INT32_MAX), ParamSpec::integer('X', INT32_MIN, INT32_MAX),
+  ParamSpec::integer('Y', INT32_MIN, INT32_MAX), ParamSpec::integer('Z', INT32_MIN, INT32_MAX),
+};
+static constexpr ParamSpec kA13Params[] = { ParamSpec::string('S', 1, kMacroName), ParamSpec::flag('D') };
+static constexpr ParamSpec kA14Params[] = {
+  ParamSpec::integer('R', 0, DS3231::kRegisters - 1).required(),
+  ParamSpec::array('D', 0, UINT8_MAX),
+  ParamSpec::integer('N', 1, DS3231::kRegisters),
+};
+static constexpr ParamSpec kA15Params[] = { ParamSpec::integer('W', 1, static_cast<int32_t>(cpu_stats::kSamples) - 1) };
+static constexpr ParamSpec kA16Params[] = { ParamSpec::integer('S', 0, 1) };
+///@}
+
+/**
+ * @brief All gcodes, a new gcode needs a line here, and its member function
+ *
+ */
+static constexpr GcodeCommand kGcodes[] = {
+  GcodeCommand::of<&GcodeParser::A0>('A', 0, &kNoParams),
+  GcodeCommand::of<&GcodeParser::A1>('A', 1, &kNoParams),
+  GcodeCommand::of<&GcodeParser::A2>('A', 2, &kSchema<kA2Params>),
+  GcodeCommand::of<&GcodeParser::A3>('A', 3, &kNoParams),
+  GcodeCommand::of<&GcodeParser::A4>('A', 4, &kSchema<kA4Params>),
+  GcodeCommand::of<&GcodeParser::A5>('A', 5, &kSchema<kA5Params>),
+  GcodeCommand::of<&GcodeParser::A6>('A', 6, &kSchema<kA6Params>),
+  GcodeCommand::of<&GcodeParser::A7>('A', 7, &kSchema<kA7Params>),
+  GcodeCommand::of<&GcodeParser::A8>('A', 8, &kSchema<kA8Params>),
+  GcodeCommand::of<&GcodeParser::A9>('A', 9, &kSchema<kA9Params>),
+  GcodeCommand::of<&GcodeParser::A10>('A', 10, &kSchema<kA10Params>),
+  GcodeCommand::of<&GcodeParser::A11>('A', 11, &kSchema<kA11Params>),
+  GcodeCommand::of<&GcodeParser::A12>('A', 12, &kSchema<kA12Params>),
+  GcodeCommand::of<&GcodeParser::A13>('A', 13, &kSchema<kA13Params>),
+  GcodeCommand::of<&GcodeParser::A14>('A', 14, &kSchema<kA14Params>),
+  GcodeCommand::of<&GcodeParser::A15>('A', 15, &kSchema<kA15Params>),
+  GcodeCommand::of<&GcodeParser::A16>('A', 16, &kSchema<kA16Params>),
+};
+
+static constexpr CommandTable<GcodeParser, command_table_size(kGcodes)> kGcodeTable(kGcodes);
+static_assert(kGcodeTable.is_valid(), "Duplicate gcode, or letter out of range");
+
+static latency::Tracker<kGcodeTable.size()> tracker; /*!< Latency histograms of the gcodes and the stages*/
 
 void GcodeParser::gcode_task(void* arg) {
   while (1) {
     if (xSemaphoreTake(uart2.rx_semaphore_, portMAX_DELAY)) {
-      while (uart2.has_message()) {
+      gcode.measure_reply();
+      gcode.send_acks();
+      while (uart2.has_message() && !uart2.is_held() && !gcode.acks_.is_full()) {
         const bool need_ok = uart2.is_rx_full();
-        const auto& msg = uart2.get_message();
-        gcode.parse_and_call(msg.data());
-        uart2.send_queue(msg.data());
+        const auto msg = uart2.get_message();
+        gcode.measure_line(uart2.get_message_stamps());
+        if (uart2.is_message_dropped()) {
+          // received before a reset
+        } else if (uart2.is_binary()) {
+          gcode.parse_and_call_frame(reinterpret_cast<const uint8_t*>(msg.data()), msg.size());
+        } else {
+          gcode.parse_and_call(msg.data());
+          gcode.ack(msg);
+        }
         uart2.pop_rx();
         if (need_ok) {
-          uart2.printf("ok");
+          uart2.send_ok(false);
         }
       }
     }
@@ -34,35 +131,212 @@ void GcodeParser::gcode_task(void* arg) {
 void GcodeParser::begin() {
   gcode_task_handle_ = osThreadNew(GcodeParser::gcode_task, NULL, &kGcodeTaskAttr_);
   tasks::check_rtos_create(gcode_task_handle_, "GCODE TASK");
+  i2c_worker_.begin("i2c_worker", osPriorityNormal, GcodeParser::on_job_done);
+}
+
+void GcodeParser::ack(Uart::msg_t msg) {
+  const uint32_t ticket = i2c_worker_.last_ticket();
+  if (acks_.is_empty() && i2c_worker_.is_done(ticket)) {
+    echo(msg.data(), msg.size());
+    return;
+  }
+  Ack* ack = acks_.get_next_free();
+  ack->ticket = ticket;
+  ack->len = static_cast<uint8_t>(utils::min(msg.size(), sizeof(ack->line)));
+  memcpy(ack->line, msg.data(), ack->len);
+  acks_.push();
+}
+
+void GcodeParser::send_acks() {
+  while (const Ack* ack = acks_.get_next_occupied()) {
+    if (!i2c_worker_.is_done(ack->ticket)) return;
+    echo(ack->line, ack->len);
+    acks_.pop();
+  }
+}
+
+void GcodeParser::echo(const char* line, size_t len) {
+  // a new probe replaces a finished one, count it first, gcode_task may not have woken since
+  measure_reply();
+  const uint32_t queued = latency::now();
+  if (uart2.send_queue_probed(line, len)) probe_queued_ = queued;
+}
+
+void GcodeParser::measure_line(Uart::RxStamps stamps) {
+  line_event_ = stamps.event;
+  tracker.stage(latency::Stage::kQueue).add(stamps.queued - stamps.event);
+  tracker.stage(latency::Stage::kWait).add(latency::now() - stamps.queued);
+}
+
+void GcodeParser::measure_reply() {
+  uint32_t sent{ 0 };
+  if (uart2.get_tx_probe(sent)) tracker.stage(latency::Stage::kReply).add(sent - probe_queued_);
+  lost_replies_ += uart2.take_lost_tx_probes();
+}
+
+void GcodeParser::report_latency(bool buckets) {
+  char name[8];
+  for (const auto& entry : kGcodes) {
+    const GcodeCommand* cmd = kGcodeTable.find(entry.letter, entry.number);
+    snprintf(name, sizeof(name), "%c%u", entry.letter, static_cast<unsigned>(entry.number));
+    latency::report(name, tracker.command(kGcodeTable.index(cmd)), buckets);
+  }
+  for (size_t i = 0; i < static_cast<size_t>(latency::Stage::kCount); ++i) {
+    const auto stage = static_cast<latency::Stage>(i);
+    latency::report(latency::stage_name(stage), tracker.stage(stage), buckets);
+  }
+  if (lost_replies_) uart2.printf("reply lost:%lu", static_cast<unsigned long>(lost_replies_));
+}
+
+void GcodeParser::reset_latency() {
+  tracker.reset();
+  lost_replies_ = 0;
+}
+
+void GcodeParser::on_job_done() {
+  xSemaphoreGive(uart2.rx_semaphore_);
 }
 
 void GcodeParser::parse_and_call(const char* arr) {
-  parser_.set_string(arr);
-  switch (parser_.get_prefix()) {
-    case 'A':
-      parse_A();
-      break;
+  if (macros_.is_recording()) {
+    // every line is recorded, but the one, which ends recording
+    parser_.set_string(arr);
+    if (parser_.get_prefix() != 'A' || parser_.get_number() != 11) {
+      record(arr);
+      return;
+    }
+  }
+  while (arr != nullptr) {
+    arr = parser_.set_string(arr);
+    if (parser_.has_string()) call();
+    if (macro_count_) run_macro();
+  }
+}
 
-    default:
-      break;
+void GcodeParser::record(const char* line) {
+  if (!macros_.append(line)) {
+    uart2.printf("Error: macro store full, recording stopped");
+  }
+}
+
+void GcodeParser::run_macro() {
+  const std::string_view body = macro_body_;
+  const uint32_t count = macro_count_;
+  macro_count_ = 0;
+  const uint32_t line_event = line_event_;
+  bool ok{ true };
+  in_macro_ = true;
+  for (uint32_t i = 0; ok && i < count; ++i) {
+    macro_args_.set('L', static_cast<int32_t>(i));
+    std::string_view rest = body, cmd;
+    while (ok && MacroStore<kMacroSize>::next_line(rest, cmd)) {
+      char missing{ 0 };
+      if (!expand_macro_line(cmd, macro_args_, macro_line_, sizeof(macro_line_), missing)) {
+        if (missing) {
+          uart2.printf("Error: macro argument %c missing", missing);
+        } else {
+          uart2.printf("Error: macro line too long");
+        }
+        ok = false;
+      } else if (!wait_if_held()) {
+        ok = false;  // reset received
+      } else {
+        // the lines of the macro are measured from their start, not from the RX of the run command
+        line_event_ = latency::now();
+        for (const char* arr = macro_line_; arr != nullptr;) {
+          arr = parser_.set_string(arr);
+          if (parser_.has_string()) call();
+        }
+      }
+    }
+  }
+  in_macro_ = false;
+  line_event_ = line_event;
+}
+
+bool GcodeParser::wait_if_held() {
+  // resume and reset give the semaphore, so do finished I2C jobs, like in gcode_task
+  while (uart2.is_held() && !uart2.is_message_dropped()) {
+    if (xSemaphoreTake(uart2.rx_semaphore_, portMAX_DELAY)) send_acks();
+  }
+  return !uart2.is_message_dropped();
+}
+
+bool GcodeParser::parse_and_call_frame(const uint8_t* frame, size_t len) {
+  uint8_t cmd[Uart::kMsgLen];
+  size_t cmd_len{ 0 };
+  if (len > sizeof(cmd) || !cobs::decode(frame, len, cmd, cmd_len) || cmd_len < 2) {
+    uart2.printf("Bad frame");
+    return false;
+  }
+  // CRC is little endian after the command
+  cmd_len -= 2;
+  if (crc16::compute(cmd, cmd_len) != (cmd[cmd_len] | (cmd[cmd_len + 1] << 8))) {
+    uart2.printf("Bad CRC");
+    return false;
+  }
+  if (!parser_.set_binary(cmd, cmd_len)) {
+    uart2.printf("Bad command");
+    return false;
+  }
+  call();
+  if (macro_count_) run_macro();
+  return true;
+}
+
+void GcodeParser::call() {
+  const GcodeCommand* cmd = kGcodeTable.find(parser_.get_prefix(), parser_.get_number());
+  if (cmd == nullptr) return;
+
+  const uint32_t start = latency::now();
+  ParamError error;
+  if (cmd->schema && !parser_.validate(*cmd->schema, error)) {
+    report(error);
+  } else {
+    cmd->handler(*this);
   }
+  const uint32_t end = latency::now();
+  tracker.stage(latency::Stage::kRun).add(end - start);
+  tracker.command(kGcodeTable.index(cmd)).add(end - line_event_);
 }
 
-void GcodeParser::parse_A() {
-  switch (parser_.get_number()) {
-    case 0:
-      A0();
+/**
+ * @brief Formats a range limit, fixed point ones with their decimals, e.g. -1250 with 2 decimals is -12.50
+ *
+ */
+static void format_limit(char (&buff)[16], int32_t val, uint8_t decimals) {
+  if (decimals == 0) {
+    snprintf(buff, sizeof(buff), "%ld", static_cast<long>(val));
+    return;
+  }
+  unsigned long pow{ 1 };
+  for (uint8_t i = 0; i < decimals; ++i) pow *= 10;
+  const unsigned long mag = val < 0 ? 0ul - static_cast<unsigned long>(val) : static_cast<unsigned long>(val);
+  snprintf(buff, sizeof(buff), "%s%lu.%0*lu", val < 0 ? "-" : "", mag / pow, static_cast<int>(decimals), mag % pow);
+}
+
+void GcodeParser::report(const ParamError& error) {
+  const char prefix = parser_.get_prefix();
+  const unsigned number = parser_.get_number();
+  switch (error.kind) {
+    case ParamError::Kind::kUnknown:
+      uart2.printf("Error: %c%u unknown parameter %c", prefix, number, error.letter);
       break;
-    case 1:
-      A1();
+    case ParamError::Kind::kMissing:
+      uart2.printf("Error: %c%u missing parameter %c", prefix, number, error.letter);
       break;
-    case 2:
-      A2();
+    case ParamError::Kind::kValue:
+      uart2.printf("Error: %c%u bad value of %c", prefix, number, error.letter);
       break;
-    case 3:
-      A3();
+    case ParamError::Kind::kRange: {
+      char min[16], max[16];
+      format_limit(min, error.spec->min, error.spec->decimals);
+      format_limit(max, error.spec->max, error.spec->decimals);
+      const bool string = error.spec->type == ParamSpec::Type::kString;
+      uart2.printf("Error: %c%u %c%s out of range %s..%s", prefix, number, error.letter, string ? " length" : "", min,
+                   max);
       break;
-
+    }
     default:
       break;
   }
@@ -0,0 +1,27 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A10 reports the latency histograms
+ *
+ * @details
+ * Every gcode is measured from the RX interrupt of its line to the end of its handler. The stages of all gcodes are
+ * measured separately: queue is the RX interrupt until the line is queued, wait is until gcode_task takes it, run is
+ * validation and handler, reply is the echo queued until its TX transfer ends, sampled one echo at a time. A reply
+ * sample is lost, if the TX policy drops lines meanwhile, lost samples are reported as "reply lost:<count>". Durations
+ * are counted in power of 2 buckets of the DWT cycle counter. Every non-empty histogram is reported as
+ * "<name> n:<count> max:<us> us", then "  p50:<us> p90:<us> p99:<us> us", percentiles are the upper bounds of their
+ * buckets.
+ * Parameters:
+ * **H**: report the buckets too
+ * **R**: reset the histograms, after the report
+ */
+void GcodeParser::A10() {
+  int32_t val{ 0 };
+  report_latency(parser_.get_parameter('H', val));
+  if (parser_.get_parameter('R', val)) {
+    reset_latency();
+  }
+}
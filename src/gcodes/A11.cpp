@@ -0,0 +1,34 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A11 starts and ends recording a macro
+ *
+ * @details
+ * While recording, received lines are appended to the macro, instead of being run, until a line starting with A11.
+ * The lines are echoed as usual. A line may contain "#<letter>", which is replaced by the argument of A12, e.g. "A9
+ * N#N". Macros are kept in RAM, GcodeParser::kMacroSize bytes for all names and lines, until reset.
+ * Parameters:
+ * **S**: name of the macro, up to 8 characters, it replaces the macro of the same name. Without S recording ends
+ */
+void GcodeParser::A11() {
+  if (in_macro_) {
+    uart2.printf("Error: A11 in a macro");
+    return;
+  }
+  const char* name{ nullptr };
+  if (!parser_.get_string('S', name)) {
+    if (macros_.is_recording()) {
+      LOG("Macro recorded, %u bytes free", static_cast<unsigned>(macros_.get_free()));
+    }
+    macros_.end();
+    return;
+  }
+  if (!macros_.begin(name)) {
+    uart2.printf("Error: macro store full");
+    return;
+  }
+  uart2.printf("Recording macro %s", name);
+}
@@ -0,0 +1,46 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A12 runs a macro
+ *
+ * @details
+ * The lines of the macro are run in order, like received lines, but they are not echoed. The echo of A12 is sent,
+ * when the macro ends, so the host waits for one round trip only. "#<letter>" in a line is replaced by the integer
+ * argument of A12, "#L" by the iteration, from 0. A line with a missing argument stops the macro with an error, so
+ * does a reset received meanwhile. A hold pauses the macro between lines. Macros can't be run, recorded or removed by
+ * a macro.
+ * Parameters:
+ * **S**: name of the macro
+ * **L**: number of times the macro runs, default 1
+ * **A-Z**: integer arguments, but S and L
+ */
+void GcodeParser::A12() {
+  if (in_macro_) {
+    uart2.printf("Error: A12 in a macro");
+    return;
+  }
+  const char* name{ nullptr };
+  std::string_view body;
+  parser_.get_string('S', name);
+  if (!macros_.find(name, body)) {
+    uart2.printf("Error: unknown macro %s", name);
+    return;
+  }
+
+  // the lines of the macro overwrite parser_
+  int32_t count{ 1 };
+  parser_.get_parameter('L', count, 1);
+  macro_args_ = MacroArgs{};
+  for (char letter = 'A'; letter <= 'Z'; ++letter) {
+    int32_t val{ 0 };
+    if (letter != 'S' && letter != 'L' && parser_.get_parameter(letter, val)) {
+      macro_args_.set(letter, val);
+    }
+  }
+  // run by the caller, after this returns
+  macro_body_ = body;
+  macro_count_ = static_cast<uint32_t>(count);
+}
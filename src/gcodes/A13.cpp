@@ -0,0 +1,43 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A13 lists, prints and removes macros
+ *
+ * @details
+ * Without parameters, every macro is listed as "<name>: <bytes>", then the free bytes of the store.
+ * Parameters:
+ * **S**: name of a macro, its lines are printed
+ * **D**: remove macro S instead
+ */
+void GcodeParser::A13() {
+  const char* name{ nullptr };
+  if (!parser_.get_string('S', name)) {
+    macros_.for_each([](std::string_view macro, std::string_view body) {
+      uart2.printf("%.*s: %u", static_cast<int>(macro.size()), macro.data(), static_cast<unsigned>(body.size()));
+    });
+    LOG("Macros: %u bytes free", static_cast<unsigned>(macros_.get_free()));
+    return;
+  }
+
+  int32_t val{ 0 };
+  if (parser_.get_parameter('D', val)) {
+    if (in_macro_) {
+      uart2.printf("Error: A13 D in a macro");
+    } else if (!macros_.remove(name)) {
+      uart2.printf("Error: unknown macro %s", name);
+    }
+    return;
+  }
+
+  std::string_view body, line;
+  if (!macros_.find(name, body)) {
+    uart2.printf("Error: unknown macro %s", name);
+    return;
+  }
+  while (MacroStore<kMacroSize>::next_line(body, line)) {
+    uart2.printf("%.*s", static_cast<int>(line.size()), line.data());
+  }
+}
@@ -0,0 +1,75 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+#include "DS3231/DS3231.h"
+
+/**
+ * @brief Parameters of A14, a copy of the array, the line is reused before the job runs
+ *
+ */
+struct RegisterArgs {
+  uint8_t reg;                       //!< First register
+  uint8_t len;                       //!< Number of registers
+  bool write;                        //!< Write data, otherwise read
+  uint8_t data[DS3231::kRegisters];  //!< Values to write
+};
+
+/**
+ * @brief Runs on the I2C worker, writes or reads the registers in one transfer
+ *
+ */
+static void transfer_registers(const RegisterArgs& args) {
+  uint8_t data[DS3231::kRegisters];
+  if (args.write) {
+    memcpy(data, args.data, args.len);
+    if (!rtc.write_registers(args.reg, data, args.len)) {
+      LOG("Register write failed!");
+    }
+    return;
+  }
+  if (!rtc.read_registers(args.reg, data, args.len)) {
+    LOG("Register read failed!");
+    return;
+  }
+  static constexpr char kHex[] = "0123456789ABCDEF";
+  char hex[2 * DS3231::kRegisters + 1];
+  for (uint8_t i = 0; i < args.len; ++i) {
+    hex[2 * i] = kHex[data[i] >> 4];
+    hex[2 * i + 1] = kHex[data[i] & 0xF];
+  }
+  hex[2 * args.len] = '\0';
+  uart2.printf("R%u: %s", static_cast<unsigned>(args.reg), hex);
+}
+
+/**
+ * @brief Gcode A14 writes or reads consecutive RTC registers in one command
+ *
+ * @details
+ * The registers are transferred by the I2C worker in one transfer, the command is pending until then. A write of all
+ * registers is one line, e.g. "A14 R7 D$00000080" sets alarm 1, instead of a command per register. A read is reported
+ * as "R<reg>: <hex bytes>", the format of D.
+ * Parameters:
+ * **R**: first register, 0 to 0x12
+ * **D**: values to write, e.g. D1,2,3 or D$010203, a byte array in binary mode
+ * **N**: number of registers to read, without D, default 1
+ */
+void GcodeParser::A14() {
+  RegisterArgs args{};
+  int32_t reg{ 0 }, count{ 1 };
+  ParamArray data;
+  parser_.get_parameter('R', reg);
+  parser_.get_parameter('N', count, 1);
+  args.write = parser_.get_array('D', data);
+  if (args.write) count = static_cast<int32_t>(data.size());
+  if (count < 1 || reg + count > DS3231::kRegisters) {
+    uart2.printf("Error: A14 registers %d..%d out of range", static_cast<int>(reg), static_cast<int>(reg + count - 1));
+    return;
+  }
+  uint8_t* dest = args.data;
+  data.for_each([&dest](int32_t val) { *dest++ = static_cast<uint8_t>(val); });
+  args.reg = static_cast<uint8_t>(reg);
+  args.len = static_cast<uint8_t>(count);
+  i2c_worker_.post(transfer_registers, args);
+}
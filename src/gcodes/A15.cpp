@@ -0,0 +1,22 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+#include "cpu_stats.h"
+
+/**
+ * @brief Gcode A15 reports the CPU load of the tasks
+ *
+ * @details
+ * monitor_task samples the FreeRTOS run time stats every second, which count DWT cycles, and the context switches.
+ * The report covers the last W seconds: "CPU <ms> ms load:<%> idle:<%> sw:<switches>", then
+ * "  <task> <%> sw:<switches>" for every task. Load is the time not spent in the idle task, the headroom is idle.
+ * Parameters:
+ * **W**: window in seconds, the longest one by default
+ */
+void GcodeParser::A15() {
+  int32_t seconds{ cpu_stats::kSamples - 1 };
+  parser_.get_parameter('W', seconds);
+  cpu_stats::report(seconds);
+}
@@ -0,0 +1,35 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+#include "trace.h"
+
+/**
+ * @brief Gcode A16 dumps the kernel event trace
+ *
+ * @details
+ * The trace holds the last task switches, operations on the RX semaphore, the I2C mutex and the worker queue, and the
+ * UART interrupts. Without parameters recording is stopped, the trace is dumped, then cleared and recording restarts.
+ * The dump is "TRACE hz:<cycles per s> n:<records> lost:<overwritten>", the names of the tasks, queues and
+ * interrupts, the records in binary, then "TRACE end sent:<records>". Capture it in text mode, and convert it to
+ * Chrome trace JSON with tools/trace2chrome.cpp. The dump is the deepest call chain of gcode_task, the least free
+ * stack of gcode_task is reported after it, "Stack free: <words>".
+ * Parameters:
+ * **S**: 0 stops recording, 1 clears the trace and starts recording, nothing is dumped
+ */
+void GcodeParser::A16() {
+  int32_t state{ 0 };
+  if (parser_.get_parameter('S', state)) {
+    if (state) {
+      trace::restart();
+    } else {
+      trace::stop();
+    }
+    return;
+  }
+  trace::stop();
+  trace::dump();
+  trace::restart();
+  LOG("Stack free: %u", static_cast<unsigned>(uxTaskGetStackHighWaterMark(nullptr)));
+}
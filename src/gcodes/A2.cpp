@@ -1,13 +1,54 @@
 #include "gcode_parser.h"
 #include "main.h"
 #include "uart.h"
+#include "log.h"
 
 #include "DS3231/DS3231.h"
 
+/**
+ * @brief Parameters of A2, fields with their bit set in given are written
+ *
+ */
+struct SetTimeArgs {
+  DS3231::time t;  //!< New values
+  uint8_t given;   //!< Bit n is set, if field n of kFields was given
+};
+
+static constexpr char kFields[] = "SMHWDOY"; /*!< Parameters of A2, in the order of the bits of SetTimeArgs::given*/
+
+/**
+ * @brief Runs on the I2C worker, replaces the given fields of the current time
+ *
+ */
+static void set_time(const SetTimeArgs& args) {
+  DS3231::time t{ 0 };
+
+  if (!rtc.get_time(t)) {
+    LOG("Couldn't get time");
+    return;
+  }
+
+  t.am_pm = DS3231::AM_PM_UNUSED;
+  if (args.given & (1 << 0)) t.seconds = args.t.seconds;
+  if (args.given & (1 << 1)) t.minutes = args.t.minutes;
+  if (args.given & (1 << 2)) t.hours = args.t.hours;
+  if (args.given & (1 << 3)) t.day = args.t.day;
+  if (args.given & (1 << 4)) t.date = args.t.date;
+  if (args.given & (1 << 5)) t.month = args.t.month;
+  if (args.given & (1 << 6)) t.year = args.t.year;
+
+  if (rtc.set_time(t)) {
+    LOG("Time set!");
+  } else {
+    LOG("Time set failed!");
+  }
+}
+
 /**
  * @brief Gcode A2 sets the time from the given parameters
  *
  * @details
+ * The parameters are read here, the RTC is written by the I2C worker, the command is pending until then.
  * Parameters:
  * **S**: seconds
  * **M**: minutes
@@ -18,41 +59,21 @@
  * **Y**: year
  */
 void GcodeParser::A2() {
-  DS3231::time t{ 0 };
-
-  if (!rtc.get_time(t)) {
-    uart2.printf("Couldn't get time");
-    return;
-  }
-
-  t.am_pm = DS3231::AM_PM_UNUSED;
-  int16_t dest{ 0 };
+  SetTimeArgs args{};
+  int16_t val[sizeof(kFields) - 1]{ 0 };
 
-  if (parser_.get_parameter('S', dest)) {
-    t.seconds = dest;
-  }
-  if (parser_.get_parameter('M', dest)) {
-    t.minutes = dest;
-  }
-  if (parser_.get_parameter('H', dest)) {
-    t.hours = dest;
-  }
-  if (parser_.get_parameter('W', dest)) {
-    t.day = dest;
-  }
-  if (parser_.get_parameter('D', dest)) {
-    t.date = dest;
-  }
-  if (parser_.get_parameter('O', dest)) {
-    t.month = dest;
-  }
-  if (parser_.get_parameter('Y', dest)) {
-    t.year = dest;
+  for (size_t i = 0; i < sizeof(kFields) - 1; ++i) {
+    if (parser_.get_parameter(kFields[i], val[i])) {
+      args.given |= 1 << i;
+    }
   }
+  args.t.seconds = val[0];
+  args.t.minutes = val[1];
+  args.t.hours = val[2];
+  args.t.day = val[3];
+  args.t.date = val[4];
+  args.t.month = val[5];
+  args.t.year = val[6];
 
-  if (rtc.set_time(t)) {
-    uart2.printf("Time set!");
-  } else {
-    uart2.printf("Time set failed!");
-  }
+  i2c_worker_.post(set_time, args);
 }
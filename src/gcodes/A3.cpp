@@ -1,14 +1,29 @@
 #include "gcode_parser.h"
 #include "main.h"
 #include "uart.h"
+#include "log.h"
 
 #include "DS3231/DS3231.h"
 
-void GcodeParser::A3() {
+/**
+ * @brief Runs on the I2C worker, reads and reports the time
+ *
+ */
+static void report_time() {
   DS3231::time t;
   if (rtc.get_time(t)) {
     DS3231::report_time(t);
   } else {
-    uart2.printf("Failed to get time");
+    LOG("Failed to get time");
   }
 }
+
+/**
+ * @brief Gcode A3 reports the current time
+ *
+ * @details
+ * The RTC is read by the I2C worker, the command is pending until then.
+ */
+void GcodeParser::A3() {
+  i2c_worker_.post(report_time);
+}
@@ -0,0 +1,19 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A4 enables or disables deferred logging
+ *
+ * @details
+ * Parameters:
+ * **S**: 1 to enable, 0 to disable, reports the current state when omitted
+ */
+void GcodeParser::A4() {
+  int16_t enable{ 0 };
+  if (parser_.get_parameter('S', enable)) {
+    uart2.set_deferred_log(enable != 0);
+  }
+  LOG("Deferred log: %d", static_cast<int>(uart2.is_deferred_log()));
+}
@@ -0,0 +1,36 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A5 configures the TX overflow policy and reports the counters
+ *
+ * @details
+ * Parameters:
+ * **P**: policy, 0 - block, 1 - drop newest, 2 - drop oldest
+ * **T**: max wait in ms when blocking
+ * **R**: reset the counters
+ * Reports the settings and the counters of every policy: dropped lines, waits, total and max wait time in ms
+ */
+void GcodeParser::A5() {
+  int32_t val{ 0 };
+  if (parser_.get_parameter('P', val)) {
+    uart2.set_tx_policy(static_cast<Uart::TxPolicy>(val));
+  }
+  if (parser_.get_parameter('T', val)) {
+    uart2.set_tx_timeout(val);
+  }
+  if (parser_.get_parameter('R', val)) {
+    uart2.reset_tx_stats();
+  }
+
+  LOG("TX policy: %d timeout: %u", static_cast<int>(uart2.get_tx_policy()),
+      static_cast<unsigned>(uart2.get_tx_timeout()));
+  for (size_t i = 0; i < static_cast<size_t>(Uart::TxPolicy::kCount); ++i) {
+    const auto& stats = uart2.get_tx_stats(static_cast<Uart::TxPolicy>(i));
+    LOG("P%d drop: %u wait: %u total: %u max: %u", static_cast<int>(i), static_cast<unsigned>(stats.dropped),
+        static_cast<unsigned>(stats.waits), static_cast<unsigned>(stats.wait_ticks * portTICK_PERIOD_MS),
+        static_cast<unsigned>(stats.max_wait_ticks * portTICK_PERIOD_MS));
+  }
+}
@@ -0,0 +1,19 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A6 sets the RX timeout, the silence which ends a received message
+ *
+ * @details
+ * Parameters:
+ * **S**: timeout in bit times, 10 bit times is one character. Reports the current value when omitted
+ */
+void GcodeParser::A6() {
+  int32_t bits{ 0 };
+  if (parser_.get_parameter('S', bits)) {
+    uart2.set_rx_timeout(bits);
+  }
+  LOG("RX timeout: %u bits", static_cast<unsigned>(uart2.get_rx_timeout()));
+}
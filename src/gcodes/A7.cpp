@@ -0,0 +1,21 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A7 enables or disables the advanced ok
+ *
+ * @details
+ * With advanced ok, every ok is "ok Q<free RX slots> N<line count>", so the host can pipeline commands. One ok
+ * acknowledges all lines of an RX burst.
+ * Parameters:
+ * **S**: 1 to enable, 0 to disable, reports the current state when omitted
+ */
+void GcodeParser::A7() {
+  int16_t enable{ 0 };
+  if (parser_.get_parameter('S', enable)) {
+    uart2.set_advanced_ok(enable != 0);
+  }
+  LOG("Advanced ok: %d", static_cast<int>(uart2.is_advanced_ok()));
+}
@@ -0,0 +1,20 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A8 switches between text and binary mode
+ *
+ * @details
+ * In binary mode commands and replies are COBS frames with CRC, see tools/binary_link.cpp
+ * Parameters:
+ * **S**: 1 for binary, 0 for text, reports the current mode when omitted
+ */
+void GcodeParser::A8() {
+  int16_t enable{ 0 };
+  if (parser_.get_parameter('S', enable)) {
+    uart2.set_binary(enable != 0);
+  }
+  LOG("Binary mode: %d", static_cast<int>(uart2.is_binary()));
+}
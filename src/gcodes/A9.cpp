@@ -0,0 +1,26 @@
+#include "gcode_parser.h"
+#include "main.h"
+#include "uart.h"
+#include "log.h"
+
+/**
+ * @brief Gcode A9 sets and reports the line number
+ *
+ * @details
+ * Numbered lines are "N<line> <command>*<checksum>", see LineChecker. "N<line> A9*<checksum>" is accepted with any line
+ * number, and the next line shall be line + 1. A plain A9 ends numbered mode, plain lines are accepted again.
+ * Reports the line number, the resend requests, the corrupted lines, and the plain lines and binary frames dropped,
+ * because the RX queue was full.
+ * Parameters:
+ * **N**: number of the last line, the next line shall be N + 1. Lines already received count from the old number
+ */
+void GcodeParser::A9() {
+  const auto& checker = uart2.get_line_checker();
+  int32_t line{ 0 };
+  if (parser_.get_parameter('N', line)) {
+    uart2.set_line(line);
+  }
+  LOG("Line: %u, resends: %u, errors: %u, drops: %u", static_cast<unsigned>(checker.get_line()),
+      static_cast<unsigned>(checker.get_resends()), static_cast<unsigned>(checker.get_errors()),
+      static_cast<unsigned>(checker.get_drops()));
+}
@@ -8,7 +8,6 @@
 
 #include "main.h"
 #include "utils.h"
-#include "uart.h"
 
 TIM_HandleTypeDef htim7;
 
@@ -131,6 +130,5 @@ void HAL_ResumeTick(void) {
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
   if (htim->Instance == TIM7) {
     HAL_IncTick();
-    uart2.on_systick_ISR();
   }
 }
@@ -10,6 +10,7 @@
 #include "utils.h"
 #include "pin_api.h"
 #include "os_tasks.h"
+#include "trace.h"
 
 /**
  * @brief Called by HAL in HAL_I2C_Init()
@@ -46,6 +47,7 @@ void I2C::init_peripheral() {
 void I2C::init_os() {
   mutex_ = xSemaphoreCreateMutex();
   tasks::check_rtos_create(mutex_, "I2CMutex");
+  trace::name_queue(mutex_, trace::Queue::kI2cMutex);
 }
 
 static constexpr uint32_t timeout = 1000;
@@ -0,0 +1,50 @@
+/**
+ * @file latency.cpp
+ * @brief Latency histogram reports
+ *
+ */
+
+#include "latency.h"
+
+#include "uart.h"
+
+const char* latency::stage_name(Stage stage) {
+  switch (stage) {
+    case Stage::kQueue:
+      return "queue";
+    case Stage::kWait:
+      return "wait";
+    case Stage::kRun:
+      return "run";
+    case Stage::kReply:
+      return "reply";
+    default:
+      return "?";
+  }
+}
+
+/**
+ * @brief Converts \p cycles to us
+ *
+ */
+static unsigned to_us(uint32_t cycles) {
+  return static_cast<unsigned>(cycles / (SystemCoreClock / 1000000));
+}
+
+void latency::report(const char* name, const Histogram& hist, bool buckets) {
+  const uint32_t total = hist.count();
+  if (total == 0) return;
+  // two lines, one would be longer than Uart::kMaxPrintfLen with a 10 digit count and 8 digit durations
+  uart2.printf("%s n:%lu max:%u us", name, static_cast<unsigned long>(total), to_us(hist.max()));
+  uart2.printf("  p50:%u p90:%u p99:%u us", to_us(hist.percentile(50)), to_us(hist.percentile(90)),
+               to_us(hist.percentile(99)));
+  if (!buckets) return;
+  for (size_t i = 0; i < Histogram::kBuckets; ++i) {
+    if (hist.bucket(i) == 0) continue;
+    if (i == Histogram::kBuckets - 1) {
+      uart2.printf("  >=%u us: %u", to_us(Histogram::upper_bound(i - 1)), static_cast<unsigned>(hist.bucket(i)));
+    } else {
+      uart2.printf("  <%u us: %u", to_us(Histogram::upper_bound(i)), static_cast<unsigned>(hist.bucket(i)));
+    }
+  }
+}
@@ -14,6 +14,8 @@
 #include "i2c.h"
 #include "SSD1306/SSD1306.h"
 #include "hw_init.h"
+#include "crc16.h"
+#include "latency.h"
 
 #include "DS3231/DS3231.h"
 #include "GFX.h"
@@ -31,6 +33,8 @@ int main() {
   pins::A1.init();
   pins::A0.init();
 
+  crc16::init();
+  latency::init();
   uart2.init_peripherals();
   adc1.init_adc();
   i2c.init_peripheral();
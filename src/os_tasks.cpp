@@ -2,6 +2,8 @@
 
 #include "utils.h"
 #include "uart.h"
+#include "log.h"
+#include "cpu_stats.h"
 #include "SSD1306/SSD1306.h"
 #include "DS3231/DS3231.h"
 
@@ -21,9 +23,10 @@ void tasks::check_rtos_create(void* t, const char* fmt) {
 
 osThreadId_t tasks::monitor_task_handle; /*!< handle for monitor task */
 /**
- * @brief Memory consumption monitoring
+ * @brief Memory consumption and CPU load monitoring
  *
- * Monitors stack of all running tasks and heap memory
+ * Samples the run time stats of all tasks every second, see cpu_stats. Monitors stack of all running tasks and heap
+ * memory every kMemoryPeriod samples.
  * @param arg nothing
  */
 void tasks::monitor_task(void* arg) {
@@ -33,22 +36,25 @@ void tasks::monitor_task(void* arg) {
   auto statuses = static_cast<TaskStatus_t*>(pvPortMalloc(num_of_tasks * sizeof(TaskStatus_t)));
 
   constexpr size_t memory_low_th{ 10 };
-  while (1) {
-    if (auto n = uxTaskGetSystemState(statuses, num_of_tasks, NULL)) {
-      for (unsigned int i = 0; i < n; ++i) {
+  constexpr uint32_t kMemoryPeriod{ 10 };  // samples between memory checks
+  for (uint32_t round = 0;; ++round) {
+    uint32_t total_time{ 0 };
+    if (auto n = uxTaskGetSystemState(statuses, num_of_tasks, &total_time)) {
+      cpu_stats::sample(statuses, n, total_time);
+      for (unsigned int i = 0; i < n && round % kMemoryPeriod == 0; ++i) {
         if (statuses[i].usStackHighWaterMark < memory_low_th) {
           uart2.printf("MEM:%s:%d", statuses[i].pcTaskName, statuses[i].usStackHighWaterMark);
         }
       }
     } else {
-      uart2.printf("Couldn't get system state");
+      LOG("Couldn't get system state");
     }
 
-    if (xPortGetFreeHeapSize() < memory_low_th) {
-      uart2.printf("HEAP:%d", static_cast<int>(xPortGetFreeHeapSize()));
+    if (round % kMemoryPeriod == 0 && xPortGetFreeHeapSize() < memory_low_th) {
+      LOG("HEAP:%d", static_cast<int>(xPortGetFreeHeapSize()));
     }
 
-    osDelay(pdMS_TO_TICKS(10000));
+    osDelay(pdMS_TO_TICKS(1000));
   }
 }
 
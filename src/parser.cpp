@@ -1,59 +1,359 @@
 #include "parser.h"
-#include "main.h"
+
 #include <cstring>
-#include <algorithm>
 
-void Parser::set_string(const char* str) {
-  str_ = str;
-  str_sz_ = strlen(str);
+/**
+ * @brief Powers of 10, which are exact in float too
+ *
+ */
+static constexpr int32_t kPow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+static constexpr int kMaxExponent = 9;  //!< Largest power in kPow10
+
+static constexpr bool is_digit(char c) {
+  return c >= '0' && c <= '9';
 }
 
-void Parser::reset() {
-  str_ = nullptr;
-  str_sz_ = 0;
+static constexpr bool is_hex_digit(char c) {
+  return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
 }
 
-char Parser::get_prefix() const {
-  if (has_string()) {
-    return str_[get_first_not_whitespace()];
+inline bool Parser::read_number(const char*& str, number_t& num) {
+  const char* ptr = str;
+  const bool negative = *ptr == '-';
+  if (negative || *ptr == '+') ++ptr;
+  const char* const first = ptr;
+
+  // fast path for integers, which can't overflow
+  uint32_t mag{ 0 };
+  for (; is_digit(*ptr) && mag < INT32_MAX / 10; ++ptr) {
+    mag = mag * 10 + (*ptr - '0');
+  }
+  if (is_digit(*ptr) || *ptr == '.') {
+    ptr = read_number_tail(ptr, mag, ptr != first, negative, num);
+    if (ptr == nullptr) return false;
+  } else if (ptr == first) {
+    return false;
   } else {
-    return 0;
+    num.mantissa = static_cast<int32_t>(negative ? 0u - mag : mag);
+    num.exponent = 0;
   }
+  str = ptr;
+  return true;
 }
 
-uint16_t Parser::get_number() const {
-  if (!has_string()) return 0;
+const char* Parser::read_number_tail(const char* ptr, uint32_t mag, bool digits, bool negative, number_t& num) {
+  // magnitude up to INT32_MAX, or up to -INT32_MIN when negative
+  const uint32_t max_mag = INT32_MAX + static_cast<uint32_t>(negative);
+  const uint32_t last_digit = max_mag % 10;
+  const auto fits = [last_digit](uint32_t mag, uint32_t digit) {
+    return mag < INT32_MAX / 10 || (mag == INT32_MAX / 10 && digit <= last_digit);
+  };
+
+  int exponent{ 0 };
+  for (; is_digit(*ptr); ++ptr) {
+    if (fits(mag, *ptr - '0')) {
+      mag = mag * 10 + (*ptr - '0');
+    } else if (exponent < kMaxExponent) {
+      // too many integer digits, keep the magnitude rounded, so it saturates in to_int()
+      if (exponent == 0 && *ptr >= '5' && mag < max_mag) ++mag;
+      ++exponent;
+    }
+  }
+  if (*ptr == '.') {
+    for (++ptr; is_digit(*ptr); ++ptr, digits = true) {
+      if (exponent <= 0 && exponent > -kMaxExponent && fits(mag, *ptr - '0')) {
+        mag = mag * 10 + (*ptr - '0');
+        --exponent;
+      }
+    }
+  }
+  if (!digits) return nullptr;
 
-  int start = get_first_not_whitespace() + 1;
-  return atoi(str_ + start);
+  num.mantissa = static_cast<int32_t>(negative ? 0u - mag : mag);
+  num.exponent = exponent;
+  return ptr;
 }
 
-bool Parser::get_parameter(char param, int16_t& dest, int16_t def) const {
-  dest = def;
-  if (!has_string()) return false;
-  const auto end = str_ + str_sz_;  // create crude end iterator
-  const auto place = std::find(str_, end, param);
-  if (place == end) return false;
+const char* Parser::set_string(const char* str) {
+  reset();
+
+  while (*str == ' ' || *str == '\n' || *str == '\r') ++str;
+  if (*str == ';') return str + 1;
+  if (*str == '\0') return nullptr;
+  prefix_ = *str++;
+
+  number_t num{ 0, 0 };
+  if (read_number(str, num)) {
+    const int32_t number = num.exponent == 0 ? num.mantissa : to_int(num, 0, false);
+    number_ = number < 0 ? 0 : (number > UINT16_MAX ? UINT16_MAX : number);
+  }
+
+  // one pass over the parameters, anything else than a letter is skipped
+  while (*str && *str != ';') {
+    const char param = *str++;
+    const uint32_t bit = letter_bit(param);
+    if (!bit) continue;
+    const bool store = !(present_ & bit);
+    present_ |= bit;
+
+    const char* const value = str;
+    if (*str == '"') {
+      const uint8_t offset = read_string(str);
+      if (store) {
+        has_string_ |= bit;
+        string_offsets_[param - 'A'] = offset;
+      }
+    } else if (*str == '$') {
+      read_array(str, param, store);
+    } else if (read_number(str, num)) {
+      if (*str == ',') {
+        str = value;
+        read_array(str, param, store);
+      } else if (store) {
+        has_value_ |= bit;
+        mantissas_[param - 'A'] = num.mantissa;
+        exponents_[param - 'A'] = num.exponent;
+      }
+    }
+  }
+  return *str == ';' ? str + 1 : nullptr;
+}
+
+bool Parser::set_binary(const uint8_t* data, size_t len) {
+  reset();
+  const auto end = data + len;
+  if (len < 2) return false;
+
+  uint32_t val{ 0 };
+  auto ptr = read_varint(data + 1, end, val);
+  if (ptr == nullptr || val > UINT16_MAX) return false;
+  number_ = val;
+
+  while (ptr != end) {
+    const uint8_t letter = *ptr++;
+    const char param = letter & ~(kNoValue | kBytes);
+    const bool store = add_parameter(param);
+    if (letter & kNoValue) continue;
 
-  if (*(place + 1) == '\0' || *(place + 1) < '0' || *(place + 1) > '9') {
-    // parameter has no value
-    return true;
+    ptr = read_varint(ptr, end, val);
+    if (ptr == nullptr || ((letter & kBytes) && (val > static_cast<size_t>(end - ptr) || val > UINT8_MAX))) {
+      reset();
+      return false;
+    }
+    if (letter & kBytes) {
+      if (store) add_array(param, { ParamArray::Format::kBytes, reinterpret_cast<const char*>(ptr), uint8_t(val) });
+      ptr += val;
+    } else if (store) {
+      // zigzag: 0, -1, 1, -2, ... is encoded as 0, 1, 2, 3, ...
+      has_value_ |= letter_bit(param);
+      mantissas_[param - 'A'] = static_cast<int32_t>((val >> 1) ^ -(val & 1));
+      exponents_[param - 'A'] = 0;
+    }
   }
 
-  dest = atoi(place + 1);  // conver to int
+  prefix_ = data[0];
   return true;
 }
 
-bool Parser::has_string() const {
-  return str_ != nullptr;
+const uint8_t* Parser::read_varint(const uint8_t* ptr, const uint8_t* end, uint32_t& val) {
+  val = 0;
+  for (int shift = 0; shift < 35 && ptr != end; shift += 7) {
+    const uint8_t byte = *ptr++;
+    val |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return ptr;
+  }
+  return nullptr;
+}
+
+void Parser::reset() {
+  prefix_ = 0;
+  number_ = 0;
+  present_ = has_value_ = has_string_ = has_array_ = 0;
+  strings_len_ = arrays_len_ = 0;
+}
+
+bool Parser::add_parameter(char param) {
+  const uint32_t bit = letter_bit(param);
+  if (present_ & bit) return false;
+  present_ |= bit;
+  return bit != 0;
 }
 
-size_t Parser::get_first_not_whitespace() const {
-  if (!has_string()) return 0;
+uint8_t Parser::read_string(const char*& str) {
+  // when strings_ is full, it ends with the terminator of the previous string, use that as an empty string
+  const uint8_t offset = strings_len_ < kMaxStringLen ? strings_len_ : kMaxStringLen - 1;
+  for (++str; *str && *str != '"'; ++str) {
+    if (strings_len_ < kMaxStringLen - 1) {
+      strings_[strings_len_++] = *str;
+    }
+  }
+  if (*str == '"') ++str;
+  if (strings_len_ < kMaxStringLen) {
+    strings_[strings_len_++] = '\0';
+  }
+  return offset;
+}
 
-  int ind = 0;
-  while (str_[ind] != '\0' && (str_[ind] == ' ' || str_[ind] == '\n' || str_[ind] == '\r')) {
-    ++ind;
+void Parser::read_array(const char*& str, char param, bool store) {
+  const char* const first = str;
+  size_t count{ 0 };
+  bool valid{ true };
+  if (*str == '$') {
+    for (++str; is_hex_digit(*str); ++str) ++count;
+    valid = count % 2 == 0;
+    count /= 2;
+  } else {
+    // integers only, a ',' without a number after it ends the array, "1." is not an integer either
+    number_t num{ 0, 0 };
+    while (read_number(str, num)) {
+      valid = valid && num.exponent == 0 && is_digit(str[-1]);
+      ++count;
+      if (*str != ',') break;
+      ++str;
+    }
   }
-  return ind;
+  if (!store || !valid || count > UINT8_MAX) return;
+  const bool hex = *first == '$';
+  add_array(param, { hex ? ParamArray::Format::kHex : ParamArray::Format::kDecimal, hex ? first + 1 : first,
+                     static_cast<uint8_t>(count) });
+}
+
+void Parser::add_array(char param, const ParamArray& value) {
+  if (arrays_len_ == kMaxArrays) return;
+  has_array_ |= letter_bit(param);
+  array_letters_[arrays_len_] = param;
+  arrays_[arrays_len_++] = value;
+}
+
+int32_t Parser::to_int(const number_t& num, int shift, bool round) {
+  const int exponent = num.exponent + shift;
+  if (exponent >= 0) {
+    // saturating multiply
+    const int64_t val = static_cast<int64_t>(num.mantissa) * kPow10[exponent > kMaxExponent ? kMaxExponent : exponent];
+    if (val > INT32_MAX || (exponent > kMaxExponent && num.mantissa > 0)) return INT32_MAX;
+    if (val < INT32_MIN || (exponent > kMaxExponent && num.mantissa < 0)) return INT32_MIN;
+    return static_cast<int32_t>(val);
+  }
+  if (exponent < -kMaxExponent) return 0;
+  const int32_t div = kPow10[-exponent];
+  int32_t val = num.mantissa / div;
+  if (round) {
+    const int32_t rem = num.mantissa % div;
+    // half away from zero
+    if (rem >= (div + 1) / 2) ++val;
+    if (rem <= -(div + 1) / 2) --val;
+  }
+  return val;
+}
+
+bool Parser::find_number(char param, number_t& num) const {
+  if (!(has_value_ & letter_bit(param))) return false;
+  num.mantissa = mantissas_[param - 'A'];
+  num.exponent = exponents_[param - 'A'];
+  return true;
+}
+
+bool Parser::get_parameter(char param, float& dest, float def) const {
+  number_t num;
+  dest = def;
+  if (find_number(param, num)) {
+    // both are exact in float up to 7 digits, so one rounding happens
+    const float pow = static_cast<float>(kPow10[num.exponent < 0 ? -num.exponent : num.exponent]);
+    const float mantissa = static_cast<float>(num.mantissa);
+    dest = num.exponent < 0 ? mantissa / pow : mantissa * pow;
+  }
+  return present_ & letter_bit(param);
+}
+
+bool Parser::get_fixed(char param, int32_t& dest, uint8_t decimals, int32_t def) const {
+  number_t num;
+  dest = find_number(param, num) ? to_int(num, decimals, true) : def;
+  return present_ & letter_bit(param);
+}
+
+bool Parser::get_string(char param, const char*& dest, const char* def) const {
+  dest = (has_string_ & letter_bit(param)) ? &strings_[string_offsets_[param - 'A']] : def;
+  return present_ & letter_bit(param);
+}
+
+bool Parser::get_array(char param, ParamArray& dest) const {
+  dest = {};
+  if (has_array_ & letter_bit(param)) {
+    for (size_t i = 0; i < arrays_len_; ++i) {
+      if (array_letters_[i] == param) dest = arrays_[i];
+    }
+  }
+  return present_ & letter_bit(param);
+}
+
+bool Parser::validate(const ParamSchema& schema, ParamError& error) {
+  using Kind = ParamError::Kind;
+  const auto fail = [&error](Kind kind, char letter, const ParamSpec* spec) {
+    error = { kind, letter, spec };
+    return false;
+  };
+  error = {};
+
+  const uint32_t unknown = present_ & ~schema.allowed;
+  if (unknown) {
+    char letter = 'A';
+    while (!(unknown & letter_bit(letter))) ++letter;
+    return fail(Kind::kUnknown, letter, nullptr);
+  }
+  // nothing to check, and no defaults to set
+  if (!((present_ | schema.required | schema.defaults) & schema.allowed)) return true;
+
+  for (size_t n = 0; n < schema.count; ++n) {
+    const ParamSpec& spec = schema.params[n];
+    const uint32_t bit = letter_bit(spec.letter);
+    const size_t i = spec.letter - 'A';
+
+    if (!(present_ & bit)) {
+      if (spec.is_required) return fail(Kind::kMissing, spec.letter, &spec);
+      if (spec.has_default) {
+        has_value_ |= bit;
+        has_string_ &= ~bit;
+        mantissas_[i] = spec.def;
+        exponents_[i] = -static_cast<int8_t>(spec.decimals);
+      }
+      continue;
+    }
+
+    int32_t val{ 0 };
+    switch (spec.type) {
+      case ParamSpec::Type::kFlag:
+        continue;
+
+      case ParamSpec::Type::kInteger:
+        if (!(has_value_ & bit)) return fail(Kind::kValue, spec.letter, &spec);
+        // a fraction, which isn't 0
+        if (exponents_[i] < 0 && mantissas_[i] % kPow10[-exponents_[i]] != 0) {
+          return fail(Kind::kValue, spec.letter, &spec);
+        }
+        val = to_int({ mantissas_[i], exponents_[i] }, 0, false);
+        break;
+
+      case ParamSpec::Type::kFixed:
+        if (!(has_value_ & bit)) return fail(Kind::kValue, spec.letter, &spec);
+        val = to_int({ mantissas_[i], exponents_[i] }, spec.decimals, true);
+        break;
+
+      case ParamSpec::Type::kString:
+        if (!(has_string_ & bit)) return fail(Kind::kValue, spec.letter, &spec);
+        val = strlen(&strings_[string_offsets_[i]]);
+        break;
+
+      case ParamSpec::Type::kArray: {
+        if (!(has_array_ & bit)) return fail(Kind::kValue, spec.letter, &spec);
+        ParamArray arr;
+        get_array(spec.letter, arr);
+        bool in_range{ true };
+        arr.for_each([&spec, &in_range](int32_t elem) { in_range = in_range && elem >= spec.min && elem <= spec.max; });
+        if (!in_range) return fail(Kind::kRange, spec.letter, &spec);
+        continue;
+      }
+    }
+    if (val < spec.min || val > spec.max) return fail(Kind::kRange, spec.letter, &spec);
+  }
+  return true;
 }
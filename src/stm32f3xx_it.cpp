@@ -22,6 +22,7 @@
 #include "main.h"
 #include "stm32f3xx_it.h"
 #include "uart.h"
+#include "trace.h"
 
 /******************************************************************************/
 /*           Cortex-M4 Processor Interruption and Exception Handlers          */
@@ -88,7 +89,6 @@ void PendSV_Handler(void) {
 void SysTick_Handler(void) {
   HAL_IncTick();
   HAL_SYSTICK_IRQHandler();
-  uart2.on_systick_ISR();
 }
 
 /******************************************************************************/
@@ -102,27 +102,32 @@ void SysTick_Handler(void) {
  * @brief This function handles DMA1 channel6 global interrupt.
  */
 void DMA1_Channel6_IRQHandler(void) {
+  trace::isr_enter(trace::Irq::kDmaRx);
   HAL_DMA_IRQHandler(uart2.huart_.hdmarx);
-  uart2.on_DMA_ISR();
+  trace::isr_exit(trace::Irq::kDmaRx);
 }
 
 /**
  * @brief This function handles DMA1 channel7 global interrupt.
  */
 void DMA1_Channel7_IRQHandler(void) {
+  trace::isr_enter(trace::Irq::kDmaTx);
   HAL_DMA_IRQHandler(uart2.huart_.hdmatx);
+  trace::isr_exit(trace::Irq::kDmaTx);
 }
 
 /**
  * @brief This function handles USART2 interrupts.
  */
 void USART2_IRQHandler(void) {
-  if (USART2->ISR & USART_ISR_IDLE) {
-    uart2.on_idle_ISR();
-    USART2->ICR |= UART_CLEAR_IDLEF;
+  trace::isr_enter(trace::Irq::kUsart2);
+  if (USART2->ISR & USART_ISR_RTOF) {
+    USART2->ICR = UART_CLEAR_RTOF;
+    uart2.on_rx_event_ISR();
   } else {
     HAL_UART_IRQHandler(&uart2.huart_);
   }
+  trace::isr_exit(trace::Irq::kUsart2);
 }
 
 /**
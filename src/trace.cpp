@@ -0,0 +1,126 @@
+/**
+ * @file trace.cpp
+ * @brief Kernel trace hooks, the recorder of the target and the dump
+ *
+ */
+
+#include "trace.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "uart.h"
+#include "latency.h"
+#include "cpu_stats.h"
+
+#include <cstring>
+#include <iterator>
+
+using trace::Event;
+
+static trace::Recorder<trace::kRecords> recorder; /*!< The last kernel events*/
+
+/** Names of the queues in the dump, by trace::Queue */
+static constexpr const char* kQueueNames[] = { "none", "rx_semaphore", "i2c_mutex", "worker_queue" };
+static_assert(std::size(kQueueNames) == static_cast<size_t>(trace::Queue::kCount), "Name every queue");
+
+/** Names of the interrupts in the dump, by trace::Irq */
+static constexpr const char* kIrqNames[] = { "DMA1_CH6_rx", "DMA1_CH7_tx", "USART2" };
+static_assert(std::size(kIrqNames) == static_cast<size_t>(trace::Irq::kCount), "Name every interrupt");
+
+/**
+ * @brief Records a switch in, called by traceTASK_SWITCHED_IN() from the scheduler, see FreeRTOSConfig.h
+ *
+ * @param number TCB number of the task, from 1
+ */
+extern "C" void trace_switched_in(uint32_t number) {
+  recorder.add(latency::now(), Event::kSwitchIn, number);
+}
+
+/**
+ * @brief Records a switch out, called by traceTASK_SWITCHED_OUT()
+ *
+ */
+extern "C" void trace_switched_out(uint32_t number) {
+  recorder.add(latency::now(), Event::kSwitchOut, number);
+}
+
+/**
+ * @brief Records a give or send, called by traceQUEUE_SEND() and traceQUEUE_SEND_FROM_ISR()
+ *
+ * @param number queue number, queues with 0 are not traced
+ * @param waiting messages waiting before the give, the count of a semaphore
+ */
+extern "C" void trace_queue_give(uint32_t number, uint32_t waiting) {
+  if (number) recorder.add(latency::now(), Event::kGive, number, waiting);
+}
+
+/**
+ * @brief Records a take or receive, called by traceQUEUE_RECEIVE() and traceQUEUE_RECEIVE_FROM_ISR()
+ *
+ * @see trace_queue_give()
+ */
+extern "C" void trace_queue_take(uint32_t number, uint32_t waiting) {
+  if (number) recorder.add(latency::now(), Event::kTake, number, waiting);
+}
+
+/**
+ * @brief Records that the running task blocks on a take, called by traceBLOCKING_ON_QUEUE_RECEIVE()
+ *
+ * @see trace_queue_give()
+ */
+extern "C" void trace_queue_block(uint32_t number, uint32_t waiting) {
+  if (number) recorder.add(latency::now(), Event::kBlock, number, waiting);
+}
+
+void trace::name_queue(void* handle, Queue queue) {
+  vQueueSetQueueNumber(static_cast<QueueHandle_t>(handle), static_cast<UBaseType_t>(queue));
+}
+
+void trace::isr_enter(Irq irq) {
+  recorder.add(latency::now(), Event::kIsrEnter, static_cast<uint8_t>(irq));
+}
+
+void trace::isr_exit(Irq irq) {
+  recorder.add(latency::now(), Event::kIsrExit, static_cast<uint8_t>(irq));
+}
+
+void trace::stop() {
+  recorder.stop();
+}
+
+void trace::restart() {
+  recorder.stop();
+  recorder.clear();
+  recorder.start();
+}
+
+size_t trace::dump() {
+  constexpr size_t kChunk = Uart::kMaxRecordData / sizeof(Record);
+  const size_t count = recorder.size();
+  uart2.printf("TRACE hz:%lu n:%u lost:%lu", static_cast<unsigned long>(SystemCoreClock), static_cast<unsigned>(count),
+               static_cast<unsigned long>(recorder.total() - count));
+  for (uint32_t number = 1; number <= cpu_stats::kMaxTasks; ++number) {
+    const char* name = cpu_stats::task_name(number);
+    if (name) uart2.printf("TASK %lu %s", static_cast<unsigned long>(number), name);
+  }
+  for (size_t i = 1; i < std::size(kQueueNames); ++i) {
+    uart2.printf("QUEUE %u %s", static_cast<unsigned>(i), kQueueNames[i]);
+  }
+  for (size_t i = 0; i < std::size(kIrqNames); ++i) {
+    uart2.printf("IRQ %u %s", static_cast<unsigned>(i), kIrqNames[i]);
+  }
+
+  // the ring wraps around, copy the records in order, chunk by chunk. Not on the stack, send_record() and printf
+  // are deep already, only gcode_task dumps
+  static uint8_t chunk[kChunk * sizeof(Record)];
+  size_t sent{ 0 };
+  for (size_t first = 0; first < count; first += kChunk) {
+    const size_t n = count - first < kChunk ? count - first : kChunk;
+    for (size_t i = 0; i < n; ++i) {
+      memcpy(chunk + i * sizeof(Record), &recorder[first + i], sizeof(Record));
+    }
+    if (uart2.send_record(Uart::kTraceMarker, chunk, n * sizeof(Record))) sent += n;
+  }
+  uart2.printf("TRACE end sent:%u", static_cast<unsigned>(sent));
+  return sent;
+}
@@ -9,17 +9,9 @@
 #include "semphr.h"
 #include "utils.h"
 #include "os_tasks.h"
-
-// Static members
-const Uart::msg_t Uart::kEmptyMsg{ 0 };
-
-void Uart::uart_transmit_task(void* arg) {
-  while (true) {
-    if (xSemaphoreTake(uart2.tx_semaphore_, portMAX_DELAY)) {
-      uart2.tick();
-    }
-  }
-}
+#include "log.h"
+#include "crc16.h"
+#include "trace.h"
 
 // Member function definitions
 
@@ -29,16 +21,88 @@ Uart::Uart() {
 }
 
 
-void Uart::tick() {
-  while (!tx_buff_.is_empty()) {
-    auto ptr = tx_buff_.get_next_occupied();
-    if (ptr == nullptr) return;
-    transmit("echo: ");
-    if (transmit(reinterpret_cast<uint8_t*>(ptr->data()), strnlen(ptr->data(), kMsgLen))) {
-      transmit("\n");
+void Uart::kick_tx() {
+  // masked, so when tx_busy_ is seen set outside, the DMA is reading the front record, see reserve_tx()
+  const auto mask = taskENTER_CRITICAL_FROM_ISR();
+  // whoever sets the flag owns the TX DMA
+  if (!tx_busy_.exchange(true)) start_next_tx();
+  taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+void Uart::start_next_tx() {
+  while (true) {
+    size_t len{ 0 };
+    const auto ptr = tx_buff_.get_next_occupied(len);
+    if (ptr != nullptr) {
+      if (HAL_DMA_Start_IT(huart_.hdmatx, reinterpret_cast<uint32_t>(ptr),
+                           reinterpret_cast<uint32_t>(&huart_.Instance->TDR), len) == HAL_OK) {
+        return;
+      }
       tx_buff_.pop();
+      continue;
+    }
+    // empty, or the next line is still being written
+    tx_busy_.store(false);
+    // a line pushed before the store above didn't start the DMA, check again. The consumer role is given up, so
+    // only peek, get_next_occupied() is called after taking it back
+    bool idle{ false };
+    if (!tx_buff_.has_pushed() || !tx_busy_.compare_exchange_strong(idle, true)) {
+      return;
+    }
+  }
+}
+
+void Uart::tx_dma_complete_ISR(DMA_HandleTypeDef* hdma) {
+  size_t len{ 0 };
+  if (uart2.tx_probe_ != nullptr && uart2.tx_buff_.get_next_occupied(len) == uart2.tx_probe_) {
+    uart2.tx_probe_sent_ = latency::now();
+    uart2.tx_probe_done_ = true;
+    uart2.tx_probe_ = nullptr;
+  }
+  uart2.tx_buff_.pop();
+  uart2.start_next_tx();
+  portYIELD_FROM_ISR(uart2.notify_tx_waiters_ISR());
+}
+
+bool Uart::notify_tx_waiters_ISR() {
+  BaseType_t woken = pdFALSE;
+  for (auto& waiter : tx_waiters_) {
+    if (const auto task = waiter.exchange(nullptr)) {
+      vTaskNotifyGiveFromISR(task, &woken);
+    }
+  }
+  return woken == pdTRUE;
+}
+
+void Uart::wait_tx_complete(TickType_t timeout) {
+  const auto self = xTaskGetCurrentTaskHandle();
+  for (auto& waiter : tx_waiters_) {
+    TaskHandle_t expected{ nullptr };
+    if (waiter.compare_exchange_strong(expected, self)) {
+      // the DMA may have finished before the registration, or the buffer is held by an unpushed line
+      if (!tx_busy_) {
+        waiter.store(nullptr);
+        vTaskDelay(1);
+        return;
+      }
+      ulTaskNotifyTake(pdTRUE, timeout);
+      // the slot might still hold this task after a timeout
+      expected = self;
+      waiter.compare_exchange_strong(expected, nullptr);
+      return;
     }
   }
+  // more waiters than slots, poll
+  vTaskDelay(1);
+}
+
+void Uart::reset_tx_stats() {
+  for (auto& stats : tx_stats_) {
+    stats.dropped = 0;
+    stats.waits = 0;
+    stats.wait_ticks = 0;
+    stats.max_wait_ticks = 0;
+  }
 }
 
 void Uart::init_peripherals() {
@@ -55,6 +119,128 @@ void Uart::init_peripherals() {
   huart_.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
 
   utils::hal_wrap(HAL_UART_Init(&huart_));
+
+  /** The receiver timeout ends a message, RTOEN is set while the USART is disabled */
+  __HAL_UART_DISABLE(&huart_);
+  SET_BIT(huart_.Instance->CR2, USART_CR2_RTOEN);
+  __HAL_UART_ENABLE(&huart_);
+  set_rx_timeout(rx_timeout_);
+}
+
+void Uart::set_rx_timeout(uint32_t bits) {
+  rx_timeout_ = utils::constrain(bits, 1u, USART_RTOR_RTO);
+  MODIFY_REG(huart_.Instance->RTOR, USART_RTOR_RTO, rx_timeout_);
+}
+
+void Uart::set_line(uint32_t line) {
+  // line and requested line are written together, a line received meanwhile would be checked against a mix of both
+  taskENTER_CRITICAL();
+  rx_checker_.set_line(line);
+  taskEXIT_CRITICAL();
+}
+
+void Uart::on_rx_event_ISR() {
+  const uint32_t event = latency::now();
+  BaseType_t woken = pdFALSE;
+  const size_t write_index = kDmaRxBuffSize - __HAL_DMA_GET_COUNTER(huart_.hdmarx);
+
+  size_t accepted{ 0 };
+
+  const auto on_line = [this, &accepted, event](msg_t line) {
+    const bool full = rx_buff_.is_full();
+    const auto action = binary_ ? rx_checker_.count(full) : rx_checker_.check(line, full);
+    switch (action) {
+      case LineChecker::Action::kResend:
+        LOG_IMPL(true, "Resend: %u", static_cast<unsigned>(rx_checker_.get_resend_line()));
+        return;
+      case LineChecker::Action::kOk:
+        send_ok(true);
+        return;
+      case LineChecker::Action::kDrop:
+        return;
+      default:
+        break;
+    }
+
+    auto ptr = rx_buff_.get_next_free();
+    // the command without the checksum
+    ptr->msg.assign(line);
+    ptr->stamps = { event, latency::now() };
+    rx_buff_.push();
+    rx_pushed_ = rx_pushed_ + 1;
+    ++accepted;
+
+    // the advanced ok tells the last line number, one ok acknowledges the whole burst
+    if (!advanced_ok_ && !rx_buff_.is_full()) {
+      send_ok(true);
+    }
+  };
+  const auto on_realtime = [this, &woken](char c) { return on_realtime_ISR(c, woken); };
+  rx_framer_.process(write_index, on_line, on_realtime);
+
+  if (accepted) {
+    // one wake-up runs all lines of the burst
+    xSemaphoreGiveFromISR(rx_semaphore_, &woken);
+    if (advanced_ok_ && !rx_buff_.is_full()) {
+      send_ok(true);
+    }
+  }
+  portYIELD_FROM_ISR(woken);
+}
+
+bool Uart::on_realtime_ISR(char c, BaseType_t& woken) {
+  switch (static_cast<Realtime>(c)) {
+    case Realtime::kStatus:
+      send_status_ISR();
+      return true;
+    case Realtime::kHold:
+      hold_ = true;
+      return true;
+    case Realtime::kResume:
+      hold_ = false;
+      xSemaphoreGiveFromISR(rx_semaphore_, &woken);
+      return true;
+    case Realtime::kReset:
+      rx_drop_until_ = rx_pushed_;
+      rx_framer_.drop_line();
+      hold_ = false;
+      xSemaphoreGiveFromISR(rx_semaphore_, &woken);
+      LOG_ISR("Reset");
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Appends the decimal digits of \p val to \p ptr
+ *
+ * @return char* end of the digits
+ */
+static char* append_unsigned(char* ptr, uint32_t val) {
+  char digits[10];
+  size_t n{ 0 };
+  do {
+    digits[n++] = static_cast<char>('0' + val % 10);
+    val /= 10;
+  } while (val);
+  while (n) *ptr++ = digits[--n];
+  return ptr;
+}
+
+void Uart::send_status_ISR() {
+  static constexpr char kIdle[] = "<Idle Q", kRun[] = "<Run Q", kHold[] = "<Hold Q";
+  const char* state = hold_ ? kHold : (has_message() ? kRun : kIdle);
+
+  char record[sizeof(kIdle) + 10 + 2 + 10 + 1];
+  const size_t len = strlen(state);
+  memcpy(record, state, len);
+  char* ptr = append_unsigned(record + len, kRxBufferSize - rx_buff_.num_occupied());
+  *ptr++ = ' ';
+  *ptr++ = 'N';
+  ptr = append_unsigned(ptr, rx_checker_.get_line());
+  *ptr++ = '>';
+  send_queue(record, ptr - record, true);
 }
 
 /**
@@ -106,69 +292,42 @@ void HAL_UART_MspInit(UART_HandleTypeDef* uart) {
 }
 
 /**
- * @brief UART receive complete callback, called through DMA handle by HAL
- * Based on code from https://github.com/akospasztor/stm32-dma-uart
+ * @brief UART receive complete callback, called through DMA handle by HAL when the DMA wraps around
+ *
  * @param huart
  */
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart) {
-  uint16_t i, pos, start, length;
-  uint16_t currCNDTR = __HAL_DMA_GET_COUNTER(huart->hdmarx);
-
-  /* Ignore IDLE Timeout when the received characters exactly filled up the DMA buffer and DMA Rx Complete IT is
-   * generated, but there is no new character during timeout */
-  if (uart2.dma_state_.flag && currCNDTR == uart2.kDmaRxBuffSize) {
-    uart2.dma_state_.flag = 0;
-    return;
-  }
-
-  /* Determine start position in DMA buffer based on previous CNDTR value */
-  start = 0;
-
-  if (uart2.dma_state_.flag) {
-    /* Timeout event */
-    /* Determine new data length based on previous DMA_CNDTR value:
-     *  If previous CNDTR is less than DMA buffer size: there is old data in DMA buffer (from previous timeout) that has
-     * to be ignored. If CNDTR == DMA buffer size: entire buffer content is new and has to be processed.
-     */
-    length = uart2.kDmaRxBuffSize - currCNDTR;
-    uart2.dma_state_.flag = 0;
-  } else {
-    /* DMA Rx Complete event */
-    length = uart2.kDmaRxBuffSize;
-  }
-
-  // get pointer to buffer
-  auto ptr = uart2.rx_buff_.get_next_free();
+  uart2.on_rx_event_ISR();
+}
 
-  if (ptr != nullptr) {
-    /* Copy and Process new data */
-    for (i = 0, pos = start; i < length && i < uart2.kMsgLen - 1; ++i, ++pos) {
-      (*ptr)[i] = uart2.dma_rx_buff_[pos];
-    }
-    (*ptr)[i] = '\0';
-    uart2.rx_buff_.push();
+/**
+ * @brief UART receive half complete callback, called through DMA handle by HAL
+ *
+ * @param huart
+ */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart) {
+  uart2.on_rx_event_ISR();
+}
 
-    /** Give rx semaphore */
-    xSemaphoreGiveFromISR(uart2.rx_semaphore_, NULL);
-    if (!uart2.rx_buff_.is_full()) {
-      uart2.printf_isr("ok");
-    }
+void Uart::send_ok(bool from_isr) {
+  if (advanced_ok_) {
+    const unsigned free = kRxBufferSize - rx_buff_.num_occupied();
+    LOG_IMPL(from_isr, "ok Q%u N%u", free, static_cast<unsigned>(rx_checker_.get_line()));
+  } else {
+    LOG_IMPL(from_isr, "ok");
   }
-  /* Fast reset the DMA*/
-  huart->hdmarx->Instance->CCR &= ~DMA_CCR_EN;
-  huart->hdmarx->Instance->CNDTR = uart2.dma_rx_buff_.size();
-  huart->hdmarx->Instance->CCR |= DMA_CCR_EN;
 }
 
 void Uart::begin() {
   /** create sempahores and start tasks*/
-  rx_semaphore_ = xSemaphoreCreateCounting(kRxBufferSize, 0);
+  rx_semaphore_ = xSemaphoreCreateBinary();
   tasks::check_rtos_create(rx_semaphore_, "RX SEM");
-  tx_semaphore_ = xSemaphoreCreateCounting(kTxBufferSize, 0);
-  tasks::check_rtos_create(tx_semaphore_, "TX SEM");
+  trace::name_queue(rx_semaphore_, trace::Queue::kRxSemaphore);
 
-  uart_send_task_handle_ = osThreadNew(Uart::uart_transmit_task, NULL, &kUartSendTaskAttr);
-  tasks::check_rtos_create(uart_send_task_handle_, "TRANSMIT TASK");
+  /** Transmission is driven by the DMA ISR, the UART only has to request data */
+  huart_.hdmatx->XferCpltCallback = Uart::tx_dma_complete_ISR;
+  huart_.hdmatx->XferErrorCallback = Uart::tx_dma_complete_ISR;
+  SET_BIT(huart_.Instance->CR3, USART_CR3_DMAT);
 
   /** Start transmit DMA IRQ*/
   HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 6, 0);
@@ -178,87 +337,219 @@ void Uart::begin() {
   HAL_NVIC_SetPriority(USART2_IRQn, 6, 0);
   HAL_NVIC_EnableIRQ(USART2_IRQn);
 
-  /**Enable USART 2 IDLE interrupt and register callback */
-  SET_BIT(USART2->CR1, USART_CR1_IDLEIE);
+  /** Enable USART 2 receiver timeout interrupt and register callback */
+  SET_BIT(USART2->CR1, USART_CR1_RTOIE);
   utils::hal_wrap(HAL_UART_RegisterCallback(&uart2.huart_, HAL_UART_RX_COMPLETE_CB_ID, HAL_UART_RxCpltCallback));
+  utils::hal_wrap(
+      HAL_UART_RegisterCallback(&uart2.huart_, HAL_UART_RX_HALFCOMPLETE_CB_ID, HAL_UART_RxHalfCpltCallback));
 
-  /** Start receiving */
-  utils::hal_wrap(HAL_UART_Receive_DMA(&huart_, dma_rx_buff_.data(), dma_rx_buff_.size()));
+  /** Start receiving, the DMA runs continuously, rx_framer_ follows it */
+  rx_framer_.reset();
+  utils::hal_wrap(HAL_UART_Receive_DMA(&huart_, rx_framer_.data(), rx_framer_.size()));
 
   /** Enable DMA1_6 interrupt */
   HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 6, 0);
   HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
 }
 
-Uart::msg_t* Uart::get_next_free_or_yield(uint32_t timeout) {
-  bool exit = false;
-  msg_t* ptr{ nullptr };
-  const uint32_t start = HAL_GetTick();
-  do {
-    vPortEnterCritical();
-    ptr = tx_buff_.get_next_free();
-    vPortExitCritical();
-
-    if (ptr == nullptr && HAL_GetTick() - start < timeout) {
-      taskYIELD();
-    } else {
-      exit = true;
-    }
-  } while (!exit);
+uint8_t* Uart::reserve_tx(size_t len, bool from_isr) {
+  uint8_t* ptr = tx_buff_.get_next_free(len);
+  if (ptr) return ptr;
+
+  const auto policy = tx_policy_;
+  auto& stats = tx_stats_[static_cast<size_t>(policy)];
+
+  if (policy == TxPolicy::kDropOldest) {
+    size_t dropped{ 0 };
+    do {
+      // the TX DMA ISR is the other consumer, mask it. Same for the tasks which can kick_tx()
+      const auto mask = taskENTER_CRITICAL_FROM_ISR();
+      dropped = tx_buff_.drop_oldest(len + tx_buff_.header_size_, tx_busy_);
+      taskEXIT_CRITICAL_FROM_ISR(mask);
+      stats.dropped += dropped;
+      // the probed line might be gone, its sample is given up
+      if (dropped && tx_probe_.exchange(nullptr) != nullptr) ++tx_probes_lost_;
+      ptr = tx_buff_.get_next_free(len);
+    } while (!ptr && dropped);
+    if (ptr) return ptr;
+    // the space is freed, when the line in transmission completes
+  }
+
+  if (from_isr || policy == TxPolicy::kDropNewest || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+    ++stats.dropped;
+    return nullptr;
+  }
 
+  ++stats.waits;
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t timeout = pdMS_TO_TICKS(tx_timeout_);
+  TickType_t waited{ 0 };
+  while (!ptr && waited < timeout) {
+    wait_tx_complete(timeout - waited);
+    ptr = tx_buff_.get_next_free(len);
+    waited = xTaskGetTickCount() - start;
+  }
+
+  stats.wait_ticks += waited;
+  uint32_t max = stats.max_wait_ticks;
+  while (waited > max && !stats.max_wait_ticks.compare_exchange_weak(max, waited)) {
+  }
+  if (!ptr) {
+    ++stats.dropped;
+  }
   return ptr;
 }
 
-bool Uart::send_queue(const char* buff, size_t num, bool from_isr) {
-  if (num > (kMsgLen - 1) || num == 0) return false;
+char* Uart::reserve_line(size_t len, bool from_isr) {
+  const size_t line_len = kTxPrefixLen + len + 1;
+  if (line_len > tx_buff_.max_record_len_) return nullptr;
+  uint8_t* ptr = reserve_tx(line_len, from_isr);
+  if (!ptr) {
+    return nullptr;
+  }
+
+  memcpy(ptr, kTxPrefix, kTxPrefixLen);
+  return reinterpret_cast<char*>(ptr + kTxPrefixLen);
+}
 
-  msg_t* buff_ptr{ nullptr };
+void Uart::push_line(char* msg, size_t len) {
+  msg[len] = '\n';
+  auto ptr = reinterpret_cast<uint8_t*>(msg - kTxPrefixLen);
 
-  if (from_isr) {
-    buff_ptr = tx_buff_.get_next_free();
-  } else {
-    buff_ptr = get_next_free_or_yield(5);
+  tx_buff_.push(ptr, kTxPrefixLen + len + 1);
+  kick_tx();
+}
+
+bool Uart::send_queue(const char* buff, size_t num, bool from_isr) {
+  if (num == 0) return false;
+
+  if (binary_) {
+    uint8_t frame[1 + kMaxPrintfLen + 2];
+    num = utils::min(num, kMaxPrintfLen);
+    frame[0] = kTextMarker;
+    memcpy(frame + 1, buff, num);
+    return send_frame(from_isr, frame, 1 + num);
   }
 
-  if (!buff_ptr) {
+  char* msg = reserve_line(num, from_isr);
+  if (!msg) {
     return false;
   }
 
-  (*buff_ptr)[num] = '\0';
-  memcpy(buff_ptr->data(), buff, num);
-  tx_buff_.push();
-  /** Give TX semaphore */
-  if (from_isr) {
-    xSemaphoreGiveFromISR(tx_semaphore_, NULL);
-  } else {
-    xSemaphoreGive(tx_semaphore_);
+  memcpy(msg, buff, num);
+  push_line(msg, num);
+  return true;
+}
+
+
+bool Uart::send_queue_probed(const char* buff, size_t num) {
+  if (num == 0 || binary_ || tx_probe_ != nullptr) {
+    send_queue(buff, num);
+    return false;
   }
+
+  char* msg = reserve_line(num, false);
+  if (!msg) {
+    return false;
+  }
+
+  memcpy(msg, buff, num);
+  tx_probe_done_ = false;
+  tx_probe_ = reinterpret_cast<const uint8_t*>(msg - kTxPrefixLen);
+  push_line(msg, num);
   return true;
 }
 
+bool Uart::get_tx_probe(uint32_t& sent) {
+  if (!tx_probe_done_) return false;
+  sent = tx_probe_sent_;
+  tx_probe_done_ = false;
+  return true;
+}
 
 bool Uart::vprintf(bool from_isr, const char* fmt, va_list args) {
-  msg_t* buff_ptr{ nullptr };
+  if (binary_) {
+    uint8_t frame[1 + kMaxPrintfLen + 2];
+    frame[0] = kTextMarker;
+    const int res = vsnprintf(reinterpret_cast<char*>(frame + 1), kMaxPrintfLen + 1, fmt, args);
+    return send_frame(from_isr, frame, 1 + utils::constrain(res, 0, static_cast<int>(kMaxPrintfLen)));
+  }
 
-  if (from_isr) {
-    buff_ptr = tx_buff_.get_next_free();
-  } else {
-    buff_ptr = get_next_free_or_yield(5);
+  char* msg = reserve_line(kMaxPrintfLen, from_isr);
+  if (!msg) {
+    return false;
   }
 
-  if (!buff_ptr) {
+  // the terminator will be replaced by the newline
+  const int res = vsnprintf(msg, kMaxPrintfLen + 1, fmt, args);
+  const size_t len = utils::constrain(res, 0, static_cast<int>(kMaxPrintfLen));
+
+  push_line(msg, len);
+  return true;
+}
+
+
+bool Uart::log_deferred(bool from_isr, const char* fmt, const uint32_t* args, size_t n) {
+  const size_t len = 4 + n * sizeof(uint32_t);
+  uint8_t frame[4 + kMaxLogArgs * sizeof(uint32_t) + 2];
+  uint8_t* ptr = binary_ ? frame : reserve_tx(len, from_isr);
+  if (!ptr) {
     return false;
   }
 
-  vsnprintf(buff_ptr->data(), buff_ptr->size() - 1, fmt, args);
+  const uint16_t id = fmt - __start_log_fmt;
+  ptr[0] = kLogMarker;
+  ptr[1] = id & 0xFF;
+  ptr[2] = id >> 8;
+  ptr[3] = n;
+  memcpy(ptr + 4, args, n * sizeof(uint32_t));
 
-  tx_buff_.push();
-  /** Give TX semaphore */
-  if (from_isr) {
-    xSemaphoreGiveFromISR(tx_semaphore_, NULL);
-  } else {
-    xSemaphoreGive(tx_semaphore_);
+  if (binary_) {
+    return send_frame(from_isr, frame, len);
+  }
+  tx_buff_.push(ptr, len);
+  kick_tx();
+  return true;
+}
+
+
+bool Uart::send_record(uint8_t marker, const uint8_t* data, size_t len) {
+  if (len > kMaxRecordData) {
+    return false;
+  }
+  uint8_t frame[2 + kMaxRecordData + 2];
+  uint8_t* ptr = binary_ ? frame : reserve_tx(2 + len, false);
+  if (!ptr) {
+    return false;
   }
+
+  ptr[0] = marker;
+  ptr[1] = len;
+  memcpy(ptr + 2, data, len);
+
+  if (binary_) {
+    return send_frame(false, frame, 2 + len);
+  }
+  tx_buff_.push(ptr, 2 + len);
+  kick_tx();
+  return true;
+}
+
+
+bool Uart::send_frame(bool from_isr, uint8_t* frame, size_t len) {
+  const uint16_t crc = crc16::compute(frame, len);
+  frame[len++] = crc & 0xFF;
+  frame[len++] = crc >> 8;
+
+  uint8_t* ptr = reserve_tx(cobs::max_encoded_len(len) + 1, from_isr);
+  if (!ptr) {
+    return false;
+  }
+  const size_t encoded = cobs::encode(frame, len, ptr);
+  ptr[encoded] = 0;
+
+  tx_buff_.push(ptr, encoded + 1);
+  kick_tx();
   return true;
 }
 
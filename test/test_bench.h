@@ -0,0 +1,44 @@
+/**
+ * @file test_bench.h
+ * Cycle counting helpers for benchmarks, which run alongside the tests
+ */
+
+#ifndef TEST_BENCH_H_
+#define TEST_BENCH_H_
+
+#include <stm32f3xx_hal.h>
+#include <stdio.h>
+#include "unity.h"
+
+/**
+ * @brief Enables the DWT cycle counter
+ *
+ */
+static inline void bench_init(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Current value of the cycle counter
+ *
+ */
+static inline uint32_t bench_cycles(void) {
+  return DWT->CYCCNT;
+}
+
+/**
+ * @brief Prints a benchmark result as a test message
+ *
+ * @param name name of the benchmark
+ * @param cycles total cycles measured
+ * @param iterations number of iterations measured
+ */
+static inline void bench_report(const char* name, uint32_t cycles, uint32_t iterations) {
+  char buff[80];
+  snprintf(buff, sizeof(buff), "%s: %lu cycles/iter", name, (unsigned long)(cycles / iterations));
+  TEST_MESSAGE(buff);
+}
+
+#endif
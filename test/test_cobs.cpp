@@ -0,0 +1,96 @@
+/**
+ * @file test_cobs.cpp
+ * COBS and CRC test implementation
+ *
+ */
+
+#include "test_cobs.h"
+#include "../include/cobs.h"
+#include "../include/crc16.h"
+#include "unity.h"
+
+#include <cstring>
+
+/**
+ * @brief Encodes and decodes \p len bytes, checks that there is no 0 in the encoded data
+ *
+ */
+static void round_trip(const uint8_t* data, size_t len) {
+  uint8_t encoded[300], decoded[300];
+  const size_t enc_len = cobs::encode(data, len, encoded);
+  TEST_ASSERT_TRUE_MESSAGE(enc_len <= cobs::max_encoded_len(len), "Encoded length");
+  TEST_ASSERT_NULL_MESSAGE(memchr(encoded, 0, enc_len), "No zero in encoded data");
+
+  size_t dec_len{ 0 };
+  TEST_ASSERT_TRUE(cobs::decode(encoded, enc_len, decoded, dec_len));
+  TEST_ASSERT_EQUAL(len, dec_len);
+  TEST_ASSERT_EQUAL_MEMORY(data, decoded, len);
+
+  // in place
+  TEST_ASSERT_TRUE(cobs::decode(encoded, enc_len, encoded, dec_len));
+  TEST_ASSERT_EQUAL(len, dec_len);
+  TEST_ASSERT_EQUAL_MEMORY(data, encoded, len);
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run COBS tests
+ *
+ */
+void test_cobs() {
+  const uint8_t zero[] = { 0 };
+  uint8_t encoded[8];
+  TEST_ASSERT_EQUAL(2, cobs::encode(zero, 1, encoded));
+  TEST_ASSERT_EQUAL(1, encoded[0]);
+  TEST_ASSERT_EQUAL(1, encoded[1]);
+
+  const uint8_t mixed[] = { 0x11, 0x22, 0x00, 0x33 };
+  TEST_ASSERT_EQUAL(5, cobs::encode(mixed, sizeof(mixed), encoded));
+  const uint8_t expected[] = { 0x03, 0x11, 0x22, 0x02, 0x33 };
+  TEST_ASSERT_EQUAL_MEMORY(expected, encoded, sizeof(expected));
+
+  round_trip(mixed, 0);
+  round_trip(zero, 1);
+  round_trip(mixed, sizeof(mixed));
+
+  // 254 and more non-zero bytes need an extra code byte
+  uint8_t long_data[280];
+  for (size_t i = 0; i < sizeof(long_data); ++i) long_data[i] = i % 255 + 1;
+  round_trip(long_data, 253);
+  round_trip(long_data, 254);
+  round_trip(long_data, 255);
+  round_trip(long_data, sizeof(long_data));
+
+  // invalid frames
+  size_t len{ 0 };
+  const uint8_t has_zero[] = { 0x03, 0x11, 0x00 };
+  TEST_ASSERT_FALSE(cobs::decode(has_zero, sizeof(has_zero), encoded, len));
+  const uint8_t truncated[] = { 0x05, 0x11, 0x22 };
+  TEST_ASSERT_FALSE(cobs::decode(truncated, sizeof(truncated), encoded, len));
+}
+
+/**
+ * @brief Run CRC tests, the peripheral and the software implementation must match
+ *
+ */
+void test_crc16() {
+  crc16::init();
+  const uint8_t check[] = "123456789";
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16::compute_sw(check, 9));
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16::compute(check, 9));
+
+  uint8_t data[64];
+  for (size_t i = 0; i < sizeof(data); ++i) data[i] = i * 37 + 5;
+  for (size_t len = 0; len <= sizeof(data); len += 7) {
+    TEST_ASSERT_EQUAL_HEX16(crc16::compute_sw(data, len), crc16::compute(data, len));
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "../src/crc16.cpp"
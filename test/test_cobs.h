@@ -0,0 +1,20 @@
+/**
+ * @file test_cobs.h
+ * COBS and CRC test header file
+ */
+
+#ifndef TEST_COBS_H_
+#define TEST_COBS_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_cobs();
+void test_crc16();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
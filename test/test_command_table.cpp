@@ -0,0 +1,97 @@
+/**
+ * @file test_command_table.cpp
+ * Command table test implementation
+ *
+ */
+
+#include "test_command_table.h"
+#include "../include/command_table.h"
+#include "unity.h"
+
+/**
+ * @brief Remembers the last called handler
+ *
+ */
+struct Handlers {
+  int last{ -1 };
+  void g0() {
+    last = 0;
+  }
+  void g28() {
+    last = 28;
+  }
+  void m3() {
+    last = 103;
+  }
+  void m5() {
+    last = 105;
+  }
+};
+
+using Cmd = Command<Handlers>;
+
+static constexpr ParamSpec kG28Params[] = { ParamSpec::flag('X'), ParamSpec::flag('Y') };
+
+static constexpr Cmd kCommands[] = {
+  Cmd::of<&Handlers::g28>('G', 28, &kSchema<kG28Params>),
+  Cmd::of<&Handlers::m5>('M', 5),
+  Cmd::of<&Handlers::g0>('G', 0),
+  Cmd::of<&Handlers::m3>('M', 3),
+};
+
+static constexpr CommandTable<Handlers, command_table_size(kCommands)> kTable(kCommands);
+
+// G0 to G28 and M3 to M5
+static_assert(command_table_size(kCommands) == 29 + 3, "Dense per letter");
+static_assert(kTable.is_valid(), "Unique commands");
+
+static constexpr Cmd kDuplicates[] = { Cmd::of<&Handlers::g0>('G', 0), Cmd::of<&Handlers::g28>('G', 0) };
+static_assert(!CommandTable<Handlers, command_table_size(kDuplicates)>(kDuplicates).is_valid(), "Duplicate");
+static constexpr Cmd kBadLetter[] = { Cmd::of<&Handlers::g0>('g', 0) };
+static_assert(!CommandTable<Handlers, command_table_size(kBadLetter)>(kBadLetter).is_valid(), "Lower case");
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void test_command_table() {
+  Handlers handlers;
+
+  TEST_ASSERT_TRUE(kTable.call(handlers, 'G', 0));
+  TEST_ASSERT_EQUAL(0, handlers.last);
+  TEST_ASSERT_TRUE(kTable.call(handlers, 'G', 28));
+  TEST_ASSERT_EQUAL(28, handlers.last);
+  TEST_ASSERT_TRUE(kTable.call(handlers, 'M', 3));
+  TEST_ASSERT_EQUAL(103, handlers.last);
+  TEST_ASSERT_TRUE(kTable.call(handlers, 'M', 5));
+  TEST_ASSERT_EQUAL(105, handlers.last);
+
+  // the schema comes with the command
+  TEST_ASSERT_TRUE(kTable.find('G', 28)->schema == &kSchema<kG28Params>);
+  TEST_ASSERT_NULL(kTable.find('G', 0)->schema);
+  TEST_ASSERT_NULL(kTable.find('G', 27));
+
+  // indices for per command data, G first, then M
+  static_assert(kTable.size() == 32, "Size of the table");
+  TEST_ASSERT_EQUAL(0, kTable.index(kTable.find('G', 0)));
+  TEST_ASSERT_EQUAL(28, kTable.index(kTable.find('G', 28)));
+  TEST_ASSERT_EQUAL(31, kTable.index(kTable.find('M', 5)));
+
+  // gaps, and out of range on both sides
+  handlers.last = -1;
+  TEST_ASSERT_FALSE(kTable.call(handlers, 'G', 1));
+  TEST_ASSERT_FALSE(kTable.call(handlers, 'G', 29));
+  TEST_ASSERT_FALSE(kTable.call(handlers, 'M', 4));
+  TEST_ASSERT_FALSE(kTable.call(handlers, 'M', 0));
+  TEST_ASSERT_FALSE(kTable.call(handlers, 'M', UINT16_MAX));
+  TEST_ASSERT_FALSE_MESSAGE(kTable.call(handlers, 'A', 0), "Unused letter");
+  TEST_ASSERT_FALSE(kTable.call(handlers, 'Z', 0));
+  TEST_ASSERT_FALSE(kTable.call(handlers, '@', 0));
+  TEST_ASSERT_FALSE(kTable.call(handlers, '\0', 0));
+  TEST_ASSERT_FALSE(kTable.call(handlers, '[', 0));
+  TEST_ASSERT_EQUAL_MESSAGE(-1, handlers.last, "Nothing was called");
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+/**
+ * @file test_command_table.h
+ * Command table test header file
+ */
+
+#ifndef TEST_COMMAND_TABLE_H_
+#define TEST_COMMAND_TABLE_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_command_table();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file test_cpu_stats.cpp
+ * CPU load window test implementation
+ *
+ */
+
+#include "test_cpu_stats.h"
+#include "../include/cpu_stats.h"
+#include "unity.h"
+
+using cpu_stats::Load;
+using cpu_stats::Snapshot;
+
+static_assert(cpu_stats::permille(0, 0) == 0, "Empty window is 0");
+static_assert(cpu_stats::permille(1, 3) == 333, "Rounded to 0.1 %");
+static_assert(cpu_stats::permille(2, 3) == 667, "Rounded to 0.1 %");
+static_assert(cpu_stats::permille(UINT32_MAX, UINT32_MAX) == 1000, "No overflow");
+
+/**
+ * @brief Snapshot at \p time, task 0 ran \p run cycles and was switched in \p switches times
+ *
+ */
+static Snapshot make(uint32_t time, uint32_t run, uint32_t switches) {
+  Snapshot snap;
+  snap.time = time;
+  snap.run[0] = run;
+  snap.switches[0] = switches;
+  snap.run[1] = time - run;
+  return snap;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run CPU load window tests
+ *
+ */
+void test_cpu_stats_window() {
+  cpu_stats::Window<4> window;
+  std::array<Load, cpu_stats::kMaxTasks> loads;
+  TEST_ASSERT_EQUAL(0, window.intervals());
+  TEST_ASSERT_EQUAL(0, window.diff(3, loads));
+
+  window.add(make(1000, 100, 1));
+  TEST_ASSERT_EQUAL(0, window.diff(3, loads));
+  window.add(make(2000, 300, 4));
+  TEST_ASSERT_EQUAL(1, window.intervals());
+  TEST_ASSERT_EQUAL(1000, window.diff(3, loads));
+  TEST_ASSERT_EQUAL(200, loads[0].run);
+  TEST_ASSERT_EQUAL(3, loads[0].switches);
+  TEST_ASSERT_EQUAL(800, loads[1].run);
+  TEST_ASSERT_EQUAL(0, loads[2].run);
+
+  // the oldest snapshots are dropped
+  window.add(make(3000, 600, 5));
+  window.add(make(4000, 1000, 9));
+  window.add(make(5000, 1500, 10));
+  TEST_ASSERT_EQUAL(3, window.intervals());
+  TEST_ASSERT_EQUAL(3000, window.diff(10, loads));
+  TEST_ASSERT_EQUAL(1200, loads[0].run);
+  TEST_ASSERT_EQUAL(6, loads[0].switches);
+  TEST_ASSERT_EQUAL(1000, window.diff(1, loads));
+  TEST_ASSERT_EQUAL(500, loads[0].run);
+  TEST_ASSERT_EQUAL(0, window.diff(0, loads));
+
+  // the cycle counter wraps around
+  window.add(make(UINT32_MAX - 499, UINT32_MAX - 99, 11));
+  window.add(make(500, 100, 12));
+  TEST_ASSERT_EQUAL(1000, window.diff(1, loads));
+  TEST_ASSERT_EQUAL(200, loads[0].run);
+  TEST_ASSERT_EQUAL(800, loads[1].run);
+  TEST_ASSERT_EQUAL(1, loads[0].switches);
+}
+
+#ifdef __cplusplus
+}
+#endif
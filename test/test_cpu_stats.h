@@ -0,0 +1,19 @@
+/**
+ * @file test_cpu_stats.h
+ * CPU load window test header file
+ */
+
+#ifndef TEST_CPU_STATS_H_
+#define TEST_CPU_STATS_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_cpu_stats_window();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file test_hooks.h
+ * Hooks to run test code from interrupts
+ */
+
+#ifndef TEST_HOOKS_H_
+#define TEST_HOOKS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Called from SysTick ISR every ms, when not null
+ *
+ * Used by tests, which need a second execution context, set back to null when done
+ */
+extern void (*volatile test_systick_hook)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * @file test_latency.cpp
+ * Latency histogram test implementation
+ *
+ */
+
+#include "test_latency.h"
+#include "../include/latency.h"
+#include "unity.h"
+
+using latency::Histogram;
+
+static_assert(Histogram::bucket_of(0) == 0, "Zero is in the first bucket");
+static_assert(Histogram::bucket_of(1023) == 0, "First bucket is below 2^kFirstBits");
+static_assert(Histogram::bucket_of(1024) == 1, "Second bucket starts at 2^kFirstBits");
+static_assert(Histogram::bucket_of(2047) == 1, "Buckets are powers of 2");
+static_assert(Histogram::bucket_of(UINT32_MAX) == Histogram::kBuckets - 1, "Last bucket holds the rest");
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run latency histogram tests
+ *
+ */
+void test_latency_histogram() {
+  Histogram hist;
+  TEST_ASSERT_EQUAL(0, hist.count());
+  TEST_ASSERT_EQUAL(0, hist.percentile(50));
+
+  // 90 fast, 9 medium, 1 slow
+  for (int i = 0; i < 90; ++i) hist.add(500);
+  for (int i = 0; i < 9; ++i) hist.add(3000);
+  hist.add(100000);
+  TEST_ASSERT_EQUAL(100, hist.count());
+  TEST_ASSERT_EQUAL(90, hist.bucket(0));
+  TEST_ASSERT_EQUAL(9, hist.bucket(2));
+  TEST_ASSERT_EQUAL(1, hist.bucket(7));
+  TEST_ASSERT_EQUAL(100000, hist.max());
+
+  // upper bounds of the buckets, the last one is the max
+  TEST_ASSERT_EQUAL(1024, hist.percentile(50));
+  TEST_ASSERT_EQUAL(1024, hist.percentile(90));
+  TEST_ASSERT_EQUAL(4096, hist.percentile(99));
+  TEST_ASSERT_EQUAL(100000, hist.percentile(100));
+
+  // a full bucket halves all, the shape is kept
+  for (int i = 0; i < UINT16_MAX - 90; ++i) hist.add(500);
+  TEST_ASSERT_EQUAL(UINT16_MAX, hist.bucket(0));
+  hist.add(500);
+  TEST_ASSERT_EQUAL(UINT16_MAX / 2 + 1, hist.bucket(0));
+  TEST_ASSERT_EQUAL(4, hist.bucket(2));
+  TEST_ASSERT_EQUAL(0, hist.bucket(7));
+
+  hist.reset();
+  TEST_ASSERT_EQUAL(0, hist.count());
+  TEST_ASSERT_EQUAL(0, hist.max());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+/**
+ * @file test_latency.h
+ * Latency histogram test header file
+ */
+
+#ifndef TEST_LATENCY_H_
+#define TEST_LATENCY_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_latency_histogram();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file test_line_checker.cpp
+ * Line checker test implementation
+ *
+ */
+
+#include "test_line_checker.h"
+#include "../include/line_checker.h"
+#include "unity.h"
+
+#include <cstdio>
+#include <cstring>
+
+using Action = LineChecker::Action;
+using Format = LineChecker::Format;
+
+/**
+ * @brief Formats "N<n> <cmd>*<checksum>" into a static buffer
+ *
+ */
+static std::string_view numbered(uint32_t n, const char* cmd) {
+  static char buff[32];
+  int len = snprintf(buff, sizeof(buff), "N%u %s", static_cast<unsigned>(n), cmd);
+  len += snprintf(buff + len, sizeof(buff) - len, "*%u", LineChecker::checksum(buff, len));
+  return std::string_view(buff, len);
+}
+
+/**
+ * @brief Runs check() on a copy of \p line
+ *
+ */
+static Action check(LineChecker& checker, std::string_view line, bool full = false) {
+  return checker.check(line, full);
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run line checker tests
+ *
+ */
+void test_line_checker() {
+  uint32_t number{ 0 };
+  std::string_view cmd;
+
+  // format
+  TEST_ASSERT_EQUAL(3, LineChecker::checksum("N1 A1", 5) ^ LineChecker::checksum("N1 A2", 5));
+  TEST_ASSERT_TRUE(LineChecker::parse("A1 S2", number, cmd) == Format::kPlain);
+  TEST_ASSERT_TRUE(LineChecker::parse("N", number, cmd) == Format::kPlain);
+  TEST_ASSERT_TRUE(LineChecker::parse(numbered(12, "A2 S3"), number, cmd) == Format::kValid);
+  TEST_ASSERT_EQUAL(12, number);
+  TEST_ASSERT_TRUE(cmd == "A2 S3");
+  TEST_ASSERT_TRUE(LineChecker::parse("N12 A2 S3", number, cmd) == Format::kNoChecksum);
+  TEST_ASSERT_TRUE(LineChecker::parse("N12 A2 S3*", number, cmd) == Format::kBadChecksum);
+  TEST_ASSERT_TRUE(LineChecker::parse("N12 A2 S3*1x", number, cmd) == Format::kBadChecksum);
+
+  // a flipped bit is detected
+  char corrupted[32];
+  const auto line = numbered(12, "A2 S3");
+  memcpy(corrupted, line.data(), line.size());
+  corrupted[5] ^= 0x04;
+  TEST_ASSERT_TRUE(LineChecker::parse(std::string_view(corrupted, line.size()), number, cmd) == Format::kBadChecksum);
+
+  // A9 sets the line number
+  LineChecker checker;
+  TEST_ASSERT_TRUE(LineChecker::is_reset("A9"));
+  TEST_ASSERT_TRUE(LineChecker::is_reset("A9 N1"));
+  TEST_ASSERT_FALSE(LineChecker::is_reset("A91"));
+  TEST_ASSERT_TRUE(check(checker, numbered(100, "A9")) == Action::kAccept);
+  TEST_ASSERT_EQUAL(100, checker.get_line());
+  TEST_ASSERT_TRUE(check(checker, numbered(0, "A9")) == Action::kAccept);
+  TEST_ASSERT_EQUAL(0, checker.get_line());
+
+  // the accepted line is the command only
+  auto accepted = numbered(1, "A1");
+  TEST_ASSERT_TRUE(checker.check(accepted, false) == Action::kAccept);
+  TEST_ASSERT_TRUE(accepted == "A1");
+
+  // line 2 is lost, 3 and 4 were in flight, only one request is sent
+  TEST_ASSERT_TRUE(check(checker, numbered(3, "A1")) == Action::kResend);
+  TEST_ASSERT_EQUAL(2, checker.get_resend_line());
+  TEST_ASSERT_TRUE(check(checker, numbered(4, "A1")) == Action::kDrop);
+  TEST_ASSERT_TRUE(check(checker, numbered(2, "A1")) == Action::kAccept);
+  TEST_ASSERT_TRUE(check(checker, numbered(3, "A1")) == Action::kAccept);
+  TEST_ASSERT_EQUAL(1, checker.get_resends());
+
+  // every corrupted line is answered
+  TEST_ASSERT_TRUE(check(checker, "N4 A1*0") == Action::kResend);
+  TEST_ASSERT_TRUE(check(checker, "N4 A1") == Action::kResend);
+  TEST_ASSERT_EQUAL(4, checker.get_resend_line());
+  TEST_ASSERT_EQUAL(2, checker.get_errors());
+
+  // duplicates get an ok, a full queue asks for the line again
+  TEST_ASSERT_TRUE(check(checker, numbered(2, "A1")) == Action::kOk);
+  TEST_ASSERT_TRUE(check(checker, numbered(4, "A1"), true) == Action::kDrop);
+  TEST_ASSERT_TRUE(check(checker, numbered(4, "A1")) == Action::kAccept);
+  TEST_ASSERT_TRUE(check(checker, numbered(5, "A1"), true) == Action::kResend);
+  TEST_ASSERT_EQUAL(5, checker.get_resend_line());
+
+  // in numbered mode, a plain line is the rest of a line split by noise
+  TEST_ASSERT_TRUE(checker.is_numbered());
+  TEST_ASSERT_TRUE(check(checker, "A1 S1*12") == Action::kResend);
+  TEST_ASSERT_EQUAL(4, checker.get_line());
+
+  // a plain A9 ends numbered mode, plain lines are counted
+  TEST_ASSERT_TRUE(check(checker, " A9") == Action::kAccept);
+  TEST_ASSERT_FALSE(checker.is_numbered());
+  TEST_ASSERT_TRUE(check(checker, "A1") == Action::kAccept);
+  TEST_ASSERT_EQUAL(6, checker.get_line());
+  TEST_ASSERT_EQUAL(0, checker.get_drops());
+  TEST_ASSERT_TRUE(check(checker, "A1", true) == Action::kDrop);
+  TEST_ASSERT_EQUAL(1, checker.get_drops());
+  TEST_ASSERT_EQUAL(6, checker.get_line());
+
+  // a full queue drops frames too, duplicates of numbered lines are not lost
+  TEST_ASSERT_TRUE(checker.count(true) == Action::kDrop);
+  TEST_ASSERT_TRUE(checker.count(false) == Action::kAccept);
+  TEST_ASSERT_EQUAL(2, checker.get_drops());
+}
+
+#ifdef __cplusplus
+}
+#endif
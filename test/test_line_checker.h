@@ -0,0 +1,19 @@
+/**
+ * @file test_line_checker.h
+ * Line checker test header file
+ */
+
+#ifndef TEST_LINE_CHECKER_H_
+#define TEST_LINE_CHECKER_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_line_checker();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
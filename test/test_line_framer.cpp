@@ -0,0 +1,235 @@
+/**
+ * @file test_line_framer.cpp
+ * Line framer test implementation
+ *
+ */
+
+#include "test_line_framer.h"
+#include "../include/line_framer.h"
+#include "../include/line_checker.h"
+#include "unity.h"
+
+#include <cstdio>
+#include <cstring>
+
+using framer_t = LineFramer<32, 16>;
+
+/**
+ * @brief Lines found by the last process() call
+ *
+ */
+static struct {
+  std::string_view lines[8];
+  size_t count;
+  char realtime[8];  //!< Real-time bytes, null-terminated
+  size_t realtime_count;
+} found;
+
+/**
+ * @brief Writes \p str into the buffer like the DMA would, and runs the framer
+ *
+ * @param pos DMA write index, updated
+ * @return size_t number of lines found
+ */
+static size_t feed(framer_t& framer, size_t& pos, const char* str) {
+  for (; *str; ++str) {
+    framer.data()[pos] = *str;
+    pos = (pos + 1) % framer.size();
+  }
+  found.count = 0;
+  return framer.process(pos, [](std::string_view line) {
+    if (found.count < 8) found.lines[found.count++] = line;
+  });
+}
+
+/**
+ * @brief Same as feed(), but '?' and '!' are real-time bytes
+ *
+ */
+static size_t feed_realtime(framer_t& framer, size_t& pos, const char* str) {
+  for (; *str; ++str) {
+    framer.data()[pos] = *str;
+    pos = (pos + 1) % framer.size();
+  }
+  found.count = found.realtime_count = 0;
+  const size_t lines = framer.process(
+      pos,
+      [](std::string_view line) {
+        if (found.count < 8) found.lines[found.count++] = line;
+      },
+      [](char c) {
+        if (c != '?' && c != '!') return false;
+        if (found.realtime_count < 7) found.realtime[found.realtime_count++] = c;
+        return true;
+      });
+  found.realtime[found.realtime_count] = '\0';
+  return lines;
+}
+
+/**
+ * @brief Checks the \p i th found line, it must be null-terminated
+ *
+ */
+static void check_line(size_t i, const char* str) {
+  TEST_ASSERT_EQUAL_MESSAGE(strlen(str), found.lines[i].size(), "Line length");
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(str, found.lines[i].data(), "Line content");
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run line framer tests
+ *
+ */
+void test_line_framer() {
+  framer_t framer;
+  framer.reset();
+  size_t pos{ 0 };
+
+  // several lines in one burst, CR, LF and CRLF endings
+  TEST_ASSERT_EQUAL(3, feed(framer, pos, "A1\nA2 S1\r\nA3\r"));
+  check_line(0, "A1");
+  check_line(1, "A2 S1");
+  check_line(2, "A3");
+  // no copy
+  TEST_ASSERT_EQUAL_PTR(framer.data(), found.lines[0].data());
+
+  // a line split between events
+  TEST_ASSERT_EQUAL(0, feed(framer, pos, "A4 "));
+  TEST_ASSERT_EQUAL(1, feed(framer, pos, "S2\n"));
+  check_line(0, "A4 S2");
+
+  // empty lines are skipped
+  TEST_ASSERT_EQUAL(0, feed(framer, pos, "\r\n\n"));
+
+  // pos is 22, this line wraps around the end, and is copied
+  TEST_ASSERT_EQUAL(1, feed(framer, pos, "A5 S1234567\n"));
+  check_line(0, "A5 S1234567");
+  TEST_ASSERT_EQUAL(2, pos);
+
+  // too long lines are dropped, the next line is intact
+  TEST_ASSERT_EQUAL(1, feed(framer, pos, "0123456789ABCDEF\nA6\n"));
+  check_line(0, "A6");
+  TEST_ASSERT_EQUAL(1, framer.get_overlong());
+
+  // back to back bursts, around the end again
+  TEST_ASSERT_EQUAL(2, feed(framer, pos, "A7 S1 P2 T3\nA8\n"));
+  check_line(0, "A7 S1 P2 T3");
+  check_line(1, "A8");
+  TEST_ASSERT_EQUAL(1, feed(framer, pos, "A9 S1 P2 T3 R4\n"));
+  check_line(0, "A9 S1 P2 T3 R4");
+}
+
+/**
+ * @brief Run line framer tests with real-time bytes
+ *
+ */
+void test_line_framer_realtime() {
+  framer_t framer;
+  framer.reset();
+  size_t pos{ 0 };
+
+  // alone, between lines, and inside a line
+  TEST_ASSERT_EQUAL(2, feed_realtime(framer, pos, "?A1\n!A2?\n"));
+  TEST_ASSERT_EQUAL_STRING("?!?", found.realtime);
+  check_line(0, "A1");
+  check_line(1, "A2");
+  TEST_ASSERT_EQUAL(1, feed_realtime(framer, pos, "A3 ?S1!2\n"));
+  TEST_ASSERT_EQUAL_STRING("?!", found.realtime);
+  check_line(0, "A3 S12");
+
+  // inside a line split between events, the line wraps around the end
+  TEST_ASSERT_EQUAL(0, feed_realtime(framer, pos, "A4 S12?"));
+  TEST_ASSERT_EQUAL_STRING("?", found.realtime);
+  TEST_ASSERT_EQUAL(1, feed_realtime(framer, pos, "3?4 P5\n"));
+  check_line(0, "A4 S1234 P5");
+
+  // inside a too long line, the next line is intact
+  TEST_ASSERT_EQUAL(1, feed_realtime(framer, pos, "0123456789AB?CDEF\nA6!\n"));
+  TEST_ASSERT_EQUAL_STRING("?!", found.realtime);
+  check_line(0, "A6");
+  TEST_ASSERT_EQUAL(1, framer.get_overlong());
+
+  // binary frames are not scanned
+  framer.set_binary(true);
+  TEST_ASSERT_EQUAL(0, feed_realtime(framer, pos, "?!"));
+  TEST_ASSERT_EQUAL(0, found.realtime_count);
+  framer.data()[pos] = '\0';
+  pos = (pos + 1) % framer.size();
+  TEST_ASSERT_EQUAL(1, feed_realtime(framer, pos, ""));
+  check_line(0, "?!");
+}
+
+/**
+ * @brief Run line framer tests, lines are queued like in the RX ISR, duplicates arrive while the queue is full
+ *
+ */
+void test_line_framer_queue_full() {
+  framer_t framer;
+  framer.reset();
+  size_t pos{ 0 };
+  LineChecker checker;
+  framer_t::Line queue[2];
+  std::string_view views[2];
+  size_t queued{ 0 };
+
+  // numbered lines, like the host sends them
+  const auto numbered = [](char (&buff)[16], unsigned number) {
+    int len = snprintf(buff, sizeof(buff), "N%u A%u", number, number);
+    len += snprintf(buff + len, sizeof(buff) - len, "*%u\n", LineChecker::checksum(buff, len));
+    return buff;
+  };
+  const auto receive = [&](const char* str) {
+    found.count = 0;
+    for (; *str; ++str) {
+      framer.data()[pos] = *str;
+      pos = (pos + 1) % framer.size();
+    }
+    size_t dropped{ 0 };
+    framer.process(pos, [&](std::string_view line) {
+      const bool full = queued == 2;
+      if (checker.check(line, full) != LineChecker::Action::kAccept) {
+        ++dropped;
+        return;
+      }
+      views[queued] = line;
+      queue[queued++].assign(line);
+    });
+    return dropped;
+  };
+
+  char buff[16];
+  TEST_ASSERT_EQUAL(0, receive(numbered(buff, 1)));
+  TEST_ASSERT_EQUAL(0, receive(numbered(buff, 2)));
+  TEST_ASSERT_EQUAL(2, queued);
+
+  // the host resends line 2 after every timeout, the DMA wraps around several times
+  for (int i = 0; i < 12; ++i) {
+    TEST_ASSERT_EQUAL(1, receive(numbered(buff, 2)));
+  }
+  TEST_ASSERT_EQUAL(2, checker.get_line());
+  TEST_ASSERT_NOT_EQUAL(0, memcmp(views[0].data(), "A1", 2));
+
+  // the copies are intact
+  TEST_ASSERT_EQUAL_STRING("A1", queue[0].view().data());
+  TEST_ASSERT_EQUAL(2, queue[0].view().size());
+  TEST_ASSERT_EQUAL_STRING("A2", queue[1].view().data());
+
+  // a slot is freed, the next line is accepted
+  queue[0] = queue[1];
+  queued = 1;
+  TEST_ASSERT_EQUAL(0, receive(numbered(buff, 3)));
+  TEST_ASSERT_EQUAL_STRING("A2", queue[0].view().data());
+  TEST_ASSERT_EQUAL_STRING("A3", queue[1].view().data());
+
+  // too long for a slot, it is cut
+  framer_t::Line line;
+  line.assign("0123456789ABCDEFGH");
+  TEST_ASSERT_EQUAL_STRING("0123456789ABCDE", line.view().data());
+}
+
+#ifdef __cplusplus
+}
+#endif
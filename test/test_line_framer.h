@@ -0,0 +1,21 @@
+/**
+ * @file test_line_framer.h
+ * Line framer test header file
+ */
+
+#ifndef TEST_LINE_FRAMER_H_
+#define TEST_LINE_FRAMER_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_line_framer();
+void test_line_framer_realtime();
+void test_line_framer_queue_full();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
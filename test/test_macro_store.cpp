@@ -0,0 +1,107 @@
+/**
+ * @file test_macro_store.cpp
+ * Macro store test implementation
+ *
+ */
+
+#include "test_macro_store.h"
+#include "../include/macro_store.h"
+#include "unity.h"
+
+#include <string>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run macro store tests
+ *
+ */
+void test_macro_store() {
+  MacroStore<32> store;
+  std::string_view body, line;
+
+  TEST_ASSERT_FALSE(store.append("A1"));
+  TEST_ASSERT_FALSE(store.begin(""));
+  TEST_ASSERT_FALSE(store.begin("too_long_"));
+
+  // record 2 lines
+  TEST_ASSERT_TRUE(store.begin("on"));
+  TEST_ASSERT_TRUE(store.is_recording());
+  TEST_ASSERT_TRUE(store.append("A1"));
+  TEST_ASSERT_TRUE(store.append("A9"));
+  store.end();
+  TEST_ASSERT_FALSE(store.is_recording());
+  TEST_ASSERT_EQUAL(32 - 5 - 6, store.get_free());
+
+  TEST_ASSERT_TRUE(store.find("on", body));
+  TEST_ASSERT_TRUE(MacroStore<32>::next_line(body, line));
+  TEST_ASSERT_TRUE(line == "A1");
+  TEST_ASSERT_TRUE(MacroStore<32>::next_line(body, line));
+  TEST_ASSERT_TRUE(line == "A9");
+  TEST_ASSERT_FALSE(MacroStore<32>::next_line(body, line));
+  TEST_ASSERT_FALSE(store.find("o", body));
+
+  // a second one after it
+  TEST_ASSERT_TRUE(store.begin("off"));
+  TEST_ASSERT_TRUE(store.append("A0"));
+  store.end();
+  TEST_ASSERT_EQUAL(32 - 11 - 9, store.get_free());
+
+  // recording the first again moves it to the end
+  TEST_ASSERT_TRUE(store.begin("on"));
+  TEST_ASSERT_TRUE(store.append("A1 S5"));
+  TEST_ASSERT_TRUE(store.find("on", body));
+  TEST_ASSERT_TRUE(body == "A1 S5\n");
+  std::string names;
+  store.for_each([&names](std::string_view name, std::string_view) { names.append(name).append(","); });
+  TEST_ASSERT_EQUAL_STRING("off,on,", names.c_str());
+
+  // removing the one before the recorded one keeps recording
+  TEST_ASSERT_TRUE(store.remove("off"));
+  TEST_ASSERT_FALSE(store.remove("off"));
+  TEST_ASSERT_TRUE(store.append("A0"));
+  TEST_ASSERT_TRUE(store.find("on", body));
+  TEST_ASSERT_TRUE(body == "A1 S5\nA0\n");
+
+  // a line, which doesn't fit, removes the partial macro
+  TEST_ASSERT_FALSE(store.append("A2 S1 M2 H3 W4 D5 O6 Y2022"));
+  TEST_ASSERT_FALSE(store.is_recording());
+  TEST_ASSERT_FALSE(store.find("on", body));
+  TEST_ASSERT_EQUAL(32, store.get_free());
+}
+
+/**
+ * @brief Run macro argument substitution tests
+ *
+ */
+void test_macro_expand() {
+  MacroArgs args;
+  args.set('S', 12);
+  args.set('L', 0);
+  args.set('T', -2147483647 - 1);
+  char out[32];
+  char missing{ 'x' };
+
+  TEST_ASSERT_TRUE(expand_macro_line("A1", args, out, sizeof(out), missing));
+  TEST_ASSERT_EQUAL_STRING("A1", out);
+  TEST_ASSERT_TRUE(expand_macro_line("A9 N#S;A4 S#L", args, out, sizeof(out), missing));
+  TEST_ASSERT_EQUAL_STRING("A9 N12;A4 S0", out);
+  TEST_ASSERT_TRUE(expand_macro_line("A5 T#T #", args, out, sizeof(out), missing));
+  TEST_ASSERT_EQUAL_STRING("A5 T-2147483648 #", out);
+
+  TEST_ASSERT_FALSE(expand_macro_line("A6 S#X", args, out, sizeof(out), missing));
+  TEST_ASSERT_EQUAL('X', missing);
+  TEST_ASSERT_FALSE(expand_macro_line("A6 S#s", args, out, sizeof(out), missing));
+  TEST_ASSERT_EQUAL('s', missing);
+
+  // the terminator must fit too
+  TEST_ASSERT_TRUE(expand_macro_line("A6 S#S", args, out, 7, missing));
+  TEST_ASSERT_FALSE(expand_macro_line("A6 S#S", args, out, 6, missing));
+  TEST_ASSERT_EQUAL(0, missing);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+/**
+ * @file test_macro_store.h
+ * Macro store test header file
+ */
+
+#ifndef TEST_MACRO_STORE_H_
+#define TEST_MACRO_STORE_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_macro_store();
+void test_macro_expand();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
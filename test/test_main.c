@@ -9,9 +9,19 @@
 #include <unity.h>
 
 #include "test_ring_buffer.h"
+#include "test_packed_ring_buffer.h"
+#include "test_line_framer.h"
+#include "test_line_checker.h"
 #include "test_parser.h"
+#include "test_command_table.h"
+#include "test_latency.h"
+#include "test_cpu_stats.h"
+#include "test_trace.h"
+#include "test_macro_store.h"
+#include "test_cobs.h"
 #include "test_utils.h"
 #include "test_rtc_i2c.h"
+#include "test_hooks.h"
 
 void setUp(void) {
 }
@@ -24,7 +34,30 @@ int main() {
   HAL_Delay(2000);
   UNITY_BEGIN();
   RUN_TEST(test_ring_buffer);
+  RUN_TEST(test_ring_buffer_capacity);
+  RUN_TEST(test_ring_buffer_spans);
+  RUN_TEST(test_spsc_ring_buffer);
+  RUN_TEST(test_packed_ring_buffer);
+  RUN_TEST(test_packed_ring_buffer_stress);
+  RUN_TEST(bench_packed_ring_buffer);
+  RUN_TEST(test_line_framer);
+  RUN_TEST(test_line_framer_realtime);
+  RUN_TEST(test_line_framer_queue_full);
+  RUN_TEST(test_line_checker);
   RUN_TEST(test_parser);
+  RUN_TEST(test_parser_binary);
+  RUN_TEST(test_parser_types);
+  RUN_TEST(test_parser_schema);
+  RUN_TEST(test_parser_arrays);
+  RUN_TEST(bench_parser);
+  RUN_TEST(test_command_table);
+  RUN_TEST(test_latency_histogram);
+  RUN_TEST(test_cpu_stats_window);
+  RUN_TEST(test_trace_recorder);
+  RUN_TEST(test_macro_store);
+  RUN_TEST(test_macro_expand);
+  RUN_TEST(test_cobs);
+  RUN_TEST(test_crc16);
   RUN_TEST(test_min_max);
   RUN_TEST(test_is_within);
   RUN_TEST(test_point);
@@ -78,6 +111,11 @@ void HAL_MspInit() {
 }
 
 
+void (*volatile test_systick_hook)(void) = 0;
+
 void SysTick_Handler(void) {
   HAL_IncTick();
+  if (test_systick_hook) {
+    test_systick_hook();
+  }
 }
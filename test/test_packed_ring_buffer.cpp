@@ -0,0 +1,306 @@
+/**
+ * @file test_packed_ring_buffer.cpp
+ * Packed ring buffer test implementation
+ *
+ */
+
+#include "test_packed_ring_buffer.h"
+#include "test_bench.h"
+#include "test_hooks.h"
+#include "../include/packed_ring_buffer.h"
+#include "../include/ring_buffer.h"
+#include "unity.h"
+
+#include <cstring>
+
+/**
+ * @brief Writes \p str into \p buff as one record
+ *
+ * @return true on success
+ */
+template <size_t L>
+static bool put(PackedRingBuffer<L>& buff, const char* str) {
+  const size_t len = strlen(str);
+  auto ptr = buff.get_next_free(len);
+  if (!ptr) return false;
+  memcpy(ptr, str, len);
+  buff.push(ptr, len);
+  return true;
+}
+
+/**
+ * @brief Compares the next record with \p str and pops it
+ *
+ */
+template <size_t L>
+static void check_and_pop(PackedRingBuffer<L>& buff, const char* str) {
+  size_t len{ 0 };
+  auto ptr = buff.get_next_occupied(len);
+  TEST_ASSERT_NOT_NULL_MESSAGE(ptr, "Record available");
+  TEST_ASSERT_EQUAL_MESSAGE(strlen(str), len, "Record length");
+  TEST_ASSERT_EQUAL_MEMORY_MESSAGE(str, ptr, len, "Record content");
+  buff.pop();
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run packed ring buffer tests
+ *
+ */
+void test_packed_ring_buffer() {
+  PackedRingBuffer<64> buff;
+  buff.reset();
+  size_t len{ 0 };
+
+  TEST_ASSERT_TRUE_MESSAGE(buff.is_empty(), "Buffer is empty at start");
+  TEST_ASSERT_FALSE(buff.has_pushed());
+  TEST_ASSERT_NULL_MESSAGE(buff.get_next_occupied(len), "Nothing to read at start");
+
+  // records are packed, 3 byte record takes 12 bytes
+  TEST_ASSERT_TRUE(put(buff, "ok\n"));
+  TEST_ASSERT_EQUAL(12, buff.bytes_used());
+  check_and_pop(buff, "ok\n");
+  TEST_ASSERT_TRUE_MESSAGE(buff.is_empty(), "Buffer is empty after pop");
+
+  // fill, 5 records of 12 bytes, the last one skips 4 bytes at the end
+  int n = 0;
+  while (put(buff, "abc")) ++n;
+  TEST_ASSERT_EQUAL_MESSAGE(5, n, "Buffer holds 5 short records");
+  TEST_ASSERT_NULL_MESSAGE(buff.get_next_free(1), "No space when full");
+  for (int i = 0; i < n; ++i) {
+    check_and_pop(buff, "abc");
+  }
+  TEST_ASSERT_TRUE(buff.is_empty());
+
+  // too long is refused
+  TEST_ASSERT_NULL(buff.get_next_free(buff.max_record_len_ + 1));
+
+  // records don't wrap around the end of the buffer
+  buff.reset();
+  TEST_ASSERT_TRUE(put(buff, "012345678901234567890123"));  // 32 bytes
+  TEST_ASSERT_TRUE(put(buff, "0123456789"));                // 20 bytes
+  check_and_pop(buff, "012345678901234567890123");
+  TEST_ASSERT_TRUE(put(buff, "abcdefghijklmnopqrst"));  // 28 bytes, 12 left to end
+  check_and_pop(buff, "0123456789");
+  check_and_pop(buff, "abcdefghijklmnopqrst");
+  TEST_ASSERT_TRUE(buff.is_empty());
+
+  // unused part of the reservation is given back
+  buff.reset();
+  auto ptr = buff.get_next_free(24);
+  TEST_ASSERT_NOT_NULL(ptr);
+  memcpy(ptr, "hi", 2);
+  buff.push(ptr, 2);
+  TEST_ASSERT_EQUAL(12, buff.bytes_used());
+  check_and_pop(buff, "hi");
+
+  // concurrent reservations, consumer waits for the first one
+  buff.reset();
+  auto ptr1 = buff.get_next_free(4);
+  auto ptr2 = buff.get_next_free(4);
+  TEST_ASSERT_FALSE(ptr1 == ptr2);
+  memcpy(ptr2, "2222", 4);
+  buff.push(ptr2, 4);
+  TEST_ASSERT_NULL_MESSAGE(buff.get_next_occupied(len), "First record not pushed yet");
+  TEST_ASSERT_FALSE(buff.has_pushed());
+  memcpy(ptr1, "1111", 4);
+  buff.push(ptr1, 4);
+  TEST_ASSERT_TRUE(buff.has_pushed());
+  check_and_pop(buff, "1111");
+  check_and_pop(buff, "2222");
+
+  // shrinking is not possible, when someone reserved after
+  buff.reset();
+  ptr1 = buff.get_next_free(16);
+  ptr2 = buff.get_next_free(4);
+  memcpy(ptr1, "1", 1);
+  buff.push(ptr1, 1);
+  memcpy(ptr2, "2", 1);
+  buff.push(ptr2, 1);
+  TEST_ASSERT_EQUAL(24 + 12, buff.bytes_used());
+  check_and_pop(buff, "1");
+  check_and_pop(buff, "2");
+
+  // pushing 0 bytes discards the record
+  ptr = buff.get_next_free(4);
+  buff.push(ptr, 0);
+  TEST_ASSERT_NULL(buff.get_next_occupied(len));
+  TEST_ASSERT_TRUE(buff.is_empty());
+
+  // dropping the oldest records, the space is given back right away when nothing is kept in front
+  buff.reset();
+  TEST_ASSERT_TRUE(put(buff, "aaa"));
+  TEST_ASSERT_TRUE(put(buff, "bbb"));
+  TEST_ASSERT_TRUE(put(buff, "ccc"));
+  TEST_ASSERT_TRUE(put(buff, "ddd"));
+  TEST_ASSERT_EQUAL(1, buff.drop_oldest(12, false));
+  TEST_ASSERT_EQUAL(36, buff.bytes_used());
+  // the front record is being transmitted, the one after it is dropped
+  TEST_ASSERT_EQUAL(1, buff.drop_oldest(12, true));
+  TEST_ASSERT_EQUAL(36, buff.bytes_used());
+  check_and_pop(buff, "bbb");
+  check_and_pop(buff, "ddd");
+  TEST_ASSERT_TRUE(buff.is_empty());
+  TEST_ASSERT_EQUAL(0, buff.drop_oldest(12, false));
+
+  // the dropped records wrap around the end of the buffer
+  buff.reset();
+  for (int i = 0; i < 4; ++i) TEST_ASSERT_TRUE(put(buff, "abc"));
+  for (int i = 0; i < 3; ++i) check_and_pop(buff, "abc");
+  TEST_ASSERT_TRUE(put(buff, "eee"));
+  TEST_ASSERT_TRUE(put(buff, "fff"));  // skips the 4 bytes at the end
+  TEST_ASSERT_EQUAL(40, buff.bytes_used());
+  TEST_ASSERT_EQUAL(3, buff.drop_oldest(40, false));
+  TEST_ASSERT_EQUAL(0, buff.bytes_used());
+  TEST_ASSERT_TRUE(buff.is_empty());
+  TEST_ASSERT_TRUE(put(buff, "ggg"));
+  check_and_pop(buff, "ggg");
+  TEST_ASSERT_TRUE(buff.is_empty());
+}
+
+/**
+ * @brief Shared state of the stress test
+ *
+ */
+static struct {
+  PackedRingBuffer<128> buff;
+  volatile uint32_t isr_seq;
+} stress;
+
+/**
+ * @brief Writes a record with producer id and sequence number
+ *
+ * @return true if the record was written
+ */
+static bool stress_put(char id, uint32_t seq) {
+  auto ptr = stress.buff.get_next_free(1 + sizeof(seq));
+  if (!ptr) return false;
+  ptr[0] = id;
+  memcpy(ptr + 1, &seq, sizeof(seq));
+  stress.buff.push(ptr, 1 + sizeof(seq));
+  return true;
+}
+
+/**
+ * @brief Second producer, runs in SysTick ISR
+ *
+ */
+static void stress_isr_producer() {
+  for (int i = 0; i < 3; ++i) {
+    if (stress_put('I', stress.isr_seq)) {
+      stress.isr_seq = stress.isr_seq + 1;
+    }
+  }
+}
+
+/**
+ * @brief Producer in the main loop and in SysTick ISR, consumer in the main loop
+ *
+ * The ISR interrupts the main producer and consumer at random points, records must arrive complete and in order
+ */
+void test_packed_ring_buffer_stress() {
+  stress.buff.reset();
+  stress.isr_seq = 0;
+  uint32_t main_seq{ 0 }, expected_main{ 0 }, expected_isr{ 0 };
+  bool ok = true;
+
+  test_systick_hook = stress_isr_producer;
+  const uint32_t start = HAL_GetTick();
+  while (HAL_GetTick() - start < 500) {
+    if (stress_put('M', main_seq)) {
+      ++main_seq;
+    }
+    size_t len{ 0 };
+    while (auto ptr = stress.buff.get_next_occupied(len)) {
+      uint32_t seq{ 0 };
+      memcpy(&seq, ptr + 1, sizeof(seq));
+      ok &= len == 1 + sizeof(seq);
+      if (ptr[0] == 'M') {
+        ok &= seq == expected_main++;
+      } else if (ptr[0] == 'I') {
+        ok &= seq == expected_isr++;
+      } else {
+        ok = false;
+      }
+      stress.buff.pop();
+    }
+  }
+  test_systick_hook = nullptr;
+
+  TEST_ASSERT_TRUE_MESSAGE(ok, "Records arrived complete and in order");
+  TEST_ASSERT_GREATER_THAN_MESSAGE(100, expected_isr, "ISR producer got through");
+  TEST_ASSERT_GREATER_THAN_MESSAGE(100, expected_main, "Main producer got through");
+}
+
+/**
+ * @brief Compare the packed ring buffer with fixed 30 byte slots, and lock-free with critical sections
+ *
+ */
+void bench_packed_ring_buffer() {
+  constexpr uint32_t iterations = 1000;
+  const char msg[] = "echo: ok\n";
+  constexpr size_t len = sizeof(msg) - 1;
+
+  bench_init();
+
+  RingBuffer<std::array<char, 30>, 5> slots;
+  slots.reset();
+  uint32_t start = bench_cycles();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    auto ptr = slots.get_next_free();
+    memcpy(ptr->data(), msg, len);
+    slots.push();
+    volatile char c = (*slots.get_next_occupied())[0];
+    (void)c;
+    slots.pop();
+  }
+  bench_report("fixed slots push/pop", bench_cycles() - start, iterations);
+
+  PackedRingBuffer<256> packed;
+  packed.reset();
+  size_t out_len{ 0 };
+  start = bench_cycles();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    auto ptr = packed.get_next_free(len);
+    memcpy(ptr, msg, len);
+    packed.push(ptr, len);
+    volatile uint8_t c = packed.get_next_occupied(out_len)[0];
+    (void)c;
+    packed.pop();
+  }
+  bench_report("packed push/pop", bench_cycles() - start, iterations);
+
+  // contention with the SysTick producer, lock-free and with interrupts masked around the reservation
+  stress.buff.reset();
+  test_systick_hook = stress_isr_producer;
+  start = bench_cycles();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    stress_put('M', i);
+    while (stress.buff.get_next_occupied(out_len)) stress.buff.pop();
+  }
+  bench_report("packed contended, lock-free", bench_cycles() - start, iterations);
+
+  start = bench_cycles();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    __disable_irq();
+    stress_put('M', i);
+    __enable_irq();
+    while (stress.buff.get_next_occupied(out_len)) stress.buff.pop();
+  }
+  bench_report("packed contended, critical section", bench_cycles() - start, iterations);
+  test_systick_hook = nullptr;
+
+  // capacity in the same amount of RAM as 5 * 30 byte slots
+  PackedRingBuffer<128> small;
+  small.reset();
+  int n = 0;
+  while (put(small, "echo: ok\n")) ++n;
+  TEST_ASSERT_GREATER_THAN_MESSAGE(5, n, "Packed buffer holds more short messages");
+}
+
+#ifdef __cplusplus
+}
+#endif
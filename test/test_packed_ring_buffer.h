@@ -0,0 +1,21 @@
+/**
+ * @file test_packed_ring_buffer.h
+ * Packed ring buffer test header file
+ */
+
+#ifndef TEST_PACKED_RING_BUFFER_H_
+#define TEST_PACKED_RING_BUFFER_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_packed_ring_buffer();
+void test_packed_ring_buffer_stress();
+void bench_packed_ring_buffer();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
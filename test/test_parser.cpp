@@ -1,7 +1,10 @@
 #include "test_parser.h"
+#include "test_bench.h"
 #include "../include/parser.h"
 #include "unity.h"
 
+#include <cstring>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,9 +32,352 @@ void test_parser() {
   ret = parser.get_parameter('W', d, -1);
   TEST_ASSERT_FALSE(ret);
   TEST_ASSERT_EQUAL(-1, d);
+
+  // the string is parsed once, it can change after set_string()
+  char buff[] = "A2 S-5 M15 S7 X-";
+  parser.set_string(buff);
+  buff[0] = '\0';
+  TEST_ASSERT_EQUAL('A', parser.get_prefix());
+  TEST_ASSERT_EQUAL(2, parser.get_number());
+  TEST_ASSERT_TRUE(parser.get_parameter('S', d));
+  TEST_ASSERT_EQUAL_MESSAGE(-5, d, "Negative value, first of repeated letters");
+  TEST_ASSERT_TRUE(parser.get_parameter('M', d));
+  TEST_ASSERT_EQUAL(15, d);
+  TEST_ASSERT_TRUE(parser.get_parameter('X', d, 3));
+  TEST_ASSERT_EQUAL_MESSAGE(3, d, "Sign without digits is no value");
+  TEST_ASSERT_FALSE_MESSAGE(parser.get_parameter('a', d), "Only A to Z");
+  TEST_ASSERT_FALSE_MESSAGE(parser.get_parameter('A', d), "Prefix is not a parameter");
+
+  // out of range values saturate
+  parser.set_string("A99999 S40000 Q-99999999999");
+  TEST_ASSERT_EQUAL(UINT16_MAX, parser.get_number());
+  TEST_ASSERT_TRUE(parser.get_parameter('S', d));
+  TEST_ASSERT_EQUAL(INT16_MAX, d);
+  TEST_ASSERT_TRUE(parser.get_parameter('Q', d));
+  TEST_ASSERT_EQUAL(INT16_MIN, d);
+
+  // several commands in a line, ';' in a string doesn't split
+  const char* next = parser.set_string("A1 S2;A3 T\"x;y\";; A4");
+  TEST_ASSERT_EQUAL(1, parser.get_number());
+  TEST_ASSERT_TRUE(parser.get_parameter('S', d));
+  TEST_ASSERT_EQUAL(2, d);
+  TEST_ASSERT_NOT_NULL(next);
+  next = parser.set_string(next);
+  TEST_ASSERT_EQUAL(3, parser.get_number());
+  const char* str{ nullptr };
+  TEST_ASSERT_TRUE(parser.get_string('T', str));
+  TEST_ASSERT_EQUAL_STRING("x;y", str);
+  TEST_ASSERT_NOT_NULL(next);
+  next = parser.set_string(next);
+  TEST_ASSERT_FALSE_MESSAGE(parser.has_string(), "Empty command");
+  TEST_ASSERT_NOT_NULL(next);
+  next = parser.set_string(next);
+  TEST_ASSERT_EQUAL(4, parser.get_number());
+  TEST_ASSERT_NULL(next);
+  TEST_ASSERT_NULL(parser.set_string("A5 S1"));
+
+  // empty
+  parser.set_string(" \r\n");
+  TEST_ASSERT_FALSE(parser.has_string());
+  TEST_ASSERT_EQUAL(0, parser.get_prefix());
 }
 
+void test_parser_binary() {
+  Parser parser;
+  // A132 S1 Q-52 C, 132 is 2 bytes as varint, 1 and -52 are 2 and 103 after zigzag
+  const uint8_t cmd[] = { 'A', 0x84, 0x01, 'S', 2, 'Q', 103, 'C' | Parser::kNoValue };
+  TEST_ASSERT_TRUE(parser.set_binary(cmd, sizeof(cmd)));
+
+  TEST_ASSERT_EQUAL('A', parser.get_prefix());
+  TEST_ASSERT_EQUAL(132, parser.get_number());
+  int16_t d{ 0 };
+  TEST_ASSERT_TRUE(parser.get_parameter('S', d, -1));
+  TEST_ASSERT_EQUAL(1, d);
+  TEST_ASSERT_TRUE(parser.get_parameter('Q', d, -1));
+  TEST_ASSERT_EQUAL(-52, d);
+  TEST_ASSERT_TRUE(parser.get_parameter('C', d, -1));
+  TEST_ASSERT_EQUAL(-1, d);
+  TEST_ASSERT_FALSE(parser.get_parameter('W', d, -1));
+
+  // larger values
+  const uint8_t cmd2[] = { 'A', 1, 'S', 0xFE, 0xFF, 0x03, 'Q', 0xFF, 0xFF, 0x03 };
+  TEST_ASSERT_TRUE(parser.set_binary(cmd2, sizeof(cmd2)));
+  TEST_ASSERT_TRUE(parser.get_parameter('S', d));
+  TEST_ASSERT_EQUAL(INT16_MAX, d);
+  TEST_ASSERT_TRUE(parser.get_parameter('Q', d));
+  TEST_ASSERT_EQUAL(INT16_MIN, d);
+
+  // truncated parameter
+  TEST_ASSERT_FALSE(parser.set_binary(cmd2, sizeof(cmd2) - 1));
+  TEST_ASSERT_FALSE(parser.has_string());
+  // too short
+  TEST_ASSERT_FALSE(parser.set_binary(cmd, 2));
+
+  // back to text
+  parser.set_string("A1 S5");
+  TEST_ASSERT_TRUE(parser.get_parameter('S', d));
+  TEST_ASSERT_EQUAL(5, d);
+}
+
+void test_parser_types() {
+  Parser parser;
+  int32_t i32{ 0 };
+  int16_t i16{ 0 };
+  float f{ 0 };
+  const char* str{ nullptr };
+
+  parser.set_string("A1 X-1.25 Y100000 Z.5 F+3. T\"Hello world\" U\"\" V\"open");
+  TEST_ASSERT_EQUAL(1, parser.get_number());
+
+  // integers truncate, int16_t saturates
+  TEST_ASSERT_TRUE(parser.get_parameter('X', i32));
+  TEST_ASSERT_EQUAL(-1, i32);
+  TEST_ASSERT_TRUE(parser.get_parameter('Y', i32));
+  TEST_ASSERT_EQUAL(100000, i32);
+  TEST_ASSERT_TRUE(parser.get_parameter('Y', i16));
+  TEST_ASSERT_EQUAL(INT16_MAX, i16);
+
+  // fixed point rounds half away from zero
+  TEST_ASSERT_TRUE(parser.get_fixed('X', i32, 1));
+  TEST_ASSERT_EQUAL(-13, i32);
+  TEST_ASSERT_TRUE(parser.get_fixed('X', i32, 3));
+  TEST_ASSERT_EQUAL(-1250, i32);
+  TEST_ASSERT_TRUE(parser.get_fixed('Z', i32, 0));
+  TEST_ASSERT_EQUAL(1, i32);
+  TEST_ASSERT_TRUE(parser.get_fixed('F', i32, 2));
+  TEST_ASSERT_EQUAL(300, i32);
+
+  TEST_ASSERT_TRUE(parser.get_parameter('X', f));
+  TEST_ASSERT_EQUAL_FLOAT(-1.25f, f);
+  TEST_ASSERT_TRUE(parser.get_parameter('Z', f));
+  TEST_ASSERT_EQUAL_FLOAT(0.5f, f);
+
+  // strings, numeric getters return the default for them
+  TEST_ASSERT_TRUE(parser.get_string('T', str));
+  TEST_ASSERT_EQUAL_STRING("Hello world", str);
+  TEST_ASSERT_TRUE(parser.get_string('U', str, "x"));
+  TEST_ASSERT_EQUAL_STRING("", str);
+  TEST_ASSERT_TRUE(parser.get_string('V', str));
+  TEST_ASSERT_EQUAL_STRING_MESSAGE("open", str, "Unterminated string runs to the end");
+  TEST_ASSERT_TRUE(parser.get_parameter('T', i32, 7));
+  TEST_ASSERT_EQUAL(7, i32);
+  TEST_ASSERT_TRUE(parser.get_string('X', str, "def"));
+  TEST_ASSERT_EQUAL_STRING("def", str);
+
+  // strings, which don't fit, are truncated
+  parser.set_string("A1 S\"0123456789012345678901234567890123456789\" T\"abc\"");
+  TEST_ASSERT_TRUE(parser.get_string('S', str));
+  TEST_ASSERT_EQUAL(Parser::kMaxStringLen - 1, strlen(str));
+  TEST_ASSERT_TRUE(parser.get_string('T', str));
+  TEST_ASSERT_EQUAL_STRING("", str);
 
+  // precision and range
+  parser.set_string("A1 S3.14159265358979 L-2147483648 M99999999999 N0.0000000001");
+  TEST_ASSERT_TRUE(parser.get_parameter('S', f));
+  TEST_ASSERT_EQUAL_FLOAT(3.14159265f, f);
+  TEST_ASSERT_TRUE(parser.get_fixed('S', i32, 6));
+  TEST_ASSERT_EQUAL(3141593, i32);
+  TEST_ASSERT_TRUE(parser.get_parameter('L', i32));
+  TEST_ASSERT_EQUAL(INT32_MIN, i32);
+  TEST_ASSERT_TRUE(parser.get_parameter('M', i32));
+  TEST_ASSERT_EQUAL(INT32_MAX, i32);
+  TEST_ASSERT_TRUE(parser.get_parameter('M', f));
+  TEST_ASSERT_EQUAL_FLOAT(99999999999.0f, f);
+  TEST_ASSERT_TRUE(parser.get_parameter('N', f));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, f);
+  parser.set_string("A1 S2147483648 Q-2147483649");
+  TEST_ASSERT_TRUE(parser.get_parameter('S', i32));
+  TEST_ASSERT_EQUAL(INT32_MAX, i32);
+  TEST_ASSERT_TRUE(parser.get_parameter('Q', i32));
+  TEST_ASSERT_EQUAL(INT32_MIN, i32);
+
+  // 32 bit binary values
+  const uint8_t cmd[] = { 'A', 1, 'S', 0xFE, 0xFF, 0xFF, 0xFF, 0x0F, 'Q', 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+  TEST_ASSERT_TRUE(parser.set_binary(cmd, sizeof(cmd)));
+  TEST_ASSERT_TRUE(parser.get_parameter('S', i32));
+  TEST_ASSERT_EQUAL(INT32_MAX, i32);
+  TEST_ASSERT_TRUE(parser.get_parameter('Q', i32));
+  TEST_ASSERT_EQUAL(INT32_MIN, i32);
+}
+
+void test_parser_schema() {
+  static constexpr ParamSpec kParams[] = {
+    ParamSpec::integer('S', 0, 59).required(),
+    ParamSpec::integer('T', -10, 10).or_default(5),
+    ParamSpec::fixed('X', 2, -1000, 1000).or_default(250),
+    ParamSpec::string('N', 1, 8),
+    ParamSpec::flag('R'),
+  };
+  static constexpr ParamSchema kSchema = make_schema(kParams);
+  static_assert(kSchema.valid, "Valid schema");
+  static constexpr ParamSpec kDuplicate[] = { ParamSpec::flag('R'), ParamSpec::integer('R', 0, 1) };
+  static_assert(!make_schema(kDuplicate).valid, "Duplicate letter");
+  static constexpr ParamSpec kEmpty[] = { ParamSpec::integer('S', 1, 0) };
+  static_assert(!make_schema(kEmpty).valid, "Empty range");
+
+  Parser parser;
+  ParamError error;
+  int32_t val{ 0 };
+  const char* str{ nullptr };
+
+  parser.set_string("A1 S59 T-10 X-9.995 N\"abc\" R");
+  TEST_ASSERT_TRUE(parser.validate(kSchema, error));
+  TEST_ASSERT_TRUE(error.kind == ParamError::Kind::kNone);
+
+  // defaults of missing parameters
+  parser.set_string("A1 S0");
+  TEST_ASSERT_TRUE(parser.validate(kSchema, error));
+  TEST_ASSERT_FALSE_MESSAGE(parser.get_parameter('T', val, -1), "Default is not presence");
+  TEST_ASSERT_EQUAL(5, val);
+  TEST_ASSERT_FALSE(parser.get_fixed('X', val, 2));
+  TEST_ASSERT_EQUAL(250, val);
+  TEST_ASSERT_FALSE(parser.get_string('N', str, "none"));
+  TEST_ASSERT_EQUAL_STRING("none", str);
+
+  const struct {
+    const char* line;
+    ParamError::Kind kind;
+    char letter;
+  } errors[] = {
+    { "A1 T1", ParamError::Kind::kMissing, 'S' },
+    { "A1 S1 Q1", ParamError::Kind::kUnknown, 'Q' },
+    { "A1 S60", ParamError::Kind::kRange, 'S' },
+    { "A1 S-1", ParamError::Kind::kRange, 'S' },
+    { "A1 S1.5", ParamError::Kind::kValue, 'S' },
+    { "A1 S", ParamError::Kind::kValue, 'S' },
+    { "A1 S\"1\"", ParamError::Kind::kValue, 'S' },
+    { "A1 S1 X10.01", ParamError::Kind::kRange, 'X' },
+    { "A1 S1 N\"\"", ParamError::Kind::kRange, 'N' },
+    { "A1 S1 N\"too long!\"", ParamError::Kind::kRange, 'N' },
+    { "A1 S1 N5", ParamError::Kind::kValue, 'N' },
+  };
+  for (const auto& e : errors) {
+    parser.set_string(e.line);
+    TEST_ASSERT_FALSE_MESSAGE(parser.validate(kSchema, error), e.line);
+    TEST_ASSERT_TRUE_MESSAGE(error.kind == e.kind, e.line);
+    TEST_ASSERT_EQUAL_MESSAGE(e.letter, error.letter, e.line);
+  }
+
+  // integer with a zero fraction, binary commands are validated too
+  parser.set_string("A1 S12.00");
+  TEST_ASSERT_TRUE(parser.validate(kSchema, error));
+  const uint8_t cmd[] = { 'A', 1, 'S', 120 };
+  TEST_ASSERT_TRUE(parser.set_binary(cmd, sizeof(cmd)));
+  TEST_ASSERT_FALSE(parser.validate(kSchema, error));
+  TEST_ASSERT_TRUE(error.kind == ParamError::Kind::kRange);
+
+  parser.set_string("A1");
+  TEST_ASSERT_TRUE(parser.validate(kNoParams, error));
+  parser.set_string("A1 S1");
+  TEST_ASSERT_FALSE(parser.validate(kNoParams, error));
+}
+
+void test_parser_arrays() {
+  Parser parser;
+  ParamArray arr;
+  ParamError error;
+  int32_t val{ 0 };
+
+  // decimal, the view points into the line
+  const char line[] = "A14 D1,-2,2147483647,-2147483648 R5";
+  parser.set_string(line);
+  TEST_ASSERT_TRUE(parser.get_array('D', arr));
+  TEST_ASSERT_TRUE(arr.get_format() == ParamArray::Format::kDecimal);
+  TEST_ASSERT_EQUAL(4, arr.size());
+  TEST_ASSERT_EQUAL(1, arr[0]);
+  TEST_ASSERT_EQUAL(-2, arr[1]);
+  TEST_ASSERT_EQUAL(INT32_MAX, arr[2]);
+  TEST_ASSERT_EQUAL(INT32_MIN, arr[3]);
+  int32_t sum{ 0 };
+  arr.for_each([&sum](int32_t elem) { sum += elem; });
+  TEST_ASSERT_EQUAL(-2, sum);
+  TEST_ASSERT_TRUE(parser.get_parameter('R', val));
+  TEST_ASSERT_EQUAL(5, val);
+
+  // a number isn't an array, a trailing ',' makes one
+  parser.set_string("A14 D5 R5,");
+  TEST_ASSERT_TRUE(parser.get_array('D', arr));
+  TEST_ASSERT_EQUAL(0, arr.size());
+  TEST_ASSERT_TRUE(parser.get_array('R', arr));
+  TEST_ASSERT_EQUAL(1, arr.size());
+  TEST_ASSERT_EQUAL(5, arr[0]);
+  TEST_ASSERT_TRUE(parser.get_parameter('R', val, -1));
+  TEST_ASSERT_EQUAL(-1, val);
+
+  // hex
+  parser.set_string("A14 D$00fF7a;A1");
+  TEST_ASSERT_TRUE(parser.get_array('D', arr));
+  TEST_ASSERT_TRUE(arr.get_format() == ParamArray::Format::kHex);
+  TEST_ASSERT_EQUAL(3, arr.size());
+  TEST_ASSERT_EQUAL(0x00, arr[0]);
+  TEST_ASSERT_EQUAL(0xFF, arr[1]);
+  TEST_ASSERT_EQUAL(0x7A, arr[2]);
+  parser.set_string("A14 D$");
+  TEST_ASSERT_TRUE(parser.get_array('D', arr));
+  TEST_ASSERT_EQUAL(0, arr.size());
+
+  // bad arrays have no value, arrays after kMaxArrays neither
+  for (const char* bad : { "A14 D$012", "A14 D1,2.5", "A14 D1.,2", "A14 D1,2.", "A14 D1,99999999999",
+                          "A14 A1,2 B$01 D1,2" }) {
+    parser.set_string(bad);
+    TEST_ASSERT_TRUE_MESSAGE(parser.get_array('D', arr), bad);
+    TEST_ASSERT_EQUAL_MESSAGE(0, arr.size(), bad);
+  }
+
+  // binary byte array, letter with kBytes, length and raw bytes
+  const uint8_t cmd[] = { 'A', 14, 'R', 8, 'D' | Parser::kBytes, 3, 0, 10, 255 };
+  TEST_ASSERT_TRUE(parser.set_binary(cmd, sizeof(cmd)));
+  TEST_ASSERT_TRUE(parser.get_array('D', arr));
+  TEST_ASSERT_TRUE(arr.get_format() == ParamArray::Format::kBytes);
+  TEST_ASSERT_EQUAL(3, arr.size());
+  TEST_ASSERT_EQUAL(255, arr[2]);
+  TEST_ASSERT_TRUE(parser.get_parameter('R', val));
+  TEST_ASSERT_EQUAL(4, val);
+  const uint8_t truncated[] = { 'A', 14, 'D' | Parser::kBytes, 3, 0, 10 };
+  TEST_ASSERT_FALSE(parser.set_binary(truncated, sizeof(truncated)));
+
+  // elements are range checked
+  static constexpr ParamSpec kParams[] = { ParamSpec::array('D', 0, 255).required() };
+  static constexpr ParamSchema kSchema = make_schema(kParams);
+  parser.set_string("A14 D1,2,255");
+  TEST_ASSERT_TRUE(parser.validate(kSchema, error));
+  parser.set_string("A14 D1,256");
+  TEST_ASSERT_FALSE(parser.validate(kSchema, error));
+  TEST_ASSERT_TRUE(error.kind == ParamError::Kind::kRange);
+  // an element with a decimal point is rejected, not read as the integer before it
+  parser.set_string("A14 D1.,2");
+  TEST_ASSERT_FALSE(parser.validate(kSchema, error));
+  parser.set_string("A14 D1");
+  TEST_ASSERT_FALSE(parser.validate(kSchema, error));
+  TEST_ASSERT_TRUE(error.kind == ParamError::Kind::kValue);
+}
+
+/**
+ * @brief Parse and read 7 parameters like A2: a typical line, the worst case line with all 7 in reverse order, and a
+ * line with no hits
+ *
+ */
+void bench_parser() {
+  constexpr uint32_t iterations = 1000;
+  const char* const lines[] = { "A2 S30 M15 H12", "A2 Y22 O3 D17 W6 H12 M15 S30", "A2 Z1 X2 V3 U4 T5 R6 Q7 P8" };
+  const char* const names[] = { "parse typical line", "parse worst case line", "parse line with misses" };
+  Parser parser;
+  bench_init();
+
+  for (size_t i = 0; i < 3; ++i) {
+    volatile int32_t sink{ 0 };
+    const uint32_t start = bench_cycles();
+    for (uint32_t n = 0; n < iterations; ++n) {
+      parser.set_string(lines[i]);
+      for (const char param : { 'S', 'M', 'H', 'W', 'D', 'O', 'Y' }) {
+        int16_t val{ 0 };
+        parser.get_parameter(param, val);
+        sink = sink + val;
+      }
+    }
+    bench_report(names[i], bench_cycles() - start, iterations);
+  }
+}
 
 #ifdef __cplusplus
 }
@@ -5,6 +5,11 @@
 extern "C" {
   #endif
 void test_parser();
+void test_parser_binary();
+void test_parser_types();
+void test_parser_schema();
+void test_parser_arrays();
+void bench_parser();
   #ifdef __cplusplus
 }
   #endif
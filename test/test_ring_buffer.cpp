@@ -6,8 +6,74 @@
 
 #include "test_ring_buffer.h"
 #include "../include/ring_buffer.h"
+#include "../include/spsc_ring_buffer.h"
 #include "unity.h"
 
+#include <cstring>
+
+/**
+ * @brief Fills and drains \p buff \p rounds times, checks order and the states at every step
+ *
+ */
+template <class Buffer>
+static void fill_and_drain(Buffer& buff, size_t rounds) {
+  constexpr size_t size = Buffer::buffer_size_;
+  size_t written{ 0 }, read{ 0 };
+  for (size_t round = 0; round < rounds; ++round) {
+    // a different fill level every round, so the wrap happens at every slot
+    const size_t fill = 1 + round % size;
+    for (size_t i = 0; i < fill; ++i) {
+      auto ptr = buff.get_next_free();
+      TEST_ASSERT_NOT_NULL(ptr);
+      *ptr = static_cast<typename Buffer::data_t>(written++);
+      buff.push();
+      TEST_ASSERT_EQUAL(i + 1, buff.num_occupied());
+    }
+    TEST_ASSERT_EQUAL(fill == size, buff.is_full());
+    while (!buff.is_empty()) {
+      TEST_ASSERT_EQUAL(static_cast<typename Buffer::data_t>(read++), *buff.get_next_occupied());
+      buff.pop();
+    }
+    TEST_ASSERT_EQUAL(0, buff.num_occupied());
+  }
+  TEST_ASSERT_EQUAL(written, read);
+}
+
+/**
+ * @brief Streams \p total bytes through \p buff with memcpy into and out of the spans, in chunks of \p chunk
+ *
+ */
+template <class Buffer>
+static void stream_spans(Buffer& buff, size_t total, size_t chunk) {
+  uint8_t data[64];
+  size_t written{ 0 }, read{ 0 };
+  while (read < total) {
+    // producer, a chunk at most, which may take two spans
+    for (size_t left = chunk; left && written < total;) {
+      size_t count{ 0 };
+      uint8_t* ptr = buff.get_free_span(count);
+      if (ptr == nullptr) break;
+      TEST_ASSERT_TRUE(count <= Buffer::buffer_size_);
+      count = count < left ? count : left;
+      for (size_t i = 0; i < count; ++i) data[i] = static_cast<uint8_t>(written + i);
+      memcpy(ptr, data, count);
+      buff.commit(count);
+      written += count;
+      left -= count;
+    }
+    TEST_ASSERT_EQUAL(written - read, buff.num_occupied());
+
+    // consumer, everything
+    size_t count{ 0 };
+    while (const uint8_t* ptr = buff.get_occupied_span(count)) {
+      for (size_t i = 0; i < count; ++i) TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(read + i), ptr[i]);
+      buff.consume(count);
+      read += count;
+    }
+    TEST_ASSERT_TRUE(buff.is_empty());
+  }
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -86,6 +152,114 @@ void test_ring_buffer() {
   TEST_ASSERT_EQUAL(200, val2);
 }
 
+/**
+ * @brief Run ring buffer tests with power of 2, odd and large capacities
+ *
+ */
+void test_ring_buffer_capacity() {
+  static RingBuffer<uint8_t, 8> pow2;
+  static RingBuffer<uint16_t, 7> odd;
+  static RingBuffer<uint32_t, 300> large;
+  fill_and_drain(pow2, 50);
+  fill_and_drain(odd, 50);
+  fill_and_drain(large, 700);
+
+  // reserved, but not pushed yet, is neither readable nor free
+  odd.reset();
+  for (size_t i = 0; i < 7; ++i) TEST_ASSERT_NOT_NULL(odd.get_next_free());
+  TEST_ASSERT_TRUE(odd.is_full());
+  TEST_ASSERT_TRUE(odd.is_empty());
+  TEST_ASSERT_NULL(odd.get_next_occupied());
+  TEST_ASSERT_EQUAL(0, odd.num_occupied());
+  odd.push();
+  TEST_ASSERT_EQUAL(1, odd.num_occupied());
+
+  // reset drops the reservations too
+  odd.reset();
+  TEST_ASSERT_TRUE(odd.is_empty());
+  TEST_ASSERT_FALSE(odd.is_full());
+  TEST_ASSERT_EQUAL(0, odd.num_occupied());
+}
+
+/**
+ * @brief Run ring buffer tests of the contiguous free and occupied regions
+ *
+ */
+void test_ring_buffer_spans() {
+  static RingBuffer<uint8_t, 16> pow2;
+  static RingBuffer<uint8_t, 13> odd;
+  stream_spans(pow2, 1000, 5);
+  stream_spans(pow2, 1000, 16);
+  stream_spans(odd, 1000, 7);
+  stream_spans(odd, 1000, 13);
+
+  // the free region ends at the end of the array, the rest follows after the wrap
+  // start at slot 8, so 5 elements are free before the end
+  odd.reset();
+  size_t count{ 0 };
+  while (odd.get_free_span(count) && count != 5) {
+    odd.get_next_free();
+    odd.push();
+    odd.pop();
+  }
+  uint8_t* first = odd.get_free_span(count);
+  TEST_ASSERT_NOT_NULL(first);
+  TEST_ASSERT_EQUAL(5, count);
+  const size_t start = 13 - count;
+  odd.commit(count);
+  TEST_ASSERT_TRUE(odd.is_full() == (start == 0));
+  TEST_ASSERT_EQUAL(count, odd.num_occupied());
+  odd.consume(count);
+  TEST_ASSERT_EQUAL_PTR(first - start, odd.get_free_span(count));
+  TEST_ASSERT_EQUAL(13, count);
+
+  // pending reservations hide the free region
+  odd.get_next_free();
+  TEST_ASSERT_NULL(odd.get_free_span(count));
+  TEST_ASSERT_EQUAL(0, count);
+  odd.push();
+  TEST_ASSERT_NOT_NULL(odd.get_free_span(count));
+  TEST_ASSERT_EQUAL(12, count);
+  TEST_ASSERT_NOT_NULL(odd.get_occupied_span(count));
+  TEST_ASSERT_EQUAL(1, count);
+}
+
+/**
+ * @brief Run single producer, single consumer ring buffer tests, without concurrency, see tools/spsc_bench.cpp
+ *
+ */
+void test_spsc_ring_buffer() {
+  static SpscRingBuffer<uint8_t, 8> pow2;
+  static SpscRingBuffer<uint32_t, 5> odd;
+  static SpscRingBuffer<uint8_t, 13> bytes;
+  fill_and_drain(pow2, 50);
+  fill_and_drain(odd, 50);
+  stream_spans(bytes, 1000, 7);
+
+  // one producer, the free slot is not reserved
+  odd.reset();
+  uint32_t* ptr = odd.get_next_free();
+  TEST_ASSERT_EQUAL_PTR(ptr, odd.get_next_free());
+  TEST_ASSERT_TRUE(odd.is_empty());
+  *ptr = 42;
+  odd.push();
+  TEST_ASSERT_TRUE(ptr != odd.get_next_free());
+  TEST_ASSERT_EQUAL(1, odd.num_occupied());
+  TEST_ASSERT_EQUAL(42, *odd.get_next_occupied());
+  odd.pop();
+  TEST_ASSERT_NULL(odd.get_next_occupied());
+  odd.pop();
+  TEST_ASSERT_EQUAL(0, odd.num_occupied());
+
+  for (size_t i = 0; i < 5; ++i) {
+    TEST_ASSERT_NOT_NULL(odd.get_next_free());
+    odd.push();
+  }
+  TEST_ASSERT_TRUE(odd.is_full());
+  TEST_ASSERT_NULL(odd.get_next_free());
+  odd.reset();
+  TEST_ASSERT_TRUE(odd.is_empty());
+}
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,9 @@
 extern "C" {
 #endif
 void test_ring_buffer();
+void test_ring_buffer_capacity();
+void test_ring_buffer_spans();
+void test_spsc_ring_buffer();
 #ifdef __cplusplus
 }
 #endif
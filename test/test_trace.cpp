@@ -0,0 +1,59 @@
+/**
+ * @file test_trace.cpp
+ * Kernel trace recorder test implementation
+ *
+ */
+
+#include "test_trace.h"
+#include "../include/trace.h"
+#include "unity.h"
+
+using trace::Event;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run kernel trace recorder tests
+ *
+ */
+void test_trace_recorder() {
+  trace::Recorder<4> recorder;
+  TEST_ASSERT_EQUAL(0, recorder.size());
+  TEST_ASSERT_TRUE(recorder.is_running());
+
+  recorder.add(10, Event::kSwitchIn, 2);
+  recorder.add(20, Event::kGive, 1, 3);
+  TEST_ASSERT_EQUAL(2, recorder.size());
+  TEST_ASSERT_EQUAL(10, recorder[0].time);
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(Event::kSwitchIn), recorder[0].event);
+  TEST_ASSERT_EQUAL(2, recorder[0].id);
+  TEST_ASSERT_EQUAL(0, recorder[0].arg);
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(Event::kGive), recorder[1].event);
+  TEST_ASSERT_EQUAL(3, recorder[1].arg);
+
+  // the oldest records are overwritten, the rest stays in order
+  for (uint32_t time = 30; time <= 70; time += 10) recorder.add(time, Event::kIsrEnter, 0);
+  TEST_ASSERT_EQUAL(4, recorder.size());
+  TEST_ASSERT_EQUAL(7, recorder.total());
+  for (size_t i = 0; i < 4; ++i) TEST_ASSERT_EQUAL(40 + i * 10, recorder[i].time);
+
+  // stopped, nothing is added, the records can be read
+  recorder.stop();
+  TEST_ASSERT_FALSE(recorder.is_running());
+  recorder.add(80, Event::kIsrExit, 0);
+  TEST_ASSERT_EQUAL(7, recorder.total());
+  TEST_ASSERT_EQUAL(70, recorder[3].time);
+
+  recorder.clear();
+  TEST_ASSERT_EQUAL(0, recorder.size());
+  recorder.start();
+  recorder.add(90, Event::kSwitchOut, 1);
+  TEST_ASSERT_EQUAL(1, recorder.size());
+  TEST_ASSERT_EQUAL(90, recorder[0].time);
+}
+
+#ifdef __cplusplus
+}
+#endif
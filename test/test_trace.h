@@ -0,0 +1,19 @@
+/**
+ * @file test_trace.h
+ * Kernel trace recorder test header file
+ */
+
+#ifndef TEST_TRACE_H_
+#define TEST_TRACE_H_ 1
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void test_trace_recorder();
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * @file async_sim.cpp
+ * @brief Host tool, simulates the latency of LED gcodes queued behind RTC gcodes, with blocking and async I2C gcodes
+ *
+ * A model of gcode_task with 5 RX slots, the I2C bus, and the display task, which holds the bus for a 1 KB frame every
+ * second. The host sends a random mix of A1 and A3 lines, with exponential gaps, and waits while the RX slots are
+ * full. Blocking runs A3 on gcode_task, like before the I2C worker. Async posts it to the I2C worker, with the queue
+ * and the echo ring of the firmware, and echoes the lines in order. The simulation runs in virtual time, so the
+ * results are repeatable.
+ *
+ * Build: g++ -std=c++17 -O2 -o async_sim tools/async_sim.cpp
+ * Usage: async_sim [count] [A3 percent] [mean gap ms]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+  constexpr size_t kSlots = 5;           //!< RX slots, Uart::kRxBufferSize
+  constexpr size_t kMaxAcks = 8;         //!< Echoes waiting for pending lines, GcodeParser::kMaxAcks
+  constexpr size_t kQueueLen = 2;        //!< Jobs waiting for the I2C worker, CommandWorker::kQueueLen
+  constexpr double kCommandTime = 0.05;  //!< Parsing and running a gcode, ms
+  constexpr double kPostTime = 0.02;     //!< Posting a job to the worker, ms
+  constexpr double kRtcTime = 0.5;       //!< Reading the RTC over I2C, ms
+  constexpr double kFramePeriod = 1000;  //!< Display refresh, ms
+  constexpr double kFrameTime = 26;      //!< RTC read, RAM address and 1 KB canvas at 400 kHz, ms
+
+  /**
+   * @brief A line sent by the host
+   *
+   */
+  struct Line {
+    double sent;   //!< When the host wanted to send it
+    bool is_rtc;   //!< A3, otherwise A1
+  };
+
+  /**
+   * @brief When the line was run and echoed
+   *
+   */
+  struct Result {
+    double done;  //!< The LED was switched, or the time was read
+    double echo;  //!< The echo was queued
+  };
+
+  /**
+   * @brief Earliest time from \p t, when the display doesn't hold the bus
+   *
+   */
+  double bus_free(double t) {
+    const double phase = t - kFramePeriod * static_cast<long>(t / kFramePeriod);
+    return phase < kFrameTime ? t - phase + kFrameTime : t;
+  }
+
+  /**
+   * @brief A3 runs on gcode_task, the lines after it wait for the bus
+   *
+   */
+  std::vector<Result> run_blocking(const std::vector<Line>& lines) {
+    std::vector<Result> res(lines.size());
+    std::vector<double> popped(lines.size());
+    double task_free{ 0 };
+    for (size_t i = 0; i < lines.size(); ++i) {
+      const double received = std::max(lines[i].sent, i >= kSlots ? popped[i - kSlots] : 0.0);
+      const double start = std::max(received, task_free);
+      const double done = lines[i].is_rtc ? bus_free(start) + kRtcTime + kCommandTime : start + kCommandTime;
+      res[i] = { done, done };
+      popped[i] = task_free = done;
+    }
+    return res;
+  }
+
+  /**
+   * @brief A3 is posted to the I2C worker, echoes wait for the pending lines before them
+   *
+   */
+  std::vector<Result> run_async(const std::vector<Line>& lines) {
+    std::vector<Result> res(lines.size());
+    std::vector<double> popped(lines.size());
+    std::vector<double> job_start, job_done;
+    std::deque<double> acks;  // echo times of the lines in the echo ring
+    double task_free{ 0 }, last_echo{ 0 };
+    for (size_t i = 0; i < lines.size(); ++i) {
+      const double received = std::max(lines[i].sent, i >= kSlots ? popped[i - kSlots] : 0.0);
+      double start = std::max(received, task_free);
+      while (!acks.empty() && acks.front() <= start) acks.pop_front();
+      if (acks.size() == kMaxAcks) {
+        start = acks.front();  // gcode_task takes no lines, until the oldest echo is sent
+        acks.pop_front();
+      }
+
+      double handled{ 0 }, done{ 0 };
+      if (lines[i].is_rtc) {
+        const size_t job = job_start.size();
+        const double post = std::max(start, job >= kQueueLen ? job_start[job - kQueueLen] : 0.0);
+        job_start.push_back(std::max(post, job_done.empty() ? 0.0 : job_done.back()));
+        job_done.push_back(bus_free(job_start.back()) + kRtcTime);
+        handled = post + kPostTime + kCommandTime;
+        done = job_done.back();
+      } else {
+        handled = done = start + kCommandTime;
+      }
+      last_echo = std::max({ handled, done, last_echo });
+      if (last_echo > handled) acks.push_back(last_echo);
+      res[i] = { done, last_echo };
+      popped[i] = task_free = handled;
+    }
+    return res;
+  }
+
+  /**
+   * @brief Percentile \p p of \p v, sorts it
+   *
+   */
+  double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, static_cast<size_t>(p / 100 * v.size()))];
+  }
+
+  /**
+   * @brief Prints the LED and echo latencies, from when the host wanted to send the line
+   *
+   */
+  void print(const char* name, const std::vector<Line>& lines, const std::vector<Result>& res) {
+    std::vector<double> led, echo;
+    double led_sum{ 0 }, echo_sum{ 0 };
+    for (size_t i = 0; i < lines.size(); ++i) {
+      echo.push_back(res[i].echo - lines[i].sent);
+      echo_sum += echo.back();
+      if (lines[i].is_rtc) continue;
+      led.push_back(res[i].done - lines[i].sent);
+      led_sum += led.back();
+    }
+    const double led_mean = led.empty() ? 0 : led_sum / led.size();
+    const double echo_mean = echo_sum / echo.size();
+    const double led_p99 = percentile(led, 99), echo_p99 = percentile(echo, 99);
+    printf("%-9s %8.3f %8.3f %8.3f %10.3f %8.3f %8.3f\n", name, led_mean, led_p99, led.empty() ? 0 : led.back(),
+           echo_mean, echo_p99, echo.back());
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const unsigned count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  const double rtc_share = argc > 2 ? strtod(argv[2], nullptr) / 100 : 0.1;
+  const double mean_gap = argc > 3 ? strtod(argv[3], nullptr) : 5;
+  if (count == 0 || mean_gap <= 0) {
+    fprintf(stderr, "Usage: %s [count] [A3 percent] [mean gap ms]\n", argv[0]);
+    return 1;
+  }
+
+  std::mt19937 rng(1);
+  std::exponential_distribution<double> gap(1 / mean_gap);
+  std::bernoulli_distribution rtc(rtc_share);
+  std::vector<Line> lines(count);
+  double t{ 0 };
+  for (auto& line : lines) {
+    t += gap(rng);
+    line = { t, rtc(rng) };
+  }
+
+  printf("%u lines, %.0f%% A3, mean gap %.2f ms, display frame %.0f ms every %.0f ms\n", count, rtc_share * 100,
+         mean_gap, kFrameTime, kFramePeriod);
+  printf("%-9s %26s %28s\n", "", "A1 latency ms", "echo latency ms");
+  printf("%-9s %8s %8s %8s %10s %8s %8s\n", "", "mean", "p99", "max", "mean", "p99", "max");
+  print("blocking", lines, run_blocking(lines));
+  print("async", lines, run_async(lines));
+  return 0;
+}
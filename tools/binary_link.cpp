@@ -0,0 +1,390 @@
+/**
+ * @file binary_link.cpp
+ * @brief Host tool, encoder and decoder of the binary protocol, and benchmarks of it against the text protocol
+ *
+ * A command frame is the COBS encoded binary command (see Parser::set_binary()) and its CRC-16, followed by 0.
+ * Reply frames are the same, their first byte tells the type: Uart::kTextMarker for text, Uart::kLogMarker for a
+ * deferred log record.
+ *
+ * --bench runs the RX side of the target on the host, no serial port is involved. --roundtrip sends the same
+ * commands over the serial port as text lines, switches the target to binary mode with A8 S1, sends them as frames,
+ * and switches back with A8 S0. Each command is sent once before, to count its replies, the ok, the echo of a text
+ * line and the log lines, then the timed loop sends it, and waits for that many replies. Deferred logging must be
+ * disabled, the text replies are parsed as lines, and the target shall be in text mode.
+ *
+ * Build: g++ -std=c++17 -O2 -Iinclude -o binary_link tools/binary_link.cpp src/parser.cpp
+ * Usage: binary_link /dev/ttyACM0                      sends text commands from stdin as binary frames, prints the
+ *                                                      replies, text is printed as lines, log records are copied,
+ *                                                      pipe them into log_decoder. Switch to binary mode first, A8 S1
+ *        binary_link --roundtrip /dev/ttyACM0 [count]  round trips of text and binary commands on the target
+ *        binary_link --bench [count]                   decoding cost and size of text and binary commands on the
+ *                                                      host, no hardware needed
+ */
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cobs.h"
+#include "crc16.h"
+#include "line_framer.h"
+#include "parser.h"
+#include "serial_link.h"
+
+namespace {
+
+  constexpr uint8_t kLogMarker = 0x1E;   //!< Same as Uart::kLogMarker
+  constexpr uint8_t kTextMarker = 0x02;  //!< Same as Uart::kTextMarker
+  constexpr size_t kMsgLen = 42;         //!< Same as Uart::kMsgLen
+  constexpr int kSilence = 200;          //!< No reply for this long in ms ends the replies of a command
+
+  /**
+   * @brief The commands of the round trips, toggle the LED, and report settings without changing them
+   *
+   */
+  const std::vector<std::string> kQueries = { "A0", "A1", "A6", "A7", "A8" };
+
+  /**
+   * @brief Appends \p val as varint
+   *
+   */
+  void put_varint(std::vector<uint8_t>& out, uint32_t val) {
+    while (val >= 0x80) {
+      out.push_back((val & 0x7F) | 0x80);
+      val >>= 7;
+    }
+    out.push_back(val);
+  }
+
+  /**
+   * @brief Converts a text command, e.g. "A2 S10 M5 C" into the binary layout
+   * @details Arrays, e.g. D1,2,3 or D$010203, are sent as byte arrays, their elements shall be 0 to 255
+   * @return std::vector<uint8_t> binary command, empty on error
+   */
+  std::vector<uint8_t> encode_command(const std::string& text) {
+    std::vector<uint8_t> cmd;
+    const char* p = text.c_str();
+    while (*p == ' ') ++p;
+    if (*p < 'A' || *p > 'Z') return {};
+    cmd.push_back(*p++);
+    put_varint(cmd, strtoul(p, const_cast<char**>(&p), 10) & 0xFFFF);
+
+    while (*p) {
+      if (*p == ' ') {
+        ++p;
+        continue;
+      }
+      const char letter = *p++;
+      if (*p == '$') {
+        // hex array, raw bytes in binary
+        std::vector<uint8_t> bytes;
+        for (++p; isxdigit(p[0]) && isxdigit(p[1]); p += 2) {
+          bytes.push_back((ParamArray::nibble(p[0]) << 4) | ParamArray::nibble(p[1]));
+        }
+        cmd.push_back(letter | Parser::kBytes);
+        put_varint(cmd, bytes.size());
+        cmd.insert(cmd.end(), bytes.begin(), bytes.end());
+      } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        const int32_t val = strtol(p, const_cast<char**>(&p), 10);
+        if (*p == ',') {
+          // decimal array, its elements shall be bytes
+          std::vector<uint8_t> bytes{ static_cast<uint8_t>(val) };
+          bool valid = val >= 0 && val <= UINT8_MAX;
+          while (*p == ',' && (p[1] == '-' || (p[1] >= '0' && p[1] <= '9'))) {
+            const int32_t elem = strtol(p + 1, const_cast<char**>(&p), 10);
+            valid = valid && elem >= 0 && elem <= UINT8_MAX;
+            bytes.push_back(static_cast<uint8_t>(elem));
+          }
+          if (*p == ',') ++p;
+          if (!valid) return {};
+          cmd.push_back(letter | Parser::kBytes);
+          put_varint(cmd, bytes.size());
+          cmd.insert(cmd.end(), bytes.begin(), bytes.end());
+          continue;
+        }
+        cmd.push_back(letter);
+        // zigzag, small negative numbers are short too
+        put_varint(cmd, (static_cast<uint32_t>(val) << 1) ^ static_cast<uint32_t>(val >> 31));
+      } else {
+        cmd.push_back(letter | Parser::kNoValue);
+      }
+    }
+    return cmd;
+  }
+
+  /**
+   * @brief Appends the CRC, COBS encodes, and appends the delimiter
+   *
+   */
+  std::vector<uint8_t> make_frame(std::vector<uint8_t> data) {
+    const uint16_t crc = crc16::compute(data.data(), data.size());
+    data.push_back(crc & 0xFF);
+    data.push_back(crc >> 8);
+    std::vector<uint8_t> frame(cobs::max_encoded_len(data.size()) + 1);
+    const size_t len = cobs::encode(data.data(), data.size(), frame.data());
+    frame.resize(len + 1);
+    frame[len] = 0;
+    return frame;
+  }
+
+  /**
+   * @brief Decodes a frame without delimiter, and checks the CRC
+   *
+   * @param data set to the contents without CRC
+   * @return true if the frame is valid
+   */
+  bool open_frame(const uint8_t* frame, size_t len, std::vector<uint8_t>& data) {
+    data.resize(len);
+    size_t out_len{ 0 };
+    if (!cobs::decode(frame, len, data.data(), out_len) || out_len < 2) return false;
+    out_len -= 2;
+    const uint16_t crc = data[out_len] | (data[out_len + 1] << 8);
+    data.resize(out_len);
+    return crc16::compute(data.data(), out_len) == crc;
+  }
+
+  /**
+   * @brief Prints a reply frame, text as a line, log records unchanged
+   *
+   */
+  void print_reply(const std::vector<uint8_t>& data) {
+    if (data.empty()) return;
+    if (data[0] == kTextMarker) {
+      std::cout << "echo: " << std::string(data.begin() + 1, data.end()) << "\n";
+    } else if (data[0] == kLogMarker) {
+      std::cout.write(reinterpret_cast<const char*>(data.data()), data.size());
+    } else {
+      std::cout << "<unknown frame>\n";
+    }
+    std::cout.flush();
+  }
+
+  /**
+   * @brief Sends the commands from stdin, and prints the replies, until 100 ms of silence after each command
+   *
+   */
+  int run_link(const char* path) {
+    const int fd = serial::open_serial(path);
+    if (fd < 0) {
+      std::cerr << "Couldn't open " << path << "\n";
+      return 1;
+    }
+
+    serial::Link link(fd);
+    std::vector<uint8_t> data;
+    std::string line, frame;
+    while (std::getline(std::cin, line)) {
+      const auto cmd = encode_command(line);
+      if (cmd.empty()) {
+        std::cerr << "Can't encode: " << line << "\n";
+        continue;
+      }
+      const auto out = make_frame(cmd);
+      if (!link.write(out.data(), out.size())) return 1;
+
+      while (link.read_frame(frame, 100)) {
+        if (open_frame(reinterpret_cast<const uint8_t*>(frame.data()), frame.size(), data)) {
+          print_reply(data);
+        } else {
+          std::cerr << "<bad frame>\n";
+        }
+      }
+    }
+    close(fd);
+    return 0;
+  }
+
+  /**
+   * @brief Sends \p cmd, as a line or as a frame
+   *
+   * @return size_t bytes sent, 0 on error
+   */
+  size_t send_command(serial::Link& link, const std::string& cmd, bool binary) {
+    if (!binary) return link.write_line(cmd) ? cmd.size() + 1 : 0;
+    const auto frame = make_frame(encode_command(cmd));
+    return link.write(frame.data(), frame.size()) ? frame.size() : 0;
+  }
+
+  /**
+   * @brief Reads one reply, a line or a frame
+   *
+   */
+  bool read_reply(serial::Link& link, bool binary, int timeout_ms) {
+    std::string reply;
+    return binary ? link.read_frame(reply, timeout_ms) : link.read_line(reply, timeout_ms);
+  }
+
+  /**
+   * @brief Sends \p count of the commands in the mode of the target, one at a time, after their replies
+   *
+   * @return double ms per command, 0 on error
+   */
+  double round_trips(serial::Link& link, bool binary, unsigned count, size_t& bytes) {
+    std::vector<unsigned> replies;
+    for (const auto& cmd : kQueries) {
+      if (send_command(link, cmd, binary) == 0) return 0;
+      unsigned n{ 0 };
+      while (read_reply(link, binary, kSilence)) ++n;
+      if (n == 0) {
+        std::cerr << "No reply to " << cmd << "\n";
+        return 0;
+      }
+      replies.push_back(n);
+    }
+
+    bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+      const size_t k = i % kQueries.size();
+      const size_t sent = send_command(link, kQueries[k], binary);
+      if (sent == 0) return 0;
+      bytes += sent;
+      for (unsigned n = 0; n < replies[k]; ++n) {
+        if (!read_reply(link, binary, 1000)) {
+          std::cerr << "Reply " << n << " of " << kQueries[k] << " missing\n";
+          return 0;
+        }
+      }
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+  }
+
+  /**
+   * @brief Measures the round trips in text mode, then in binary mode, and prints both
+   *
+   */
+  int run_roundtrip(const char* path, unsigned count) {
+    const int fd = serial::open_serial(path);
+    if (fd < 0) {
+      std::cerr << "Couldn't open " << path << "\n";
+      return 1;
+    }
+    serial::Link link(fd);
+
+    link.drain(kSilence);
+    size_t text_bytes{ 0 }, binary_bytes{ 0 };
+    const double text_ms = round_trips(link, false, count, text_bytes);
+
+    send_command(link, "A8 S1", false);
+    link.drain(kSilence);
+    const double binary_ms = text_ms > 0 ? round_trips(link, true, count, binary_bytes) : 0;
+
+    send_command(link, "A8 S0", true);
+    link.drain(kSilence);
+    close(fd);
+    if (text_ms == 0 || binary_ms == 0) return 1;
+
+    printf("%u round trips of %zu commands\n", count, kQueries.size());
+    printf("text:   %6.1f bytes/command, %7.1f commands/s, %6.2f ms/command\n", double(text_bytes) / count,
+           1000 / text_ms, text_ms);
+    printf("binary: %6.1f bytes/command, %7.1f commands/s, %6.2f ms/command\n", double(binary_bytes) / count,
+           1000 / binary_ms, binary_ms);
+    return 0;
+  }
+
+  /**
+   * @brief Runs the RX side of the target on the host: framing, decoding and parameter lookup
+   *
+   * @return double ns per command
+   */
+  template <class F>
+  double time_commands(const std::vector<std::vector<uint8_t>>& wire, bool binary, unsigned count, F&& handle) {
+    LineFramer<256, kMsgLen> framer;
+    framer.reset();
+    framer.set_binary(binary);
+    size_t pos{ 0 }, handled{ 0 };
+    volatile int32_t sink{ 0 };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+      const auto& bytes = wire[i % wire.size()];
+      for (const auto b : bytes) {
+        framer.data()[pos] = b;
+        pos = (pos + 1) % framer.size();
+      }
+      framer.process(pos, [&](std::string_view msg) {
+        sink = sink + handle(msg);
+        ++handled;
+      });
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    if (handled != count) {
+      std::cerr << "Lost commands: " << count - handled << "\n";
+    }
+    return elapsed.count() / count;
+  }
+
+  /**
+   * @brief Reads the parameters, like a handler would
+   *
+   */
+  int32_t use_parser(const Parser& parser) {
+    int32_t sum = parser.get_prefix() + parser.get_number();
+    for (const char p : { 'S', 'M', 'H', 'D', 'W', 'Y', 'C' }) {
+      int16_t val{ 0 };
+      parser.get_parameter(p, val);
+      sum += val;
+    }
+    return sum;
+  }
+
+  int run_bench(unsigned count) {
+    const std::vector<std::string> commands = { "A0", "A1", "A2 S30 M15 H12 D17 W6 Y22 C10", "A3", "A5 P1 T50" };
+    std::vector<std::vector<uint8_t>> text_wire, binary_wire;
+    size_t text_bytes{ 0 }, binary_bytes{ 0 };
+
+    for (const auto& cmd : commands) {
+      text_wire.emplace_back(cmd.begin(), cmd.end());
+      text_wire.back().push_back('\n');
+      binary_wire.push_back(make_frame(encode_command(cmd)));
+      text_bytes += text_wire.back().size();
+      binary_bytes += binary_wire.back().size();
+      if (binary_wire.back().size() > kMsgLen) {
+        std::cerr << "Frame too long: " << cmd << "\n";
+        return 1;
+      }
+    }
+
+    Parser parser;
+    const double text_ns = time_commands(text_wire, false, count, [&](std::string_view msg) {
+      parser.set_string(msg.data());
+      return use_parser(parser);
+    });
+
+    const double binary_ns = time_commands(binary_wire, true, count, [&](std::string_view msg) {
+      uint8_t cmd[kMsgLen];
+      size_t len{ 0 };
+      if (!cobs::decode(reinterpret_cast<const uint8_t*>(msg.data()), msg.size(), cmd, len) || len < 2) return 0;
+      len -= 2;
+      if (crc16::compute(cmd, len) != (cmd[len] | (cmd[len + 1] << 8))) return 0;
+      if (!parser.set_binary(cmd, len)) return 0;
+      return use_parser(parser);
+    });
+
+    printf("%zu commands, %u iterations\n", commands.size(), count);
+    printf("text:   %6.1f bytes/command, %7.1f ns/command\n", double(text_bytes) / commands.size(), text_ns);
+    printf("binary: %6.1f bytes/command, %7.1f ns/command\n", double(binary_bytes) / commands.size(), binary_ns);
+    return 0;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " /dev/ttyACM0|--roundtrip /dev/ttyACM0 [count]|--bench [count]\n";
+    return 1;
+  }
+  if (strcmp(argv[1], "--roundtrip") == 0 && argc > 2) {
+    return run_roundtrip(argv[2], argc > 3 ? strtoul(argv[3], nullptr, 10) : 500);
+  }
+  if (strcmp(argv[1], "--bench") == 0) {
+    return run_bench(argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000000);
+  }
+  return run_link(argv[1]);
+}
@@ -0,0 +1,347 @@
+/**
+ * @file gcode_sender.cpp
+ * @brief Host tool, streams commands as numbered lines with checksum, and sends them again when the target asks
+ *
+ * Every command is sent as "N<line> <command>*<checksum>", see LineChecker. The advanced ok (A7) tells how many lines
+ * may be in flight, the last kWindow lines are kept, so they can be replayed from the line in "Resend: <line>". If
+ * nothing arrives for kTimeout, the lines after the last acknowledged one are sent again.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread -Iinclude -o gcode_sender tools/gcode_sender.cpp
+ * Usage: gcode_sender /dev/ttyACM0 [file]         streams the commands from file or stdin
+ *        gcode_sender --sim [count] [error rate]  streams count commands to a model of the firmware, which flips
+ *                                                 random bits in the received bytes, and checks that every command
+ *                                                 was run once, in order
+ * Deferred logging and binary mode must be disabled, the replies are parsed as text.
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "line_checker.h"
+#include "serial_link.h"
+
+namespace {
+
+  using serial::kTxPrefix;
+  using serial::Link;
+
+  constexpr size_t kMsgLen = 42;  //!< Same as Uart::kMsgLen
+  constexpr size_t kSlots = 5;    //!< Same as Uart::kRxBufferSize
+  constexpr size_t kWindow = 16;  //!< Number of lines kept for replay
+  constexpr int kTimeout = 200;   //!< Silence in ms, after which the unacknowledged lines are sent again
+
+  /**
+   * @brief Formats a numbered line with checksum
+   *
+   */
+  std::string number_line(uint32_t n, const std::string& cmd) {
+    std::string line = "N" + std::to_string(n) + " " + cmd;
+    return line + "*" + std::to_string(LineChecker::checksum(line.data(), line.size()));
+  }
+
+  /**
+   * @brief Counters of a stream
+   *
+   */
+  struct Stats {
+    unsigned lines{ 0 };     //!< Lines acknowledged
+    unsigned sent{ 0 };      //!< Lines sent, including replays
+    unsigned resends{ 0 };   //!< Resend requests
+    unsigned timeouts{ 0 };  //!< Replays after silence
+    double seconds{ 0 };     //!< Duration of the stream
+  };
+
+  /**
+   * @brief Waits for a reply, which contains \p text
+   *
+   */
+  bool wait_for(Link& link, const char* text) {
+    std::string line;
+    while (link.read_line(line, 1000)) {
+      if (line.find(text) != std::string::npos) return true;
+    }
+    std::cerr << "No reply: " << text << "\n";
+    return false;
+  }
+
+  /**
+   * @brief Streams the commands returned by \p next_command, until it returns false
+   *
+   * @return true if every line was acknowledged
+   */
+  bool stream(Link& link, const std::function<bool(std::string&)>& next_command, Stats& stats) {
+    // leave numbered mode, enable the advanced ok, and start from line 0
+    link.write_line("A9");
+    link.write_line("A7 S1");
+    if (!wait_for(link, "Advanced ok: 1")) return false;
+    link.write_line(number_line(0, "A9"));
+    if (!wait_for(link, "ok Q")) return false;
+
+    std::deque<std::string> window;  // lines acked + 1 ...
+    uint32_t acked{ 0 }, next{ 1 };
+    unsigned credit{ 1 };
+    bool more{ true };
+    std::string line, cmd;
+
+    const auto start = std::chrono::steady_clock::now();
+    while (true) {
+      while (more && window.size() < kWindow) {
+        if (!(more = next_command(cmd))) break;
+        window.push_back(number_line(acked + window.size() + 1, cmd));
+      }
+      if (window.empty()) break;
+
+      while (next <= acked + window.size() && next - acked <= credit) {
+        link.write_line(window[next - acked - 1]);
+        ++next;
+        ++stats.sent;
+      }
+
+      unsigned q{ 0 }, n{ 0 };
+      if (!link.read_line(line)) {
+        ++stats.timeouts;
+        next = acked + 1;
+        credit = 1;
+      } else if (sscanf(line.c_str(), "Resend: %u", &n) == 1) {
+        // older requests are answered already
+        if (n > acked && n < next) {
+          ++stats.resends;
+          next = n;
+        }
+      } else if (sscanf(line.c_str(), "ok Q%u N%u", &q, &n) == 2) {
+        while (acked < n && !window.empty()) {
+          window.pop_front();
+          ++acked;
+          ++stats.lines;
+        }
+        if (next <= acked) next = acked + 1;
+        credit = q;
+      }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.seconds = elapsed.count();
+
+    link.write_line("A9");
+    link.write_line("A7 S0");
+    while (link.read_line(line, 100)) {
+    }
+    return true;
+  }
+
+  /**
+   * @brief Model of the firmware: the RX ISR rules with the real LineChecker, kSlots RX slots, and a command task
+   *
+   * Each received byte has a bit flipped with probability error_rate. Replies are not corrupted.
+   */
+  class Simulator {
+  public:
+    static constexpr auto kCommandTime = std::chrono::microseconds(200);
+
+    Simulator(int fd, double error_rate) : fd_(fd), noise_(error_rate) {
+      std::thread([this] { rx(); }).detach();
+      std::thread([this] { work(); }).detach();
+    }
+
+    /**
+     * @brief The S values of the A0 commands, in the order they were run
+     *
+     */
+    std::vector<long> get_executed() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return executed_;
+    }
+
+  private:
+    void send(const std::string& line) {
+      std::lock_guard<std::mutex> lock(tx_mutex_);
+      const std::string data = kTxPrefix + line + "\n";
+      ::write(fd_, data.data(), data.size());
+    }
+
+    /**
+     * @brief Call with mutex_ locked
+     *
+     */
+    std::string make_ok() const {
+      if (!advanced_) return "ok";
+      return "ok Q" + std::to_string(kSlots - queue_.size()) + " N" + std::to_string(checker_.get_line());
+    }
+
+    /**
+     * @brief Framer and RX ISR
+     *
+     */
+    void rx() {
+      std::mt19937 rng(1);
+      std::string line;
+      bool overlong{ false };
+      char c;
+      while (::read(fd_, &c, 1) == 1) {
+        if (noise_(rng)) c ^= 1 << (rng() % 8);
+        if (c != '\n' && c != '\r') {
+          if (line.size() + 1 >= kMsgLen) overlong = true;
+          line += c;
+          continue;
+        }
+        if (!line.empty() && !overlong) on_line(line);
+        line.clear();
+        overlong = false;
+      }
+    }
+
+    void on_line(const std::string& received) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      std::string_view view(received);
+      switch (checker_.check(view, queue_.size() == kSlots)) {
+        case LineChecker::Action::kResend:
+          lock.unlock();
+          send("Resend: " + std::to_string(checker_.get_resend_line()));
+          return;
+        case LineChecker::Action::kOk: {
+          const std::string ok = make_ok();
+          lock.unlock();
+          send(ok);
+          return;
+        }
+        case LineChecker::Action::kDrop:
+          return;
+        default:
+          break;
+      }
+      queue_.emplace_back(view);
+      cv_.notify_all();
+      if (queue_.size() < kSlots) {
+        const std::string ok = make_ok();
+        lock.unlock();
+        send(ok);
+      }
+    }
+
+    /**
+     * @brief gcode_task
+     *
+     */
+    void work() {
+      while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !queue_.empty(); });
+        const std::string cmd = queue_.front();
+        lock.unlock();
+
+        std::this_thread::sleep_for(kCommandTime);
+        if (cmd.compare(0, 2, "A0") == 0) {
+          const auto s = cmd.find('S');
+          std::lock_guard<std::mutex> exec_lock(mutex_);
+          executed_.push_back(s == std::string::npos ? -1 : strtol(cmd.c_str() + s + 1, nullptr, 10));
+        } else if (cmd.compare(0, 2, "A7") == 0) {
+          advanced_ = cmd.find("S1") != std::string::npos;
+          send(std::string("Advanced ok: ") + (advanced_ ? "1" : "0"));
+        }
+        send(cmd);
+
+        lock.lock();
+        const bool need_ok = queue_.size() == kSlots;
+        queue_.pop_front();
+        if (need_ok) {
+          const std::string ok = make_ok();
+          lock.unlock();
+          send(ok);
+        }
+      }
+    }
+
+    int fd_;
+    std::bernoulli_distribution noise_;
+    std::mutex mutex_, tx_mutex_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    std::vector<long> executed_;
+    LineChecker checker_;
+    std::atomic<bool> advanced_{ false };
+  };
+
+  void print_stats(const Stats& stats) {
+    printf("lines:    %u in %.2f s, %.1f lines/s\n", stats.lines, stats.seconds, stats.lines / stats.seconds);
+    printf("sent:     %u\n", stats.sent);
+    printf("resends:  %u\n", stats.resends);
+    printf("timeouts: %u\n", stats.timeouts);
+  }
+
+  int run_sim(unsigned count, double error_rate) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return 1;
+    auto sim = new Simulator(fds[1], error_rate);
+    Link link(fds[0], kTimeout, true);
+
+    unsigned i{ 0 };
+    Stats stats;
+    const bool ok = stream(
+        link,
+        [&](std::string& cmd) {
+          if (i == count) return false;
+          cmd = "A0 S" + std::to_string(i++);
+          return true;
+        },
+        stats);
+    print_stats(stats);
+
+    // every command once, in order
+    const auto executed = sim->get_executed();
+    size_t wrong{ 0 };
+    for (size_t j = 0; j < count; ++j) {
+      wrong += j >= executed.size() || executed[j] != static_cast<long>(j);
+    }
+    printf("run:      %zu of %u, %zu wrong\n", executed.size(), count, wrong);
+    return ok && executed.size() == count && wrong == 0 ? 0 : 1;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " /dev/ttyACM0 [file] | --sim [count] [error rate]\n";
+    return 1;
+  }
+  if (strcmp(argv[1], "--sim") == 0) {
+    return run_sim(argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000, argc > 3 ? strtod(argv[3], nullptr) : 0.002);
+  }
+
+  const int fd = serial::open_serial(argv[1]);
+  if (fd < 0) {
+    std::cerr << "Couldn't open " << argv[1] << "\n";
+    return 1;
+  }
+  std::ifstream file;
+  if (argc > 2) file.open(argv[2]);
+  std::istream& in = argc > 2 ? file : std::cin;
+
+  Link link(fd, kTimeout, true);
+  Stats stats;
+  const bool ok = stream(
+      link,
+      [&](std::string& cmd) {
+        while (std::getline(in, cmd)) {
+          if (!cmd.empty()) return true;
+        }
+        return false;
+      },
+      stats);
+  print_stats(stats);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#ifndef HOST_CYCLES_H_
+#define HOST_CYCLES_H_
+
+/** @file host_cycles.h
+ * Cycle counter of the host, shared by the host benchmarks
+ */
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+namespace host {
+
+  /**
+   * @brief CPU cycles, or ns where there is no cycle counter
+   *
+   */
+  inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+
+}  // namespace host
+
+#endif  // HOST_CYCLES_H_
@@ -0,0 +1,210 @@
+/**
+ * @file log_decoder.cpp
+ * @brief Host tool, restores deferred log records into text
+ *
+ * Reads the format strings from the log_fmt section of the firmware ELF, then copies the UART capture to stdout.
+ * Text is passed through, deferred log records are formatted and printed as lines, A16 trace records are skipped.
+ *
+ * Build: g++ -std=c++17 -O2 -o log_decoder tools/log_decoder.cpp
+ * Usage: log_decoder .pio/build/nucleo_f303k8/firmware.elf [capture.bin]
+ * Without a capture file, stdin is read, so it can be used in a pipe with the serial port.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+  constexpr uint8_t kLogMarker = 0x1E;    //!< Same as Uart::kLogMarker
+  constexpr uint8_t kTraceMarker = 0x1D;  //!< Same as Uart::kTraceMarker
+  constexpr size_t kMaxLogArgs = 8;       //!< Same as Uart::kMaxLogArgs
+  constexpr char kSectionName[] = "log_fmt";
+
+  template <class T>
+  T read_le(const std::vector<uint8_t>& data, size_t offset) {
+    T val{ 0 };
+    if (offset + sizeof(T) <= data.size()) {
+      memcpy(&val, data.data() + offset, sizeof(T));
+    }
+    return val;
+  }
+
+  /**
+   * @brief Loads the contents of the log_fmt section from a 32 bit little endian ELF
+   *
+   * @param path path to ELF
+   * @param section contents of the section
+   * @return true on success
+   */
+  bool load_section(const std::string& path, std::vector<uint8_t>& section) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    const std::vector<uint8_t> elf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (elf.size() < 52 || memcmp(elf.data(), "\x7f" "ELF", 4) != 0 || elf[4] != 1 || elf[5] != 1) {
+      std::cerr << "Not a 32 bit little endian ELF\n";
+      return false;
+    }
+
+    const auto shoff = read_le<uint32_t>(elf, 32);
+    const auto shentsize = read_le<uint16_t>(elf, 46);
+    const auto shnum = read_le<uint16_t>(elf, 48);
+    const auto shstrndx = read_le<uint16_t>(elf, 50);
+
+    auto section_offset = [&](size_t i) { return read_le<uint32_t>(elf, shoff + i * shentsize + 16); };
+    auto section_size = [&](size_t i) { return read_le<uint32_t>(elf, shoff + i * shentsize + 20); };
+    const size_t names = section_offset(shstrndx);
+
+    for (size_t i = 0; i < shnum; ++i) {
+      const size_t name = names + read_le<uint32_t>(elf, shoff + i * shentsize);
+      if (name >= elf.size()) continue;
+      if (strncmp(reinterpret_cast<const char*>(elf.data() + name), kSectionName, elf.size() - name) == 0) {
+        const size_t begin = section_offset(i), size = section_size(i);
+        if (begin + size > elf.size()) return false;
+        section.assign(elf.begin() + begin, elf.begin() + begin + size);
+        return true;
+      }
+    }
+    std::cerr << "Section " << kSectionName << " not found\n";
+    return false;
+  }
+
+  /**
+   * @brief printf-like formatting, where every argument is a 32 bit word
+   *
+   * @param fmt format string
+   * @param args arguments, floating point values are stored as float
+   * @return std::string formatted text
+   */
+  std::string format(const char* fmt, const std::vector<uint32_t>& args) {
+    std::string out;
+    size_t arg = 0;
+    char buff[64];
+
+    while (*fmt) {
+      if (*fmt != '%') {
+        out += *fmt++;
+        continue;
+      }
+      if (fmt[1] == '%') {
+        out += '%';
+        fmt += 2;
+        continue;
+      }
+
+      // copy the conversion specification without length modifiers
+      std::string spec{ '%' };
+      ++fmt;
+      while (*fmt && strchr("-+ #0123456789.", *fmt)) spec += *fmt++;
+      while (*fmt && strchr("hlLqjzt", *fmt)) ++fmt;
+      if (!*fmt) break;
+      const char conv = *fmt++;
+      spec += conv;
+
+      const uint32_t word = arg < args.size() ? args[arg++] : 0;
+      switch (conv) {
+        case 'd':
+        case 'i':
+          snprintf(buff, sizeof(buff), spec.c_str(), static_cast<int32_t>(word));
+          break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+          snprintf(buff, sizeof(buff), spec.c_str(), word);
+          break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G': {
+          float f;
+          memcpy(&f, &word, sizeof(f));
+          snprintf(buff, sizeof(buff), spec.c_str(), static_cast<double>(f));
+          break;
+        }
+        default:
+          snprintf(buff, sizeof(buff), "<%%%c?>", conv);
+          break;
+      }
+      out += buff;
+    }
+    return out;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " firmware.elf [capture.bin]\n";
+    return 1;
+  }
+
+  std::vector<uint8_t> formats;
+  if (!load_section(argv[1], formats)) {
+    std::cerr << "Couldn't load formats from " << argv[1] << "\n";
+    return 1;
+  }
+
+  std::ifstream capture_file;
+  if (argc > 2) {
+    capture_file.open(argv[2], std::ios::binary);
+    if (!capture_file) {
+      std::cerr << "Couldn't open " << argv[2] << "\n";
+      return 1;
+    }
+  }
+  std::istream& in = argc > 2 ? capture_file : std::cin;
+
+  auto get = [&in](uint8_t& c) {
+    char ch;
+    if (!in.get(ch)) return false;
+    c = static_cast<uint8_t>(ch);
+    return true;
+  };
+
+  uint8_t c;
+  while (get(c)) {
+    if (c == kTraceMarker) {
+      // A16 trace records, converted by trace2chrome
+      uint8_t len, skipped;
+      if (!get(len)) break;
+      while (len && get(skipped)) --len;
+      continue;
+    }
+    if (c != kLogMarker) {
+      std::cout.put(static_cast<char>(c));
+      continue;
+    }
+
+    uint8_t hdr[3];
+    if (!get(hdr[0]) || !get(hdr[1]) || !get(hdr[2])) break;
+    const uint16_t id = hdr[0] | (hdr[1] << 8);
+    const size_t n = hdr[2];
+    if (n > kMaxLogArgs || id >= formats.size()) {
+      std::cout << "<bad log record>\n";
+      continue;
+    }
+
+    std::vector<uint32_t> args(n);
+    for (auto& arg : args) {
+      uint8_t b[4];
+      if (!get(b[0]) || !get(b[1]) || !get(b[2]) || !get(b[3])) return 0;
+      arg = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    }
+
+    std::string fmt(reinterpret_cast<const char*>(formats.data() + id),
+                    strnlen(reinterpret_cast<const char*>(formats.data() + id), formats.size() - id));
+    std::cout << format(fmt.c_str(), args) << "\n";
+    std::cout.flush();
+  }
+  return 0;
+}
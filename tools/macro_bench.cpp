@@ -0,0 +1,170 @@
+/**
+ * @file macro_bench.cpp
+ * @brief Host tool, measures a sequence of commands streamed by the host, and replayed by a macro on the device
+ *
+ * Streaming sends a command, and waits for its echo, which is sent after the command ran. The macro is recorded once
+ * with A11, then A12 runs it L times, and the host waits for the one echo of A12. Both run the same LED toggles.
+ * Deferred logging must be disabled, the echoes are parsed as text.
+ *
+ * Build: g++ -std=c++17 -O2 -o macro_bench tools/macro_bench.cpp
+ * Usage: macro_bench /dev/ttyACM0 [count]
+ *        macro_bench --sim [count]    prints the times of a model of the link and the firmware, no hardware needed
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "serial_link.h"
+
+namespace {
+
+  using serial::kTxPrefix;
+  using serial::Link;
+
+  constexpr int kTimeout = 2000;         //!< Max wait for a reply in ms
+  constexpr char kMacro[] = "bench";     //!< Name of the recorded macro
+  constexpr unsigned kMaxLoops = 10000;  //!< Range of L of A12
+
+  /**
+   * @brief The commands of the benchmark, toggle the LED, the macro runs them count / size times
+   *
+   */
+  const std::vector<std::string> kBody = { "A1", "A0" };
+
+  /**
+   * @brief Sends \p cmd, and waits for its echo, the other lines are skipped
+   *
+   * @return true if the echo arrived
+   */
+  bool run(Link& link, const std::string& cmd) {
+    link.write_line(cmd);
+    std::string line;
+    while (link.read_line(line)) {
+      if (line == kTxPrefix + cmd) return true;
+      if (line.find("Error") != std::string::npos) std::cerr << line << "\n";
+    }
+    std::cerr << "No echo of " << cmd << "\n";
+    return false;
+  }
+
+  /**
+   * @brief Milliseconds since \p start
+   *
+   */
+  double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  /**
+   * @brief The A12 line, which runs the macro \p loops times
+   *
+   */
+  std::string run_command(unsigned loops) {
+    return "A12 S\"" + std::string(kMacro) + "\" L" + std::to_string(loops);
+  }
+
+  /**
+   * @brief Streams \p count commands, then runs them as a macro, prints both times
+   *
+   * @return int exit code
+   */
+  int measure(Link& link, unsigned count) {
+    const unsigned loops = count / kBody.size();
+    if (!run(link, "A11 S\"" + std::string(kMacro) + "\"")) return 1;
+    for (const auto& cmd : kBody) {
+      if (!run(link, cmd)) return 1;
+    }
+    if (!run(link, "A11")) return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < loops; ++i) {
+      for (const auto& cmd : kBody) {
+        if (!run(link, cmd)) return 1;
+      }
+    }
+    const double stream = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    if (!run(link, run_command(loops))) return 1;
+    const double macro = elapsed_ms(start);
+
+    run(link, "A13 S\"" + std::string(kMacro) + "\" D");
+    const unsigned cmds = loops * kBody.size();
+    printf("%u commands\n", cmds);
+    printf("streaming: %9.2f ms %9.1f commands/s\n", stream, cmds / stream * 1000);
+    printf("macro:     %9.2f ms %9.1f commands/s\n", macro, cmds / macro * 1000);
+    printf("speedup:   %9.2fx\n", stream / macro);
+    return 0;
+  }
+
+  /**
+   * @brief Model of the link and the firmware, in virtual time
+   *
+   * 115200 baud, an USB serial bridge, which adds 1 ms in each direction, and the time of gcode_task to parse and run
+   * a command. Streaming costs a round trip per command, the macro one round trip, and the expansion of every line.
+   */
+  struct Model {
+    static constexpr double kCharTime = 0.087;    //!< One byte at 115200 baud, ms
+    static constexpr double kUsbLatency = 1;      //!< USB bridge, each direction, ms
+    static constexpr double kCommandTime = 0.05;  //!< Parsing and running a gcode, ms
+    static constexpr double kExpandTime = 0.01;   //!< Substituting the arguments of a macro line, ms
+
+    /**
+     * @brief Time of \p cmd from sending it to reading its echo, with \p work ms on the device
+     *
+     */
+    static double round_trip(const std::string& cmd, double work) {
+      const size_t echo = sizeof(kTxPrefix) - 1 + cmd.size() + 1;
+      return kUsbLatency + (cmd.size() + 1) * kCharTime + work + echo * kCharTime + kUsbLatency;
+    }
+
+    /**
+     * @brief Prints the times of \p count commands
+     *
+     * @return int exit code
+     */
+    static int print(unsigned count) {
+      const unsigned loops = count / kBody.size();
+      double stream{ 0 };
+      for (unsigned i = 0; i < loops; ++i) {
+        for (const auto& cmd : kBody) stream += round_trip(cmd, kCommandTime);
+      }
+      const unsigned cmds = loops * kBody.size();
+      const double macro = round_trip(run_command(loops), kCommandTime + cmds * (kExpandTime + kCommandTime));
+      printf("%u commands, model\n", cmds);
+      printf("streaming: %9.2f ms %9.1f commands/s\n", stream, cmds / stream * 1000);
+      printf("macro:     %9.2f ms %9.1f commands/s\n", macro, cmds / macro * 1000);
+      printf("speedup:   %9.2fx\n", stream / macro);
+      return 0;
+    }
+  };
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " /dev/ttyACM0|--sim [count]\n";
+    return 1;
+  }
+  const unsigned count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 500;
+  if (count < kBody.size() || count / kBody.size() > kMaxLoops) {
+    std::cerr << "count shall be " << kBody.size() << " to " << kMaxLoops * kBody.size() << "\n";
+    return 1;
+  }
+  if (strcmp(argv[1], "--sim") == 0) {
+    return Model::print(count);
+  }
+
+  const int fd = serial::open_serial(argv[1]);
+  if (fd < 0) {
+    std::cerr << "Couldn't open " << argv[1] << "\n";
+    return 1;
+  }
+  Link link(fd, kTimeout);
+  return measure(link, count);
+}
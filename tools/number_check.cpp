@@ -0,0 +1,188 @@
+/**
+ * @file number_check.cpp
+ * @brief Host tool, checks the number conversion of the Parser against the standard library, and compares the speed
+ *
+ * Random integers and decimals, with up to 9 significant digits, are converted by the Parser and by strtol/strtod.
+ * int32 and fixed-point values must match exactly, floats within 1 ulp of the correctly rounded value. Values out of
+ * range must saturate. The speed is the cycles per conversion of a whole command with one parameter, against the
+ * same command scanned with strtol or strtof.
+ *
+ * Build: g++ -std=c++17 -O2 -Iinclude -o number_check tools/number_check.cpp src/parser.cpp
+ * Usage: number_check [count]
+ */
+
+#include <cinttypes>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "host_cycles.h"
+#include "parser.h"
+
+namespace {
+
+  /**
+   * @brief Distance of two floats in units of the last place
+   *
+   */
+  int64_t ulp_distance(float a, float b) {
+    int32_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    // make the order of the bit patterns monotonic across 0
+    if (ia < 0) ia = INT32_MIN - ia;
+    if (ib < 0) ib = INT32_MIN - ib;
+    return std::llabs(int64_t(ia) - ib);
+  }
+
+  /**
+   * @brief A random number: sign, up to 9 significant digits, and a decimal point somewhere
+   *
+   */
+  std::string random_number(std::mt19937& rng) {
+    std::string str;
+    if (rng() % 2) str += '-';
+    const unsigned digits = 1 + rng() % 9;
+    const unsigned point = rng() % (digits + 2);  // == digits: integer, > digits: trailing point
+    for (unsigned i = 0; i < digits; ++i) {
+      if (i == point && i != 0) str += '.';
+      str += char('0' + rng() % 10);
+    }
+    if (point == digits + 1) str += '.';
+    return str;
+  }
+
+  /**
+   * @brief Exact decimal reference of Parser::get_fixed(): \p num * 10^decimals, rounded half away from zero
+   *
+   */
+  int64_t round_fixed(const std::string& num, unsigned decimals) {
+    int64_t mantissa{ 0 };
+    int fraction{ -1 };  // digits after the point
+    for (const char c : num) {
+      if (c == '.') {
+        fraction = 0;
+      } else if (c != '-') {
+        mantissa = mantissa * 10 + (c - '0');
+        if (fraction >= 0) ++fraction;
+      }
+    }
+    for (int shift = std::max(fraction, 0); shift < int(decimals); ++shift) mantissa *= 10;
+    for (int shift = int(decimals); shift < fraction; ++shift) mantissa = (mantissa + (shift + 1 == fraction ? 5 : 0)) / 10;
+    return num[0] == '-' ? -mantissa : mantissa;
+  }
+
+  int check(unsigned count) {
+    std::mt19937 rng(1234);
+    Parser parser;
+    unsigned failed{ 0 };
+    int64_t max_ulp{ 0 };
+    const auto fail = [&failed](const std::string& line, const char* what) {
+      if (++failed <= 10) printf("FAIL %-24s %s\n", line.c_str(), what);
+    };
+
+    for (unsigned i = 0; i < count; ++i) {
+      const std::string num = random_number(rng);
+      const std::string line = "A1 S" + num;
+      parser.set_string(line.c_str());
+      const long double exact = strtold(num.c_str(), nullptr);
+
+      int32_t i32{ 0 };
+      parser.get_parameter('S', i32);
+      if (i32 != static_cast<int32_t>(std::trunc(exact))) fail(line, "int32");
+
+      float f{ 0 };
+      parser.get_parameter('S', f);
+      const int64_t ulp = ulp_distance(f, strtof(num.c_str(), nullptr));
+      max_ulp = std::max(max_ulp, ulp);
+      if (ulp > 1) fail(line, "float");
+
+      const unsigned decimals = rng() % 7;
+      const int64_t expected = round_fixed(num, decimals);
+      int32_t fixed{ 0 };
+      parser.get_fixed('S', fixed, decimals);
+      if (expected >= INT32_MIN && expected <= INT32_MAX && fixed != expected) fail(line, "fixed");
+    }
+
+    // saturation, and integers wider than the mantissa
+    const struct {
+      const char* line;
+      int32_t expected;
+    } edges[] = {
+      { "A1 S2147483647", INT32_MAX },         { "A1 S-2147483648", INT32_MIN },
+      { "A1 S2147483648", INT32_MAX },         { "A1 S-2147483649", INT32_MIN },
+      { "A1 S99999999999999", INT32_MAX },     { "A1 S-99999999999999", INT32_MIN },
+      { "A1 S0.000000000001", 0 },             { "A1 S1234567890", 1234567890 },
+    };
+    for (const auto& edge : edges) {
+      int32_t val{ 0 };
+      parser.set_string(edge.line);
+      parser.get_parameter('S', val);
+      if (val != edge.expected) fail(edge.line, "saturation");
+    }
+
+    printf("%u random numbers, %u failed, max float error %" PRId64 " ulp\n", count, failed, max_ulp);
+    return failed != 0;
+  }
+
+  /**
+   * @brief Converts every line \p count times
+   *
+   * @return double cycles per line
+   */
+  template <class F>
+  double time_lines(const std::string* lines, size_t n, unsigned count, F&& convert) {
+    volatile double sink{ 0 };
+    const uint64_t start = host::cycles();
+    for (unsigned i = 0; i < count; ++i) {
+      sink = sink + convert(lines[i % n].c_str());
+    }
+    return double(host::cycles() - start) / count;
+  }
+
+  void bench(unsigned count) {
+    constexpr size_t kLines = 64;
+    std::mt19937 rng(42);
+    std::string ints[kLines], decimals[kLines];
+    for (size_t i = 0; i < kLines; ++i) {
+      ints[i] = "A1 S" + std::to_string(int32_t(rng() % 200000) - 100000);
+      decimals[i] = "A1 S" + std::to_string(int32_t(rng() % 200000) - 100000) + "." + std::to_string(rng() % 1000);
+    }
+
+    Parser parser;
+    const double p_int = time_lines(ints, kLines, count, [&](const char* line) {
+      parser.set_string(line);
+      int32_t val{ 0 };
+      parser.get_parameter('S', val);
+      return double(val);
+    });
+    const double s_int = time_lines(ints, kLines, count, [](const char* line) {
+      return double(strtol(strchr(line, 'S') + 1, nullptr, 10));
+    });
+    const double p_float = time_lines(decimals, kLines, count, [&](const char* line) {
+      parser.set_string(line);
+      float val{ 0 };
+      parser.get_parameter('S', val);
+      return double(val);
+    });
+    const double s_float = time_lines(decimals, kLines, count, [](const char* line) {
+      return double(strtof(strchr(line, 'S') + 1, nullptr));
+    });
+
+    printf("%-10s %12s %12s\n", "value", "parser", "stdlib");
+    printf("%-10s %12.1f %12.1f  cycles/command\n", "int32", p_int, s_int);
+    printf("%-10s %12.1f %12.1f  cycles/command\n", "float", p_float, s_float);
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const unsigned count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  const int result = check(count);
+  bench(count);
+  return result;
+}
@@ -0,0 +1,300 @@
+/**
+ * @file packed_ring_bench.cpp
+ * @brief Host tool, multi producer stress test, throughput and contention benchmark of PackedRingBuffer
+ *
+ * The stress test runs N producer threads and one consumer thread on one buffer, like the tasks and ISRs, which
+ * queue UART output, and the TX DMA complete ISR. Every record holds the producer, a sequence number and bytes
+ * derived from both, its length varies, and some reservations are pushed shorter, or discarded with length 0. Some
+ * producers yield before the commit, so records are pushed out of order. The consumer sees a torn, lost, repeated or
+ * reordered record of each producer. Run it built with -fsanitize=thread too, which reports the data races, that the
+ * commit tags shall prevent.
+ *
+ * The benchmark first moves lines through the buffer by one thread, against the fixed 30 byte slots, which the TX
+ * buffer had before, and counts the lines each one holds. Then it moves records from N producers to the consumer,
+ * once lock-free, once with the reservation, write and commit of the producers in a std::mutex. On the Cortex-M4
+ * that is a critical section, which is cheaper, but delays every interrupt of the same or lower priority. On one core
+ * the threads contend only when they are preempted, like the tasks on the target.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread -Iinclude -o packed_ring_bench tools/packed_ring_bench.cpp
+ *        g++ -std=c++17 -O1 -g -fsanitize=thread -pthread -Iinclude -o packed_ring_tsan tools/packed_ring_bench.cpp
+ * Usage: packed_ring_bench [records]
+ *        packed_ring_bench --slots [records]     only the one thread benchmark
+ *        packed_ring_bench --stress [records]    exit code 1 on the first wrong record
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "packed_ring_buffer.h"
+#include "ring_buffer.h"
+
+namespace {
+
+  constexpr size_t kBufferSize = 256;  //!< Same as Uart::kTxBufferSize
+  constexpr size_t kMaxProducers = 8;  //!< Most producer threads
+  constexpr size_t kHeader = 5;        //!< Producer and sequence number in front of a record
+
+  constexpr size_t kSlotLen = 30;      //!< Slot of the TX buffer before it was packed
+  constexpr size_t kSlots = 5;         //!< Slots of the TX buffer before it was packed
+
+  using Buffer = PackedRingBuffer<kBufferSize>;
+  using Slots = RingBuffer<std::array<char, kSlotLen>, kSlots>;
+
+  /**
+   * @brief How the producers write
+   *
+   */
+  enum class Mode {
+    kLockFree,   //!< Lock-free, as fast as they can
+    kPreempted,  //!< Lock-free, some yield before the commit, like a preempted task
+    kCritical,   //!< In a critical section, like the TX buffer before it was lock-free
+  };
+
+  /**
+   * @brief Length of the record \p seq of producer \p id, 5 to 68 bytes
+   *
+   */
+  size_t record_len(uint8_t id, uint32_t seq) {
+    return kHeader + (seq * 7 + id * 13) % 64;
+  }
+
+  /**
+   * @brief Byte \p i of the record \p seq of producer \p id, after the header
+   *
+   */
+  uint8_t record_byte(uint8_t id, uint32_t seq, size_t i) {
+    return static_cast<uint8_t>(seq * 31 + id * 101 + i);
+  }
+
+  /**
+   * @brief Writes the record \p seq of producer \p id into \p ptr
+   *
+   */
+  void fill(uint8_t* ptr, uint8_t id, uint32_t seq, size_t len) {
+    ptr[0] = id;
+    memcpy(ptr + 1, &seq, sizeof(seq));
+    for (size_t i = kHeader; i < len; ++i) ptr[i] = record_byte(id, seq, i);
+  }
+
+  /**
+   * @brief Producer, the reservation is 8 bytes too long every 4th record, and every 16th one is discarded
+   *
+   * @param mutex the critical section of Mode::kCritical
+   * @return true if the record \p seq was pushed, false if there was no space, or it was discarded
+   */
+  bool put(Buffer& buff, Mode mode, std::mutex& mutex, uint8_t id, uint32_t seq, uint32_t& attempt) {
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    if (mode == Mode::kCritical) lock.lock();
+    const size_t len = record_len(id, seq);
+    const size_t reserve = attempt % 4 == 0 ? len + 8 : len;
+    uint8_t* ptr = buff.get_next_free(reserve);
+    if (ptr == nullptr) return false;
+    if (++attempt % 16 == 0) {
+      buff.push(ptr, 0);
+      return false;
+    }
+    fill(ptr, id, seq, len);
+    // the records reserved after this one are pushed first
+    if (mode == Mode::kPreempted && attempt % 8 == 3) std::this_thread::yield();
+    buff.push(ptr, len);
+    return true;
+  }
+
+  /**
+   * @brief Consumer, checks every record against the next sequence number of its producer
+   *
+   * @param next next sequence number of each producer
+   * @return true if the record is intact and in order
+   */
+  bool check(const uint8_t* ptr, size_t len, std::vector<uint32_t>& next) {
+    if (len < kHeader || ptr[0] >= next.size()) {
+      fprintf(stderr, "bad record, length %zu\n", len);
+      return false;
+    }
+    const uint8_t id = ptr[0];
+    uint32_t seq;
+    memcpy(&seq, ptr + 1, sizeof(seq));
+    if (seq != next[id]) {
+      fprintf(stderr, "producer %u: expected %u, got %u\n", id, next[id], seq);
+      return false;
+    }
+    if (len != record_len(id, seq)) {
+      fprintf(stderr, "producer %u, record %u: length %zu, expected %zu\n", id, seq, len, record_len(id, seq));
+      return false;
+    }
+    for (size_t i = kHeader; i < len; ++i) {
+      if (ptr[i] != record_byte(id, seq, i)) {
+        fprintf(stderr, "producer %u, record %u: torn at byte %zu\n", id, seq, i);
+        return false;
+      }
+    }
+    ++next[id];
+    return true;
+  }
+
+  /**
+   * @brief \p producers threads move \p count records each through \p buff, the calling thread consumes them
+   *
+   * @return true if every record arrived once, in order and intact
+   */
+  bool run(Buffer& buff, Mode mode, size_t producers, uint32_t count) {
+    buff.reset();
+    std::mutex mutex;
+    std::atomic<bool> stop{ false };  // a wrong record was found
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+      threads.emplace_back([&buff, &mutex, &stop, mode, p, count] {
+        const uint8_t id = static_cast<uint8_t>(p);
+        uint32_t attempt{ 0 };
+        for (uint32_t seq = 0; seq < count && !stop;) {
+          if (put(buff, mode, mutex, id, seq, attempt)) {
+            ++seq;
+          } else {
+            std::this_thread::yield();  // on one core, the consumer shall run
+          }
+        }
+      });
+    }
+
+    std::vector<uint32_t> next(producers, 0);
+    bool ok{ true };
+    for (uint64_t received = 0; ok && received < uint64_t{ count } * producers;) {
+      size_t len{ 0 };
+      const uint8_t* ptr = buff.get_next_occupied(len);
+      if (ptr == nullptr) {
+        std::this_thread::yield();
+        continue;
+      }
+      ok = check(ptr, len, next);
+      buff.pop();
+      ++received;
+    }
+    stop = true;
+    for (auto& t : threads) t.join();
+    return ok && buff.is_empty();
+  }
+
+  /**
+   * @brief Queues lines of \p len bytes into \p slots, until it is full, then sends them, \p count lines
+   *
+   * @return double ns per line
+   */
+  double single_thread(Slots& slots, size_t len, uint32_t count) {
+    char line[kSlotLen]{};
+    uint32_t sum{ 0 };
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t sent = 0; sent < count;) {
+      while (auto ptr = slots.get_next_free()) {
+        line[0] = static_cast<char>(sent);
+        memcpy(ptr->data(), line, len);
+        slots.push();
+      }
+      while (auto ptr = slots.get_next_occupied()) {
+        sum += (*ptr)[0];
+        slots.pop();
+        ++sent;
+      }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    if (sum == 1) puts("");  // keeps the reads
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  }
+
+  /**
+   * @brief Same as single_thread(Slots&, size_t, uint32_t) with the packed buffer
+   *
+   */
+  double single_thread(Buffer& buff, size_t len, uint32_t count) {
+    uint8_t line[kSlotLen]{};
+    uint32_t sum{ 0 };
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t sent = 0; sent < count;) {
+      while (auto ptr = buff.get_next_free(len)) {
+        line[0] = static_cast<uint8_t>(sent);
+        memcpy(ptr, line, len);
+        buff.push(ptr, len);
+      }
+      size_t out_len{ 0 };
+      while (auto ptr = buff.get_next_occupied(out_len)) {
+        sum += ptr[0];
+        buff.pop();
+        ++sent;
+      }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    if (sum == 1) puts("");  // keeps the reads
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  }
+
+  /**
+   * @brief Prints the time per line and the capacity of the fixed slots and the packed buffer
+   *
+   */
+  void compare_slots(uint32_t count) {
+    static Slots slots;
+    static Buffer buff;
+    printf("one thread, %u lines, ns per line, lines held\n", count);
+    printf("%6s %10s %10s %8s %8s\n", "bytes", "slots", "packed", "slots", "packed");
+    for (const size_t len : { 3, 9, 20, 29 }) {
+      slots.reset();
+      buff.reset();
+      const double slots_ns = single_thread(slots, len, count), packed_ns = single_thread(buff, len, count);
+      size_t held{ 0 };
+      while (auto ptr = buff.get_next_free(len)) {
+        buff.push(ptr, len);
+        ++held;
+      }
+      printf("%6zu %10.2f %10.2f %8zu %8zu\n", len, slots_ns, packed_ns, kSlots, held);
+    }
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const bool is_stress = argc > 1 && strcmp(argv[1], "--stress") == 0;
+  const bool is_slots = argc > 1 && strcmp(argv[1], "--slots") == 0;
+  const char* count_arg = is_stress || is_slots ? (argc > 2 ? argv[2] : nullptr) : (argc > 1 ? argv[1] : nullptr);
+  const uint32_t count = count_arg ? strtoul(count_arg, nullptr, 10) : 1000000;
+  if (count == 0) {
+    fprintf(stderr, "Usage: %s [--slots | --stress] [records]\n", argv[0]);
+    return 1;
+  }
+
+  static Buffer buff;
+  if (is_stress) {
+    bool ok{ true };
+    for (size_t producers = 1; producers <= kMaxProducers; producers *= 2) {
+      const bool res = run(buff, Mode::kPreempted, producers, count);
+      printf("%zu producers %10u records each %s\n", producers, count, res ? "ok" : "FAILED");
+      ok = ok && res;
+    }
+    return ok ? 0 : 1;
+  }
+
+  compare_slots(count);
+  if (is_slots) return 0;
+
+  printf("\n%u records per producer, %zu to %zu bytes, million records per s\n", count, kHeader, kHeader + 63);
+  printf("%9s %12s %12s %9s\n", "producers", "critical", "lock-free", "speedup");
+  for (size_t producers = 1; producers <= kMaxProducers; producers *= 2) {
+    double rate[2];
+    for (const Mode mode : { Mode::kCritical, Mode::kLockFree }) {
+      const auto start = std::chrono::steady_clock::now();
+      if (!run(buff, mode, producers, count)) {
+        fprintf(stderr, "wrong record\n");
+        return 1;
+      }
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      rate[mode == Mode::kCritical] = count * producers / std::chrono::duration<double, std::micro>(elapsed).count();
+    }
+    printf("%9zu %12.2f %12.2f %8.2fx\n", producers, rate[1], rate[0], rate[0] / rate[1]);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file parser_bench.cpp
+ * @brief Host tool, cycles per command of the Parser, and of the previous parser, which scanned the line on every
+ * lookup
+ *
+ * A command is set_string() and the 7 lookups of A2. The typical line sets 3 of them. The worst case line is nearly
+ * as long as Uart::kMsgLen allows, it sets all 7 in reverse order, so every search goes far. The last line has no
+ * lookup hits.
+ *
+ * Build: g++ -std=c++17 -O2 -Iinclude -o parser_bench tools/parser_bench.cpp src/parser.cpp
+ * Usage: parser_bench [iterations]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "host_cycles.h"
+#include "parser.h"
+
+namespace {
+
+  /**
+   * @brief The previous parser: remembers the string, get_parameter() searches it and converts with atoi
+   *
+   */
+  class ScanningParser {
+  public:
+    void set_string(const char* str) {
+      str_ = str;
+      str_sz_ = strlen(str);
+    }
+
+    char get_prefix() const {
+      return str_[first_not_whitespace()];
+    }
+
+    uint16_t get_number() const {
+      return atoi(str_ + first_not_whitespace() + 1);
+    }
+
+    bool get_parameter(char param, int16_t& dest, int16_t def = 0) const {
+      dest = def;
+      const auto end = str_ + str_sz_;
+      const auto place = std::find(str_, end, param);
+      if (place == end) return false;
+      if (*(place + 1) == '\0' || *(place + 1) < '0' || *(place + 1) > '9') return true;
+      dest = atoi(place + 1);
+      return true;
+    }
+
+  private:
+    size_t first_not_whitespace() const {
+      size_t ind = 0;
+      while (str_[ind] == ' ' || str_[ind] == '\n' || str_[ind] == '\r') ++ind;
+      return ind;
+    }
+
+    const char* str_{ nullptr };
+    size_t str_sz_{ 0 };
+  };
+
+  /**
+   * @brief Parses \p line and reads the parameters of A2, \p count times
+   *
+   * @return double cycles per command
+   */
+  template <class P>
+  double run(const char* line, unsigned count) {
+    P parser;
+    volatile int32_t sink{ 0 };
+    const uint64_t start = host::cycles();
+    for (unsigned i = 0; i < count; ++i) {
+      parser.set_string(line);
+      int32_t sum = parser.get_prefix() + parser.get_number();
+      for (const char param : { 'S', 'M', 'H', 'W', 'D', 'O', 'Y' }) {
+        int16_t val{ 0 };
+        parser.get_parameter(param, val);
+        sum += val;
+      }
+      sink = sink + sum;
+    }
+    return double(host::cycles() - start) / count;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const unsigned count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  const char* const lines[] = { "A2 S30 M15 H12", "A2 Y22 O3 D17 W6 H12 M15 S30", "A2 Z1 X2 V3 U4 T5 R6 Q7 P8" };
+  const char* const names[] = { "typical", "worst case", "misses" };
+
+  printf("%-12s %12s %12s\n", "line", "scanning", "table");
+  for (size_t i = 0; i < 3; ++i) {
+    const double scanning = run<ScanningParser>(lines[i], count);
+    const double table = run<Parser>(lines[i], count);
+    printf("%-12s %12.1f %12.1f  cycles/command\n", names[i], scanning, table);
+  }
+  return 0;
+}
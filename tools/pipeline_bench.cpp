@@ -0,0 +1,300 @@
+/**
+ * @file pipeline_bench.cpp
+ * @brief Host tool, measures commands per second with stop-and-wait and with pipelined, credit based flow control
+ *
+ * Stop-and-wait sends a command, and waits for its ok. Pipelined enables the advanced ok with A7 S1, and keeps as
+ * many commands in flight, as the last "ok Q<free> N<line>" allows: lines after N, at most Q.
+ * Deferred logging must be disabled, the ok lines are parsed as text.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread -o pipeline_bench tools/pipeline_bench.cpp
+ * Usage: pipeline_bench /dev/ttyACM0 [count]
+ *        pipeline_bench --sim [count]    runs against a model of the firmware, no hardware needed
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "serial_link.h"
+
+namespace {
+
+  using serial::kTxPrefix;
+  using serial::Link;
+
+  /**
+   * @brief Checks if \p line is an ok, and parses the advanced ok fields
+   *
+   * @param q set to free RX slots, or 0 for a plain ok
+   * @param n set to the line count, or 0 for a plain ok
+   * @return true if it is an ok
+   */
+  bool parse_ok(std::string line, unsigned& q, unsigned& n) {
+    if (line.compare(0, sizeof(kTxPrefix) - 1, kTxPrefix) == 0) {
+      line.erase(0, sizeof(kTxPrefix) - 1);
+    }
+    if (line != "ok" && line.compare(0, 3, "ok ") != 0) return false;
+    q = n = 0;
+    sscanf(line.c_str(), "ok Q%u N%u", &q, &n);
+    return true;
+  }
+
+  /**
+   * @brief The command sent in the benchmark, toggles the LED
+   *
+   */
+  std::string command(unsigned i) {
+    return i % 2 ? "A1" : "A0";
+  }
+
+  /**
+   * @brief Sends a command, and waits for the ok, \p count times
+   *
+   * @return double commands per second, 0 on error
+   */
+  double stop_and_wait(Link& link, unsigned count) {
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+      link.write_line(command(i));
+      std::string line;
+      unsigned q, n;
+      do {
+        if (!link.read_line(line)) {
+          std::cerr << "Stop-and-wait: no ok for command " << i << "\n";
+          return 0;
+        }
+      } while (!parse_ok(line, q, n));
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return count / elapsed.count();
+  }
+
+  /**
+   * @brief Keeps as many commands in flight as the advanced ok allows
+   *
+   * @return double commands per second, 0 on error
+   */
+  double pipelined(Link& link, unsigned count) {
+    std::string line;
+    unsigned q{ 0 }, n{ 0 };
+
+    // enable, then sync the line count with a command, which is answered with an advanced ok
+    link.write_line("A7 S1");
+    while (link.read_line(line) && line.find("Advanced ok: 1") == std::string::npos) {
+    }
+    link.write_line("A7");
+    do {
+      if (!link.read_line(line)) {
+        std::cerr << "Pipelined: advanced ok not supported\n";
+        return 0;
+      }
+    } while (!parse_ok(line, q, n) || q == 0);
+
+    const unsigned base = n;
+    unsigned sent{ 0 }, acked{ 0 }, credit{ q };
+
+    const auto start = std::chrono::steady_clock::now();
+    while (acked < count) {
+      while (sent < count && sent - acked < credit) {
+        link.write_line(command(sent++));
+      }
+      if (!link.read_line(line)) {
+        std::cerr << "Pipelined: no ok after line " << base + acked << "\n";
+        return 0;
+      }
+      if (parse_ok(line, q, n) && n - base > acked) {
+        acked = n - base;
+        credit = q;
+      }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    link.write_line("A7 S0");
+    while (link.read_line(line, 100)) {
+    }
+    return count / elapsed.count();
+  }
+
+  /**
+   * @brief Model of the firmware: 5 RX slots, ok rules of the RX ISR and gcode_task, 115200 baud, 1 ms per command
+   *
+   * Commands reach the model 2 ms after they were sent, like the round trip through an USB serial bridge.
+   */
+  class Simulator {
+  public:
+    static constexpr size_t kSlots = 5;
+    static constexpr auto kCharTime = std::chrono::microseconds(87);
+    static constexpr auto kCommandTime = std::chrono::milliseconds(1);
+    static constexpr auto kLatency = std::chrono::milliseconds(2);
+
+    explicit Simulator(int fd) : fd_(fd), link_(fd) {
+      std::thread([this] { receive(); }).detach();
+      std::thread([this] { rx(); }).detach();
+      std::thread([this] { work(); }).detach();
+      std::thread([this] { tx(); }).detach();
+    }
+
+  private:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Queues a line, like the TX ring buffer
+     *
+     */
+    void send(const std::string& line) {
+      std::lock_guard<std::mutex> lock(tx_mutex_);
+      tx_queue_.push_back(kTxPrefix + line + "\n");
+      tx_cv_.notify_one();
+    }
+
+    /**
+     * @brief The TX DMA, sends the queued lines at 115200 baud
+     *
+     */
+    void tx() {
+      while (true) {
+        std::unique_lock<std::mutex> lock(tx_mutex_);
+        tx_cv_.wait(lock, [this] { return !tx_queue_.empty(); });
+        const std::string data = tx_queue_.front();
+        tx_queue_.pop_front();
+        lock.unlock();
+        std::this_thread::sleep_for(kCharTime * data.size());
+        ::write(fd_, data.data(), data.size());
+      }
+    }
+
+    /**
+     * @brief Formats the ok, call with mutex_ locked
+     *
+     */
+    std::string make_ok() const {
+      if (!advanced_) return "ok";
+      char buff[32];
+      snprintf(buff, sizeof(buff), "ok Q%zu N%u", kSlots - queue_.size(), lines_);
+      return buff;
+    }
+
+    /**
+     * @brief Reads the commands as they arrive, and timestamps them
+     *
+     */
+    void receive() {
+      std::string line;
+      while (link_.read_line(line, -1)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wire_.emplace_back(clock::now() + kLatency + kCharTime * (line.size() + 1), line);
+        cv_.notify_all();
+      }
+    }
+
+    /**
+     * @brief The RX ISR, queues the command, and acknowledges it if there is space left
+     *
+     */
+    void rx() {
+      while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !wire_.empty(); });
+        const auto [due, line] = wire_.front();
+        wire_.pop_front();
+        lock.unlock();
+        std::this_thread::sleep_until(due);
+
+        lock.lock();
+        if (queue_.size() == kSlots) continue;  // dropped
+        queue_.push_back(line);
+        ++lines_;
+        cv_.notify_all();
+        if (queue_.size() < kSlots) {
+          const std::string ok = make_ok();
+          lock.unlock();
+          send(ok);
+        }
+      }
+    }
+
+    /**
+     * @brief gcode_task, runs the command, and acknowledges if the queue was full
+     *
+     */
+    void work() {
+      while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !queue_.empty(); });
+        const std::string line = queue_.front();
+        lock.unlock();
+
+        std::this_thread::sleep_for(kCommandTime);
+        if (line.compare(0, 2, "A7") == 0) {
+          if (line.find("S1") != std::string::npos) advanced_ = true;
+          if (line.find("S0") != std::string::npos) advanced_ = false;
+          send(std::string("Advanced ok: ") + (advanced_ ? "1" : "0"));
+        }
+        send(line);
+
+        lock.lock();
+        const bool need_ok = queue_.size() == kSlots;
+        queue_.pop_front();
+        if (need_ok) {
+          const std::string ok = make_ok();
+          lock.unlock();
+          send(ok);
+        }
+      }
+    }
+
+    int fd_;
+    Link link_;
+    std::mutex mutex_, tx_mutex_;
+    std::condition_variable cv_, tx_cv_;
+    std::deque<std::string> tx_queue_;
+    std::deque<std::pair<clock::time_point, std::string>> wire_;
+    std::deque<std::string> queue_;
+    unsigned lines_{ 0 };
+    std::atomic<bool> advanced_{ false };
+  };
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " /dev/ttyACM0|--sim [count]\n";
+    return 1;
+  }
+  const unsigned count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 500;
+
+  int fd{ -1 };
+  if (strcmp(argv[1], "--sim") == 0) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return 1;
+    fd = fds[0];
+    new Simulator(fds[1]);
+  } else {
+    fd = serial::open_serial(argv[1]);
+    if (fd < 0) {
+      std::cerr << "Couldn't open " << argv[1] << "\n";
+      return 1;
+    }
+  }
+
+  Link link(fd);
+  const double saw = stop_and_wait(link, count);
+  const double pipe = pipelined(link, count);
+  printf("stop-and-wait: %8.1f commands/s\n", saw);
+  printf("pipelined:     %8.1f commands/s\n", pipe);
+  if (saw > 0) {
+    printf("speedup:       %8.2fx\n", pipe / saw);
+  }
+  return saw > 0 && pipe > 0 ? 0 : 1;
+}
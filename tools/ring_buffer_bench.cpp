@@ -0,0 +1,223 @@
+/**
+ * @file ring_buffer_bench.cpp
+ * @brief Host tool, measures push and pop of RingBuffer, against the previous implementation
+ *
+ * The previous RingBuffer had 8 bit positions, wrapped them with a modulo, and kept a flag to tell full from empty.
+ * Every round reserves, writes and pushes a burst of elements, then reads and pops them, like the RX lines of Uart.
+ * The result is the time per element, pushed and popped. The host CPU has a divider, so the gain of the masking is
+ * smaller than on the Cortex-M4, where a modulo by a constant is a multiply and a subtract.
+ *
+ * The second table moves a byte stream in chunks, like a DMA transfer, once element by element, and once with memcpy
+ * into get_free_span() and out of get_occupied_span().
+ *
+ * Build: g++ -std=c++17 -O2 -Iinclude -o ring_buffer_bench tools/ring_buffer_bench.cpp
+ * Usage: ring_buffer_bench [elements]
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ring_buffer.h"
+
+namespace {
+
+  /**
+   * @brief The RingBuffer before size_t counters, kept for comparison
+   *
+   */
+  template <class T, uint8_t L>
+  class LegacyRingBuffer {
+  public:
+    static constexpr uint8_t buffer_size_ = L;
+
+    void push() {
+      head_ = (head_ + 1) % buffer_size_;
+    }
+
+    void pop() {
+      if (is_empty()) return;
+      tail_ = (tail_ + 1) % buffer_size_;
+      is_full_ = false;
+    }
+
+    T* get_next_free() {
+      if (is_full_) return nullptr;
+      const auto ret = &buffer_[virtual_head_];
+      const uint8_t next_v_head = (virtual_head_ + 1) % buffer_size_;
+      if (next_v_head == tail_) is_full_ = true;
+      virtual_head_ = next_v_head;
+      return ret;
+    }
+
+    T* get_next_occupied() {
+      if (is_empty()) return nullptr;
+      return &buffer_[tail_];
+    }
+
+    bool is_empty() const {
+      return !is_full_ && head_ == tail_;
+    }
+
+  private:
+    std::array<T, buffer_size_> buffer_;
+    volatile uint8_t head_{ 0 };
+    volatile uint8_t virtual_head_{ 0 };
+    volatile uint8_t tail_{ 0 };
+    volatile bool is_full_{ false };
+  };
+
+  /**
+   * @brief An element of \p Size bytes
+   *
+   */
+  template <size_t Size>
+  struct Element {
+    std::array<uint8_t, Size> data;
+  };
+
+  /**
+   * @brief Pushes and pops \p count elements through \p buff in bursts of its size
+   *
+   * @return double ns per element
+   */
+  template <class Buffer, class T>
+  double run(Buffer& buff, size_t count, uint32_t& check) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < count;) {
+      T* ptr;
+      while ((ptr = buff.get_next_free()) != nullptr) {
+        ptr->data[0] = static_cast<uint8_t>(done);
+        buff.push();
+      }
+      while ((ptr = buff.get_next_occupied()) != nullptr) {
+        check += ptr->data[0];
+        buff.pop();
+        ++done;
+      }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  }
+
+  /**
+   * @brief Prints the time per element of the old and the new buffer, with \p L elements of \p Size bytes
+   *
+   */
+  template <size_t Size, uint8_t L>
+  void compare(size_t count) {
+    using T = Element<Size>;
+    static LegacyRingBuffer<T, L> legacy;
+    static RingBuffer<T, L> current;
+    uint32_t check_legacy{ 0 }, check_current{ 0 };
+    const double old_ns = run<decltype(legacy), T>(legacy, count, check_legacy);
+    const double new_ns = run<decltype(current), T>(current, count, check_current);
+    printf("%6zu %6u %10.2f %10.2f %8.2fx%s\n", Size, L, old_ns, new_ns, old_ns / new_ns,
+           check_legacy == check_current ? "" : "  MISMATCH");
+  }
+
+  /**
+   * @brief Moves \p count bytes through \p buff in chunks of \p chunk, one element at a time
+   *
+   * @return double ns per byte
+   */
+  template <class Buffer>
+  double run_bytes(Buffer& buff, size_t count, size_t chunk, uint32_t& check) {
+    std::array<uint8_t, 256> src{}, dst{};
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < count;) {
+      for (size_t i = 0; i < chunk; ++i) {
+        uint8_t* ptr = buff.get_next_free();
+        if (ptr == nullptr) break;
+        *ptr = src[i] = static_cast<uint8_t>(done + i);
+        buff.push();
+      }
+      size_t n{ 0 };
+      while (const uint8_t* ptr = buff.get_next_occupied()) {
+        dst[n++] = *ptr;
+        buff.pop();
+      }
+      check += dst[n - 1];
+      done += n;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  }
+
+  /**
+   * @brief Moves \p count bytes through \p buff in chunks of \p chunk, with memcpy into and out of the spans
+   *
+   * @return double ns per byte
+   */
+  template <class Buffer>
+  double run_spans(Buffer& buff, size_t count, size_t chunk, uint32_t& check) {
+    std::array<uint8_t, 256> src{}, dst{};
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < count;) {
+      for (size_t i = 0; i < chunk; ++i) src[i] = static_cast<uint8_t>(done + i);
+      size_t len{ 0 }, n{ 0 };
+      for (size_t left = chunk; left;) {
+        uint8_t* ptr = buff.get_free_span(len);
+        if (ptr == nullptr) break;
+        len = len < left ? len : left;
+        memcpy(ptr, &src[chunk - left], len);
+        buff.commit(len);
+        left -= len;
+      }
+      while (const uint8_t* ptr = buff.get_occupied_span(len)) {
+        memcpy(&dst[n], ptr, len);
+        buff.consume(len);
+        n += len;
+      }
+      check += dst[n - 1];
+      done += n;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  }
+
+  /**
+   * @brief Prints the time per byte of a ring of \p L bytes, element by element and with spans
+   *
+   */
+  template <size_t L>
+  void compare_spans(size_t count, size_t chunk) {
+    static RingBuffer<uint8_t, L> buff;
+    uint32_t check_bytes{ 0 }, check_spans{ 0 };
+    const double bytes_ns = run_bytes(buff, count, chunk, check_bytes);
+    const double spans_ns = run_spans(buff, count, chunk, check_spans);
+    printf("%6zu %6zu %10.2f %10.2f %8.2fx%s\n", chunk, L, bytes_ns, spans_ns, bytes_ns / spans_ns,
+           check_bytes == check_spans ? "" : "  MISMATCH");
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 50000000;
+  if (count == 0) {
+    fprintf(stderr, "Usage: %s [elements]\n", argv[0]);
+    return 1;
+  }
+
+  printf("%zu elements pushed and popped, ns per element\n", count);
+  printf("%6s %6s %10s %10s %9s\n", "bytes", "slots", "old", "new", "speedup");
+  compare<1, 5>(count);
+  compare<1, 8>(count);
+  compare<4, 5>(count);
+  compare<4, 8>(count);
+  compare<32, 5>(count);
+  compare<32, 8>(count);
+  compare<32, 200>(count);
+  compare<32, 128>(count);
+
+  printf("\nbyte stream, ns per byte\n");
+  printf("%6s %6s %10s %10s %9s\n", "chunk", "slots", "elements", "spans", "speedup");
+  compare_spans<64>(count, 20);
+  compare_spans<64>(count, 64);
+  compare_spans<100>(count, 42);
+  compare_spans<256>(count, 200);
+  return 0;
+}
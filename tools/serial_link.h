@@ -0,0 +1,160 @@
+#ifndef SERIAL_LINK_H_
+#define SERIAL_LINK_H_
+
+/** @file serial_link.h
+ * Serial port and line based access to it, shared by the host tools
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace serial {
+
+  constexpr char kTxPrefix[] = "echo: ";  //!< Same as Uart::kTxPrefix
+
+  /**
+   * @brief Opens the serial port, 115200 8N1 raw
+   *
+   * @return int file descriptor, or -1
+   */
+  inline int open_serial(const char* path) {
+    const int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+    termios tio{};
+    if (tcgetattr(fd, &tio) != 0) {
+      close(fd);
+      return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+  }
+
+  /**
+   * @brief Line based access to a file descriptor, a serial port or a socket of a model of the firmware
+   *
+   */
+  class Link {
+  public:
+    /**
+     * @param timeout_ms default max wait for a line, -1 waits forever
+     * @param strip_prefix when true, lines are read without kTxPrefix
+     */
+    explicit Link(int fd, int timeout_ms = 1000, bool strip_prefix = false)
+        : fd_(fd), timeout_ms_(timeout_ms), strip_prefix_(strip_prefix) {
+    }
+
+    /**
+     * @brief Writes \p len bytes
+     *
+     * @return true if all were written
+     */
+    bool write(const void* data, size_t len) {
+      return ::write(fd_, data, len) == static_cast<ssize_t>(len);
+    }
+
+    /**
+     * @brief Writes \p line and a newline
+     *
+     */
+    bool write_line(const std::string& line) {
+      const std::string data = line + "\n";
+      return write(data.data(), data.size());
+    }
+
+    /**
+     * @brief Reads a line, without the line ending, empty lines are skipped
+     *
+     * @return true if a line was read before the timeout
+     */
+    bool read_line(std::string& line, int timeout_ms) {
+      while (read_until("\r\n", line, timeout_ms)) {
+        if (strip_prefix_ && line.compare(0, sizeof(kTxPrefix) - 1, kTxPrefix) == 0) {
+          line.erase(0, sizeof(kTxPrefix) - 1);
+        }
+        if (!line.empty()) return true;
+      }
+      return false;
+    }
+
+    /**
+     * @brief Reads a line, with the default timeout
+     *
+     */
+    bool read_line(std::string& line) {
+      return read_line(line, timeout_ms_);
+    }
+
+    /**
+     * @brief Reads a 0 delimited frame, without the delimiter, empty frames are skipped
+     *
+     * @return true if a frame was read before the timeout
+     */
+    bool read_frame(std::string& frame, int timeout_ms) {
+      while (read_until(std::string(1, '\0'), frame, timeout_ms)) {
+        if (!frame.empty()) return true;
+      }
+      return false;
+    }
+
+    /**
+     * @brief Drops the received bytes, until nothing arrives for \p timeout_ms
+     *
+     */
+    void drain(int timeout_ms) {
+      while (receive(timeout_ms)) {
+      }
+      buff_.clear();
+    }
+
+  private:
+    /**
+     * @brief Takes the bytes before the first of \p delims from the received ones
+     *
+     * @return true if a delimiter arrived before the timeout
+     */
+    bool read_until(const std::string& delims, std::string& out, int timeout_ms) {
+      while (true) {
+        const auto end = buff_.find_first_of(delims);
+        if (end != std::string::npos) {
+          out = buff_.substr(0, end);
+          buff_.erase(0, end + 1);
+          return true;
+        }
+        if (!receive(timeout_ms)) return false;
+      }
+    }
+
+    /**
+     * @brief Appends the bytes, which arrive within \p timeout_ms
+     *
+     * @return true if anything arrived
+     */
+    bool receive(int timeout_ms) {
+      pollfd pfd{ fd_, POLLIN, 0 };
+      if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+      char tmp[256];
+      const ssize_t n = ::read(fd_, tmp, sizeof(tmp));
+      if (n <= 0) return false;
+      buff_.append(tmp, n);
+      return true;
+    }
+
+    int fd_;             //!< Serial port or socket
+    int timeout_ms_;     //!< Default max wait for a line
+    bool strip_prefix_;  //!< Lines are read without kTxPrefix
+    std::string buff_;   //!< Received bytes, not read yet
+  };
+
+}  // namespace serial
+
+#endif  // SERIAL_LINK_H_
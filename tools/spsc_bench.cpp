@@ -0,0 +1,306 @@
+/**
+ * @file spsc_bench.cpp
+ * @brief Host tool, torture test and benchmark of SpscRingBuffer, against RingBuffer in critical sections
+ *
+ * The torture test runs a producer and a consumer thread on one buffer. Every element is a sequence number and
+ * checksum words derived from it, so the consumer sees a lost, repeated, reordered or torn element. Sizes 5, 8 and 13
+ * are tested, element by element and with spans. Run it built with -fsanitize=thread too, which reports the data
+ * races, that the acquire and release ordering shall prevent.
+ *
+ * The benchmark moves elements through the buffer, once by one thread, which shows the cost of the calls, once by two
+ * threads. The critical section of RingBuffer is a std::mutex here. On the Cortex-M4 it masks interrupts instead,
+ * which is cheaper, but delays every interrupt of the same or lower priority.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread -Iinclude -o spsc_bench tools/spsc_bench.cpp
+ *        g++ -std=c++17 -O1 -g -fsanitize=thread -pthread -Iinclude -o spsc_tsan tools/spsc_bench.cpp
+ * Usage: spsc_bench [elements]
+ *        spsc_bench --torture [elements]    exit code 1 on the first wrong element
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "ring_buffer.h"
+#include "spsc_ring_buffer.h"
+
+namespace {
+
+  /**
+   * @brief An element, which the consumer can check
+   *
+   */
+  struct Element {
+    uint32_t seq;       //!< Sequence number
+    uint32_t check[3];  //!< Derived from seq
+
+    static Element make(uint32_t seq) {
+      return { seq, { seq * 2654435761u, ~seq, seq ^ 0xA5A5A5A5u } };
+    }
+
+    bool is_valid(uint32_t expected) const {
+      const Element ref = make(expected);
+      return memcmp(this, &ref, sizeof(ref)) == 0;
+    }
+  };
+
+  /**
+   * @brief RingBuffer, every call in a critical section, like on the target
+   *
+   */
+  template <size_t L>
+  class LockedRingBuffer {
+  public:
+    bool put(const Element& elem) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Element* ptr = buff_.get_next_free();
+      if (ptr == nullptr) return false;
+      *ptr = elem;
+      buff_.push();
+      return true;
+    }
+
+    bool get(Element& elem) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const Element* ptr = buff_.get_next_occupied();
+      if (ptr == nullptr) return false;
+      elem = *ptr;
+      buff_.pop();
+      return true;
+    }
+
+  private:
+    std::mutex mutex_;
+    RingBuffer<Element, L> buff_;
+  };
+
+  /**
+   * @brief SpscRingBuffer, element by element, same calls as LockedRingBuffer
+   *
+   */
+  template <size_t L>
+  class Spsc {
+  public:
+    bool put(const Element& elem) {
+      Element* ptr = buff_.get_next_free();
+      if (ptr == nullptr) return false;
+      *ptr = elem;
+      buff_.push();
+      return true;
+    }
+
+    bool get(Element& elem) {
+      const Element* ptr = buff_.get_next_occupied();
+      if (ptr == nullptr) return false;
+      elem = *ptr;
+      buff_.pop();
+      return true;
+    }
+
+  private:
+    SpscRingBuffer<Element, L> buff_;
+  };
+
+  /**
+   * @brief SpscRingBuffer, both sides move whole spans
+   *
+   */
+  template <size_t L>
+  class SpscSpans {
+  public:
+    /**
+     * @brief Writes up to \p count elements from \p first
+     *
+     * @return size_t number written
+     */
+    size_t put(uint32_t first, size_t count) {
+      size_t len{ 0 };
+      Element* ptr = buff_.get_free_span(len);
+      if (ptr == nullptr) return 0;
+      len = len < count ? len : count;
+      for (size_t i = 0; i < len; ++i) ptr[i] = Element::make(first + i);
+      buff_.commit(len);
+      return len;
+    }
+
+    /**
+     * @brief Checks the next span, which shall start at \p expected
+     *
+     * @return size_t number read, or SIZE_MAX on a wrong element
+     */
+    size_t check(uint32_t expected) {
+      size_t len{ 0 };
+      const Element* ptr = buff_.get_occupied_span(len);
+      if (ptr == nullptr) return 0;
+      for (size_t i = 0; i < len; ++i) {
+        if (!ptr[i].is_valid(expected + i)) return SIZE_MAX;
+      }
+      buff_.consume(len);
+      return len;
+    }
+
+  private:
+    SpscRingBuffer<Element, L> buff_;
+  };
+
+  /**
+   * @brief Producer and consumer threads move \p count elements through \p buff
+   *
+   * @return true if every element arrived once, in order and intact
+   */
+  template <class Buffer>
+  bool torture(Buffer& buff, uint32_t count) {
+    std::thread producer([&buff, count] {
+      for (uint32_t seq = 0; seq < count;) {
+        if (buff.put(Element::make(seq))) {
+          ++seq;
+        } else {
+          std::this_thread::yield();  // on one core, the consumer shall run
+        }
+      }
+    });
+    bool ok{ true };
+    Element elem;
+    for (uint32_t seq = 0; seq < count;) {
+      if (!buff.get(elem)) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (!elem.is_valid(seq)) {
+        fprintf(stderr, "expected %u, got %u\n", seq, elem.seq);
+        ok = false;
+        break;
+      }
+      ++seq;
+    }
+    producer.join();
+    return ok;
+  }
+
+  /**
+   * @brief Producer and consumer threads move \p count elements through \p buff in spans
+   *
+   * @see torture()
+   */
+  template <size_t L>
+  bool torture(SpscSpans<L>& buff, uint32_t count) {
+    std::thread producer([&buff, count] {
+      // a varying chunk, so the spans end at every slot
+      for (uint32_t seq = 0; seq < count;) {
+        const uint32_t chunk = 1 + seq % 7;
+        const size_t len = buff.put(seq, chunk < count - seq ? chunk : count - seq);
+        if (len == 0) std::this_thread::yield();
+        seq += len;
+      }
+    });
+    bool ok{ true };
+    for (uint32_t seq = 0; seq < count;) {
+      const size_t len = buff.check(seq);
+      if (len == SIZE_MAX) {
+        fprintf(stderr, "wrong element in the span at %u\n", seq);
+        ok = false;
+        break;
+      }
+      if (len == 0) std::this_thread::yield();
+      seq += len;
+    }
+    producer.join();
+    return ok;
+  }
+
+  /**
+   * @brief Runs the torture test of \p Buffer, prints the result
+   *
+   */
+  template <class Buffer>
+  bool run_torture(const char* name, uint32_t count) {
+    static Buffer buff;
+    const bool ok = torture(buff, count);
+    printf("%-24s %10u %s\n", name, count, ok ? "ok" : "FAILED");
+    return ok;
+  }
+
+  /**
+   * @brief Moves \p count elements through \p buff, by one thread, in bursts which fill it
+   *
+   * @return double ns per element
+   */
+  template <class Buffer>
+  double single_thread(Buffer& buff, uint32_t count) {
+    Element elem;
+    uint32_t sum{ 0 };
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t seq = 0; seq < count;) {
+      uint32_t next = seq;
+      while (buff.put(Element::make(next))) ++next;
+      while (buff.get(elem)) {
+        sum += elem.seq;
+        ++seq;
+      }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    if (sum == 1) puts("");  // keeps the reads
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  }
+
+  /**
+   * @brief Moves \p count elements through \p buff, by a producer and a consumer thread
+   *
+   * @return double ns per element
+   */
+  template <class Buffer>
+  double two_threads(Buffer& buff, uint32_t count) {
+    const auto start = std::chrono::steady_clock::now();
+    if (!torture(buff, count)) return 0;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  }
+
+  /**
+   * @brief Prints the time per element of the locked and the lock-free buffer of \p L elements
+   *
+   */
+  template <size_t L>
+  void compare(uint32_t count) {
+    static LockedRingBuffer<L> locked;
+    static Spsc<L> spsc;
+    const double locked_single = single_thread(locked, count), spsc_single = single_thread(spsc, count);
+    const double locked_two = two_threads(locked, count), spsc_two = two_threads(spsc, count);
+    printf("%6zu %10.2f %10.2f %8.2fx %10.2f %10.2f %8.2fx\n", L, locked_single, spsc_single,
+           locked_single / spsc_single, locked_two, spsc_two, locked_two / spsc_two);
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const bool is_torture = argc > 1 && strcmp(argv[1], "--torture") == 0;
+  const char* count_arg = is_torture ? (argc > 2 ? argv[2] : nullptr) : (argc > 1 ? argv[1] : nullptr);
+  const uint32_t count = count_arg ? strtoul(count_arg, nullptr, 10) : 5000000;
+  if (count == 0) {
+    fprintf(stderr, "Usage: %s [--torture] [elements]\n", argv[0]);
+    return 1;
+  }
+
+  if (is_torture) {
+    bool ok = run_torture<Spsc<5>>("spsc 5", count);
+    ok = run_torture<Spsc<8>>("spsc 8", count) && ok;
+    ok = run_torture<Spsc<13>>("spsc 13", count) && ok;
+    ok = run_torture<SpscSpans<5>>("spsc spans 5", count) && ok;
+    ok = run_torture<SpscSpans<8>>("spsc spans 8", count) && ok;
+    ok = run_torture<SpscSpans<13>>("spsc spans 13", count) && ok;
+    ok = run_torture<LockedRingBuffer<5>>("critical section 5", count) && ok;
+    return ok ? 0 : 1;
+  }
+
+  printf("%u elements of %zu bytes, ns per element\n", count, sizeof(Element));
+  printf("%6s %32s %32s\n", "", "one thread", "two threads");
+  printf("%6s %10s %10s %9s %10s %10s %9s\n", "slots", "critical", "spsc", "speedup", "critical", "spsc", "speedup");
+  compare<5>(count);
+  compare<8>(count);
+  compare<64>(count);
+  return 0;
+}
@@ -0,0 +1,314 @@
+/**
+ * @file trace2chrome.cpp
+ * @brief Host tool, converts an A16 kernel trace dump to Chrome trace JSON
+ *
+ * Reads a UART capture in text mode, which holds the dump of A16, the last dump in it is converted. Other lines and
+ * deferred log records are skipped. Open the output in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Every task is a thread, with a slice for each time it runs. Every interrupt is a thread, with a slice for each run
+ * of the handler. Gives and takes of the queues and semaphores are instant events, on the task or interrupt which
+ * does them. When a task blocks on a take, a "wait" slice lasts until it takes, on a thread of its own, e.g. the time
+ * a command waits for the I2C mutex.
+ *
+ * Build: g++ -std=c++17 -O2 -Iinclude -o trace2chrome tools/trace2chrome.cpp
+ * Usage: trace2chrome [capture.bin] > trace.json
+ * Without a capture file, stdin is read.
+ */
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+namespace {
+
+  using trace::Event;
+  using trace::Record;
+
+  constexpr uint8_t kLogMarker = 0x1E;    //!< Same as Uart::kLogMarker
+  constexpr uint8_t kTraceMarker = 0x1D;  //!< Same as Uart::kTraceMarker
+  constexpr char kTxPrefix[] = "echo: ";  //!< Same as Uart::kTxPrefix
+  constexpr int kIrqTid = 100;            //!< Thread of interrupt 0
+  constexpr int kWaitTid = 200;           //!< Thread of the waits of task 0
+
+  /**
+   * @brief The header, names and records of a dump
+   *
+   */
+  struct Dump {
+    uint32_t hz{ 0 };                        //!< Cycles per second
+    size_t expected{ 0 };                    //!< Records in the header
+    bool complete{ false };                  //!< The end line was seen
+    std::map<uint32_t, std::string> tasks;   //!< Task names by TCB number
+    std::map<uint32_t, std::string> queues;  //!< Queue names by number
+    std::map<uint32_t, std::string> irqs;    //!< Interrupt names by number
+    std::vector<Record> records;             //!< Oldest first
+  };
+
+  /**
+   * @brief Parses a "<number> <name>" line into \p names
+   *
+   */
+  void parse_name(const char* str, std::map<uint32_t, std::string>& names) {
+    char* end;
+    const unsigned long number = strtoul(str, &end, 10);
+    if (end == str || *end != ' ') return;
+    names[number] = end + 1;
+  }
+
+  /**
+   * @brief Parses a text line of the dump, a header starts a new dump
+   *
+   */
+  void parse_line(std::string line, Dump& dump) {
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) line.pop_back();
+    if (line.compare(0, sizeof(kTxPrefix) - 1, kTxPrefix) == 0) line.erase(0, sizeof(kTxPrefix) - 1);
+    const char* str = line.c_str();
+
+    unsigned long hz, n;
+    if (sscanf(str, "TRACE hz:%lu n:%lu", &hz, &n) == 2) {
+      dump = Dump{};
+      dump.hz = hz;
+      dump.expected = n;
+    } else if (strncmp(str, "TRACE end", 9) == 0) {
+      dump.complete = true;
+    } else if (strncmp(str, "TASK ", 5) == 0) {
+      parse_name(str + 5, dump.tasks);
+    } else if (strncmp(str, "QUEUE ", 6) == 0) {
+      parse_name(str + 6, dump.queues);
+    } else if (strncmp(str, "IRQ ", 4) == 0) {
+      parse_name(str + 4, dump.irqs);
+    }
+  }
+
+  /**
+   * @brief Splits the capture into text lines, log records and trace records
+   *
+   * @return true if a complete dump was found
+   */
+  bool parse(const std::vector<uint8_t>& capture, Dump& dump) {
+    std::string line;
+    for (size_t i = 0; i < capture.size();) {
+      const uint8_t c = capture[i];
+      if (c == kLogMarker) {
+        // marker, 16 bit ID, number of arguments, 32 bit arguments
+        i += i + 3 < capture.size() ? 4 + capture[i + 3] * 4 : 4;
+      } else if (c == kTraceMarker && i + 1 < capture.size()) {
+        const size_t len = capture[i + 1];
+        for (size_t pos = i + 2; pos + sizeof(Record) <= i + 2 + len && pos + sizeof(Record) <= capture.size();
+             pos += sizeof(Record)) {
+          Record rec;
+          memcpy(&rec, capture.data() + pos, sizeof(rec));
+          dump.records.push_back(rec);
+        }
+        i += 2 + len;
+      } else {
+        line.push_back(static_cast<char>(c));
+        if (c == '\n') {
+          parse_line(line, dump);
+          line.clear();
+        }
+        ++i;
+      }
+    }
+    return dump.complete && dump.hz;
+  }
+
+  /**
+   * @brief Name from \p names, or \p kind and the number
+   *
+   */
+  std::string name_of(const std::map<uint32_t, std::string>& names, uint32_t number, const char* kind) {
+    const auto it = names.find(number);
+    return it != names.end() ? it->second : kind + std::to_string(number);
+  }
+
+  /**
+   * @brief \p str as a JSON string
+   *
+   */
+  std::string quote(const std::string& str) {
+    std::string out = "\"";
+    for (const char c : str) {
+      if (c == '"' || c == '\\') out.push_back('\\');
+      if (static_cast<unsigned char>(c) >= 0x20) out.push_back(c);
+    }
+    return out + "\"";
+  }
+
+  /**
+   * @brief Writes the events of a dump as Chrome trace JSON
+   *
+   */
+  class Writer {
+  public:
+    explicit Writer(const Dump& dump) : dump_(dump) {
+    }
+
+    void write() {
+      printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+      name_threads();
+
+      uint64_t cycles{ 0 };
+      uint32_t prev = dump_.records.empty() ? 0 : dump_.records.front().time;
+      for (const Record& rec : dump_.records) {
+        // the cycle counter wraps around every 2^32 cycles, records are much closer
+        cycles += static_cast<uint32_t>(rec.time - prev);
+        prev = rec.time;
+        now_ = static_cast<double>(cycles) * 1e6 / dump_.hz;
+        on_record(rec);
+      }
+
+      // slices still open at the end of the trace
+      for (const auto& [task, start] : running_) slice(task, "run", start, now_);
+      for (const auto& [irq, start] : in_isr_) slice(kIrqTid + irq, "isr", start, now_);
+      for (const auto& [task, wait] : waits_) {
+        slice(kWaitTid + task, "wait " + queue_name(wait.queue), wait.start, now_);
+      }
+      printf("\n]}\n");
+    }
+
+  private:
+    /**
+     * @brief A task waiting for a queue
+     *
+     */
+    struct Wait {
+      uint32_t queue;  //!< Queue number
+      double start;    //!< us
+    };
+
+    void on_record(const Record& rec) {
+      switch (static_cast<Event>(rec.event)) {
+        case Event::kSwitchIn:
+          current_ = rec.id;
+          running_[rec.id] = now_;
+          break;
+        case Event::kSwitchOut:
+          if (running_.count(rec.id)) slice(rec.id, "run", running_[rec.id], now_);
+          running_.erase(rec.id);
+          current_ = 0;
+          break;
+        case Event::kGive:
+          instant("give " + queue_name(rec.id), rec.arg);
+          break;
+        case Event::kTake:
+          instant("take " + queue_name(rec.id), rec.arg);
+          if (irqs_.empty() && waits_.count(current_) && waits_[current_].queue == rec.id) {
+            slice(kWaitTid + current_, "wait " + queue_name(rec.id), waits_[current_].start, now_);
+            waits_.erase(current_);
+          }
+          break;
+        case Event::kBlock:
+          instant("block " + queue_name(rec.id), rec.arg);
+          if (irqs_.empty()) waits_[current_] = { rec.id, now_ };
+          break;
+        case Event::kIsrEnter:
+          irqs_.push_back(rec.id);
+          in_isr_[rec.id] = now_;
+          break;
+        case Event::kIsrExit:
+          if (in_isr_.count(rec.id)) slice(kIrqTid + rec.id, "isr", in_isr_[rec.id], now_);
+          in_isr_.erase(rec.id);
+          if (!irqs_.empty()) irqs_.pop_back();
+          break;
+        default:
+          fprintf(stderr, "Unknown event %u\n", rec.event);
+          break;
+      }
+    }
+
+    std::string queue_name(uint32_t number) const {
+      return name_of(dump_.queues, number, "queue ");
+    }
+
+    /**
+     * @brief Thread of the running interrupt, or task
+     *
+     */
+    int context() const {
+      return irqs_.empty() ? static_cast<int>(current_) : kIrqTid + irqs_.back();
+    }
+
+    void separator() {
+      if (!first_) printf(",\n");
+      first_ = false;
+    }
+
+    void slice(int tid, const std::string& name, double start, double end) {
+      separator();
+      printf("{\"name\":%s,\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", quote(name).c_str(), tid,
+             start, end - start);
+    }
+
+    void instant(const std::string& name, uint16_t count) {
+      separator();
+      printf("{\"name\":%s,\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"count\":%u}}",
+             quote(name).c_str(), context(), now_, count);
+    }
+
+    void thread_name(int tid, const std::string& name) {
+      separator();
+      printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":%s}}", tid,
+             quote(name).c_str());
+      separator();
+      printf("{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", tid,
+             tid);
+    }
+
+    void name_threads() {
+      separator();
+      printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"STM32 %" PRIu32 " Hz\"}}",
+             dump_.hz);
+      thread_name(0, "scheduler");
+      for (const auto& [number, name] : dump_.tasks) {
+        thread_name(number, name);
+        thread_name(kWaitTid + number, name + " waits");
+      }
+      for (const auto& [number, name] : dump_.irqs) thread_name(kIrqTid + number, name);
+    }
+
+    const Dump& dump_;                    //!< Converted dump
+    double now_{ 0 };                     //!< Time of the current record, us
+    uint32_t current_{ 0 };               //!< Running task, 0 if none
+    std::vector<uint32_t> irqs_;          //!< Nested interrupts
+    std::map<uint32_t, double> running_;  //!< Start of the run slices
+    std::map<uint32_t, double> in_isr_;   //!< Start of the interrupt slices
+    std::map<uint32_t, Wait> waits_;      //!< Blocked tasks
+    bool first_{ true };                  //!< No event written yet
+  };
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::ifstream capture_file;
+  if (argc > 1) {
+    capture_file.open(argv[1], std::ios::binary);
+    if (!capture_file) {
+      std::cerr << "Couldn't open " << argv[1] << "\n";
+      return 1;
+    }
+  }
+  std::istream& in = argc > 1 ? capture_file : std::cin;
+  const std::vector<uint8_t> capture((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  Dump dump;
+  if (!parse(capture, dump)) {
+    std::cerr << "No complete trace dump found, capture A16 in text mode\n";
+    return 1;
+  }
+  if (dump.records.size() != dump.expected) {
+    std::cerr << "Warning: " << dump.records.size() << " of " << dump.expected << " records received\n";
+  }
+  Writer(dump).write();
+  std::cerr << dump.records.size() << " records converted\n";
+  return 0;
+}